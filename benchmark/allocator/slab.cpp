@@ -0,0 +1,99 @@
+#include "taomp/hazard_pointer.hpp"
+#include "taomp/ms_queue.hpp"
+#include "taomp/slab_allocator.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+#if __has_include(<jemalloc/jemalloc.h>)
+#include <jemalloc/jemalloc.h>
+#define TAOMP_HAVE_JEMALLOC
+#endif
+
+/**SlabAllocator against glibc malloc, and jemalloc when its header is found
+ * (link with -ljemalloc). BM_AllocFree allocates and frees batches of 64-byte
+ * objects on every thread; BM_QueueNodes runs an MSQueue whose nodes come
+ * from the allocator, so most frees happen on another thread than the
+ * allocation.
+ */
+
+const int N = 1000;
+const int thread_num = 16;
+
+struct Object {
+  char data[64];
+};
+
+template <typename T> class MallocAllocator {
+public:
+  using value_type = T;
+  MallocAllocator() = default;
+  template <typename U> MallocAllocator(const MallocAllocator<U> &) {}
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(malloc(n * sizeof(T)));
+  }
+  void deallocate(T *p, std::size_t) { free(p); }
+};
+
+#ifdef TAOMP_HAVE_JEMALLOC
+template <typename T> class JemallocAllocator {
+public:
+  using value_type = T;
+  JemallocAllocator() = default;
+  template <typename U> JemallocAllocator(const JemallocAllocator<U> &) {}
+  T *allocate(std::size_t n) {
+    return static_cast<T *>(mallocx(n * sizeof(T), 0));
+  }
+  void deallocate(T *p, std::size_t) { dallocx(p, 0); }
+};
+#endif
+
+template <typename Alloc> static void BM_AllocFree(benchmark::State &state) {
+  taomp::init_pinned_thread(state.thread_index);
+  Alloc alloc;
+  std::vector<Object *> batch(N);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      batch[i] = alloc.allocate(1);
+      benchmark::DoNotOptimize(batch[i]->data[0] = i);
+    }
+    for (int i = 0; i < N; ++i) {
+      alloc.deallocate(batch[i], 1);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+template <typename Alloc> static void BM_QueueNodes(benchmark::State &state) {
+  using Node = taomp::MSQueueNode<int>;
+  using NodeAlloc = typename std::allocator_traits<
+      Alloc>::template rebind_alloc<Node>;
+  static taomp::MSQueue<int, false, taomp::HazardPointer<NodeAlloc>> queue(
+      thread_num);
+  taomp::init_pinned_thread(state.thread_index);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      queue.enqueue(i);
+      benchmark::DoNotOptimize(queue.dequeue());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+BENCHMARK_TEMPLATE(BM_AllocFree, MallocAllocator<Object>)
+    ->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_AllocFree, taomp::SlabAllocator<Object>)
+    ->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_QueueNodes, MallocAllocator<Object>)
+    ->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_QueueNodes, taomp::SlabAllocator<Object>)
+    ->ThreadRange(1, thread_num);
+#ifdef TAOMP_HAVE_JEMALLOC
+BENCHMARK_TEMPLATE(BM_AllocFree, JemallocAllocator<Object>)
+    ->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_QueueNodes, JemallocAllocator<Object>)
+    ->ThreadRange(1, thread_num);
+#endif
+BENCHMARK_MAIN();
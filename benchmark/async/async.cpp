@@ -0,0 +1,193 @@
+#include "taomp/async.hpp"
+#include "benchmark/benchmark.h"
+
+#if __has_include(<coroutine>) && __cplusplus > 201703L
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**Coroutines on a pool of pool_size threads against one blocking thread per
+ * task. Every iteration runs state.range(0) tasks to completion:
+ * BM_*Mutex: every task increments a shared counter N times under the lock.
+ * BM_*Queue: half of the tasks push N values each, the other half pop them.
+ * The blocking versions sleep in a std::condition_variable: CvMutex is a
+ * sleeping lock, CvQueue a deque with a condition variable for its
+ * consumers. Must be compiled as C++20.
+ */
+
+const int N = 1000;
+const unsigned pool_size = 4;
+
+static void waitFor(std::atomic<unsigned> &done, unsigned n) {
+  while (done.load(std::memory_order_acquire) != n) {
+    std::this_thread::yield();
+  }
+}
+
+static taomp::DetachedTask lockTask(taomp::AsyncMutex &mutex, long &count,
+                                    std::atomic<unsigned> &done,
+                                    taomp::Executor &executor) {
+  for (int i = 0; i < N; ++i) {
+    taomp::AsyncMutex::QNode node;
+    co_await mutex.lock(node, executor);
+    ++count;
+    mutex.unlock(node);
+  }
+  done.fetch_add(1, std::memory_order_release);
+}
+
+static void BM_AsyncMutex(benchmark::State &state) {
+  unsigned task_num = state.range(0);
+  taomp::ThreadPoolExecutor executor(pool_size);
+  for (auto _ : state) {
+    taomp::AsyncMutex mutex;
+    long count = 0;
+    std::atomic<unsigned> done{0};
+    for (unsigned t = 0; t < task_num; ++t) {
+      taomp::spawn(executor, lockTask(mutex, count, done, executor));
+    }
+    waitFor(done, task_num);
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * task_num * N);
+}
+
+class CvMutex {
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool locked = false;
+
+public:
+  void lock() {
+    std::unique_lock<std::mutex> guard(mutex);
+    cv.wait(guard, [this] { return !locked; });
+    locked = true;
+  }
+  void unlock() {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      locked = false;
+    }
+    cv.notify_one();
+  }
+};
+
+static void BM_CvMutex(benchmark::State &state) {
+  unsigned task_num = state.range(0);
+  for (auto _ : state) {
+    CvMutex mutex;
+    long count = 0;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < task_num; ++t) {
+      threads.emplace_back([&] {
+        for (int i = 0; i < N; ++i) {
+          std::lock_guard<CvMutex> guard(mutex);
+          ++count;
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+    benchmark::DoNotOptimize(count);
+  }
+  state.SetItemsProcessed(state.iterations() * task_num * N);
+}
+
+static taomp::DetachedTask pushTask(taomp::AsyncQueue<int> &queue,
+                                    std::atomic<unsigned> &done) {
+  for (int i = 0; i < N; ++i) {
+    queue.push(i);
+  }
+  done.fetch_add(1, std::memory_order_release);
+  co_return;
+}
+
+static taomp::DetachedTask popTask(taomp::AsyncQueue<int> &queue,
+                                   std::atomic<unsigned> &done,
+                                   taomp::Executor &executor) {
+  long sum = 0;
+  for (int i = 0; i < N; ++i) {
+    sum += co_await queue.pop(executor);
+  }
+  benchmark::DoNotOptimize(sum);
+  done.fetch_add(1, std::memory_order_release);
+}
+
+static void BM_AsyncQueue(benchmark::State &state) {
+  unsigned pair_num = state.range(0) / 2;
+  taomp::ThreadPoolExecutor executor(pool_size);
+  for (auto _ : state) {
+    taomp::AsyncQueue<int> queue;
+    std::atomic<unsigned> done{0};
+    for (unsigned t = 0; t < pair_num; ++t) {
+      taomp::spawn(executor, popTask(queue, done, executor));
+    }
+    for (unsigned t = 0; t < pair_num; ++t) {
+      taomp::spawn(executor, pushTask(queue, done));
+    }
+    waitFor(done, 2 * pair_num);
+  }
+  state.SetItemsProcessed(state.iterations() * pair_num * N);
+}
+
+class CvQueue {
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::deque<int> items;
+
+public:
+  void push(int v) {
+    {
+      std::lock_guard<std::mutex> guard(mutex);
+      items.push_back(v);
+    }
+    cv.notify_one();
+  }
+  int pop() {
+    std::unique_lock<std::mutex> guard(mutex);
+    cv.wait(guard, [this] { return !items.empty(); });
+    int v = items.front();
+    items.pop_front();
+    return v;
+  }
+};
+
+static void BM_CvQueue(benchmark::State &state) {
+  unsigned pair_num = state.range(0) / 2;
+  for (auto _ : state) {
+    CvQueue queue;
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < pair_num; ++t) {
+      threads.emplace_back([&] {
+        long sum = 0;
+        for (int i = 0; i < N; ++i) {
+          sum += queue.pop();
+        }
+        benchmark::DoNotOptimize(sum);
+      });
+      threads.emplace_back([&] {
+        for (int i = 0; i < N; ++i) {
+          queue.push(i);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * pair_num * N);
+}
+
+BENCHMARK(BM_AsyncMutex)->RangeMultiplier(4)->Range(4, 256)->UseRealTime();
+BENCHMARK(BM_CvMutex)->RangeMultiplier(4)->Range(4, 256)->UseRealTime();
+BENCHMARK(BM_AsyncQueue)->RangeMultiplier(4)->Range(4, 256)->UseRealTime();
+BENCHMARK(BM_CvQueue)->RangeMultiplier(4)->Range(4, 256)->UseRealTime();
+
+#endif
+
+BENCHMARK_MAIN();
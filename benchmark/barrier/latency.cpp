@@ -0,0 +1,66 @@
+#include "taomp/barrier.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <pthread.h>
+#if __has_include(<barrier>) && __cplusplus > 201703L
+#include <barrier>
+#define TAOMP_HAVE_STD_BARRIER
+#endif
+
+/**Barrier latency: every iteration is one barrier episode of all threads,
+ * so the time per iteration is the time from the last arrival to the
+ * release of every thread plus the arrival itself. Compared against
+ * pthread_barrier_t and, when compiled as C++20, std::barrier.
+ */
+
+const int max_thread_num = 128;
+
+class PthreadBarrier {
+  pthread_barrier_t barrier;
+
+public:
+  PthreadBarrier(unsigned thread_num) {
+    pthread_barrier_init(&barrier, nullptr, thread_num);
+  }
+  void await(unsigned = 0) { pthread_barrier_wait(&barrier); }
+};
+
+#ifdef TAOMP_HAVE_STD_BARRIER
+class StdBarrier {
+  std::barrier<> barrier;
+
+public:
+  StdBarrier(unsigned thread_num) : barrier(thread_num) {}
+  void await(unsigned = 0) { barrier.arrive_and_wait(); }
+};
+#endif
+
+template <typename Barrier> static void BM_Barrier(benchmark::State &state) {
+  // a barrier per thread count, leaked: threads of the previous run may
+  // still be leaving the old one
+  static Barrier *barrier;
+  taomp::init_pinned_thread(state.thread_index);
+  if (state.thread_index == 0) {
+    barrier = new Barrier(state.threads);
+  }
+  for (auto _ : state) {
+    barrier->await(state.thread_index);
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_Barrier, taomp::SenseBarrier)
+    ->ThreadRange(2, max_thread_num)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Barrier, taomp::DisseminationBarrier)
+    ->ThreadRange(2, max_thread_num)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Barrier, PthreadBarrier)
+    ->ThreadRange(2, max_thread_num)
+    ->UseRealTime();
+#ifdef TAOMP_HAVE_STD_BARRIER
+BENCHMARK_TEMPLATE(BM_Barrier, StdBarrier)
+    ->ThreadRange(2, max_thread_num)
+    ->UseRealTime();
+#endif
+BENCHMARK_MAIN();
@@ -1,3 +1,4 @@
+#include "taomp/timing.hpp"
 #include "benchmark/benchmark.h"
 
 #include <chrono>
@@ -12,5 +13,25 @@ void BM_CLockNow(benchmark::State &state) {
 BENCHMARK_TEMPLATE(BM_CLockNow, std::chrono::system_clock);
 BENCHMARK_TEMPLATE(BM_CLockNow, std::chrono::steady_clock);
 BENCHMARK_TEMPLATE(BM_CLockNow, std::chrono::high_resolution_clock);
+
+template <taomp::TimeStamp (*Read)()>
+void BM_ReadCPUCycleCount(benchmark::State &state) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Read());
+  }
+}
+
+BENCHMARK_TEMPLATE(BM_ReadCPUCycleCount, taomp::readCPUCycleCount);
+BENCHMARK_TEMPLATE(BM_ReadCPUCycleCount, taomp::readCPUCycleCountBegin);
+BENCHMARK_TEMPLATE(BM_ReadCPUCycleCount, taomp::readCPUCycleCountEnd);
+
+void BM_NowNs(benchmark::State &state) {
+  taomp::tickCalibration();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(taomp::now_ns());
+  }
+}
+
+BENCHMARK(BM_NowNs);
 BENCHMARK_MAIN();
 
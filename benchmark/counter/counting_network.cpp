@@ -0,0 +1,107 @@
+#include "taomp/counter.hpp"
+#include "taomp/counting_network.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/**getAndIncrement() through counting networks and diffracting trees of width
+ * `width` against a single atomic fetch_add and a ShardedCounter. The sharded
+ * counter only counts, it cannot hand out distinct values, so it is the
+ * bound for the networks rather than a competitor.
+ */
+
+const int N = 1000;
+const int thread_num = 64;
+const unsigned width = 16;
+
+static taomp::ExpBackoff makeBackoff() {
+  return taomp::ExpBackoff(std::chrono::nanoseconds(20),
+                           std::chrono::nanoseconds(2000));
+}
+
+static void BM_AtomicCounter(benchmark::State &state) {
+  static std::atomic<uint64_t> counter{0};
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      benchmark::DoNotOptimize(
+          counter.fetch_add(1, std::memory_order_relaxed));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_ShardedCounter(benchmark::State &state) {
+  static taomp::ShardedCounter<> counter(thread_num);
+  taomp::init_pinned_thread(state.thread_index);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      counter.add();
+    }
+  }
+  if (!state.thread_index) {
+    benchmark::DoNotOptimize(counter.read());
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+template <typename CounterTy>
+static void BM_Network(benchmark::State &state, CounterTy &counter) {
+  taomp::init_pinned_thread(state.thread_index);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      benchmark::DoNotOptimize(counter.getAndIncrement());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_Bitonic(benchmark::State &state) {
+  static taomp::NetworkCounter<taomp::BitonicNetwork<width>> counter;
+  BM_Network(state, counter);
+}
+
+static void BM_BitonicBackoff(benchmark::State &state) {
+  static taomp::NetworkCounter<
+      taomp::BitonicNetwork<width, taomp::ExpBackoff>>
+      counter(makeBackoff());
+  BM_Network(state, counter);
+}
+
+static void BM_Periodic(benchmark::State &state) {
+  static taomp::NetworkCounter<taomp::PeriodicNetwork<width>> counter;
+  BM_Network(state, counter);
+}
+
+static void BM_DiffractingTree(benchmark::State &state) {
+  static taomp::NetworkCounter<taomp::DiffractingTree<width>> counter(
+      thread_num, thread_num / 4);
+  BM_Network(state, counter);
+}
+
+static void BM_DiffractingTreeBackoff(benchmark::State &state) {
+  static taomp::NetworkCounter<
+      taomp::DiffractingTree<width, taomp::ExpBackoff>>
+      counter(thread_num, thread_num / 4, 64, makeBackoff());
+  BM_Network(state, counter);
+}
+
+// the tree without its prisms
+static void BM_ToggleTree(benchmark::State &state) {
+  static taomp::NetworkCounter<taomp::DiffractingTree<width>> counter(
+      thread_num, 0, 0);
+  BM_Network(state, counter);
+}
+
+BENCHMARK(BM_AtomicCounter)->ThreadRange(1, thread_num);
+BENCHMARK(BM_ShardedCounter)->ThreadRange(1, thread_num);
+BENCHMARK(BM_Bitonic)->ThreadRange(1, thread_num);
+BENCHMARK(BM_BitonicBackoff)->ThreadRange(1, thread_num);
+BENCHMARK(BM_Periodic)->ThreadRange(1, thread_num);
+BENCHMARK(BM_DiffractingTree)->ThreadRange(1, thread_num);
+BENCHMARK(BM_DiffractingTreeBackoff)->ThreadRange(1, thread_num);
+BENCHMARK(BM_ToggleTree)->ThreadRange(1, thread_num);
+BENCHMARK_MAIN();
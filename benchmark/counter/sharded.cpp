@@ -0,0 +1,141 @@
+#include "taomp/counter.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <atomic>
+#include <cstdint>
+
+/**Sharded accumulators from counter.hpp against a single shared atomic.
+ */
+
+const int N = 1000;
+const int thread_num = 64;
+
+static void BM_AtomicCounter(benchmark::State &state) {
+  static std::atomic<uint64_t> counter{0};
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      counter.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+static void BM_AtomicMax(benchmark::State &state) {
+  static std::atomic<uint64_t> max{0};
+  uint64_t v = state.thread_index;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      v += thread_num;
+      uint64_t old = max.load(std::memory_order_relaxed);
+      while (old < v &&
+             !max.compare_exchange_weak(old, v, std::memory_order_relaxed)) {
+        continue;
+      }
+    }
+  }
+}
+
+static void BM_ShardedCounter(benchmark::State &state) {
+  static taomp::ShardedCounter<> counter(thread_num);
+  taomp::init_pinned_thread(state.thread_index);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      counter.add();
+    }
+  }
+  if (!state.thread_index) {
+    benchmark::DoNotOptimize(counter.read());
+  }
+}
+
+static void BM_ShardedMax(benchmark::State &state) {
+  static taomp::ShardedMax<> max(thread_num);
+  taomp::init_pinned_thread(state.thread_index);
+  uint64_t v = state.thread_index;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      v += thread_num;
+      max.update(v);
+    }
+  }
+  if (!state.thread_index) {
+    benchmark::DoNotOptimize(max.read());
+  }
+}
+
+static void BM_ShardedMin(benchmark::State &state) {
+  static taomp::ShardedMin<> min(thread_num);
+  taomp::init_pinned_thread(state.thread_index);
+  uint64_t v = ~uint64_t(0) - state.thread_index;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      v -= thread_num;
+      min.update(v);
+    }
+  }
+  if (!state.thread_index) {
+    benchmark::DoNotOptimize(min.read());
+  }
+}
+
+static void BM_AtomicHistogram(benchmark::State &state) {
+  static std::atomic<uint64_t> buckets[65];
+  uint64_t v = state.thread_index;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      v = v * 6364136223846793005ull + 1;
+      buckets[taomp::ShardedHistogram<>::bucket(v >> (v & 63))].fetch_add(
+          1, std::memory_order_relaxed);
+    }
+  }
+}
+
+static void BM_ShardedHistogram(benchmark::State &state) {
+  static taomp::ShardedHistogram<> histogram(thread_num);
+  taomp::init_pinned_thread(state.thread_index);
+  uint64_t v = state.thread_index;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      v = v * 6364136223846793005ull + 1;
+      histogram.record(v >> (v & 63));
+    }
+  }
+  if (!state.thread_index) {
+    benchmark::DoNotOptimize(histogram.read());
+  }
+}
+
+// arrive/depart pairs with a query in between, the way a reader count is used
+static void BM_AtomicNonZero(benchmark::State &state) {
+  static std::atomic<int64_t> surplus{0};
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      surplus.fetch_add(1, std::memory_order_acq_rel);
+      benchmark::DoNotOptimize(surplus.load(std::memory_order_acquire) > 0);
+      surplus.fetch_sub(1, std::memory_order_acq_rel);
+    }
+  }
+}
+
+static void BM_SNZI(benchmark::State &state) {
+  static taomp::SNZI snzi(thread_num / 4);
+  taomp::init_pinned_thread(state.thread_index);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      snzi.arrive();
+      benchmark::DoNotOptimize(snzi.query());
+      snzi.depart();
+    }
+  }
+}
+
+BENCHMARK(BM_AtomicCounter)->ThreadRange(1, thread_num);
+BENCHMARK(BM_ShardedCounter)->ThreadRange(1, thread_num);
+BENCHMARK(BM_AtomicMax)->ThreadRange(1, thread_num);
+BENCHMARK(BM_ShardedMax)->ThreadRange(1, thread_num);
+BENCHMARK(BM_ShardedMin)->ThreadRange(1, thread_num);
+BENCHMARK(BM_AtomicHistogram)->ThreadRange(1, thread_num);
+BENCHMARK(BM_ShardedHistogram)->ThreadRange(1, thread_num);
+BENCHMARK(BM_AtomicNonZero)->ThreadRange(1, thread_num);
+BENCHMARK(BM_SNZI)->ThreadRange(1, thread_num);
+BENCHMARK_MAIN();
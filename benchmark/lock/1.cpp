@@ -1,6 +1,8 @@
 #include "taomp/allocator.hpp"
+#include "taomp/elision.hpp"
 #include "taomp/lock.hpp"
 #include "taomp/lock_third_party.hpp"
+#include "taomp/topology.hpp"
 #include <benchmark/benchmark.h>
 #include <cassert>
 #include <iostream>
@@ -8,6 +10,7 @@
 #include <pthread.h>
 #include <stdlib.h>
 #include <chrono>
+#include <type_traits>
 #include "tbb/spin_mutex.h"
 
 using namespace std::chrono_literals;
@@ -142,6 +145,49 @@ static void BM_LockHighContention3(benchmark::State &state) {
   }
 }
 
+template <class Lock> static void reportElision(benchmark::State &, Lock &) {}
+
+template <class Lock, unsigned MaxAttempts>
+static void reportElision(benchmark::State &state,
+                          taomp::ElidedLock<Lock, true, MaxAttempts> &lock) {
+  taomp::StatsSnapshot s = lock.snapshot();
+  for (taomp::StatKind kind :
+       {taomp::StatKind::ElisionCommit, taomp::StatKind::ElisionConflict,
+        taomp::StatKind::ElisionCapacity, taomp::StatKind::ElisionLockBusy,
+        taomp::StatKind::ElisionOtherAbort, taomp::StatKind::ElisionFallback}) {
+    state.counters[taomp::getStatName(kind)] = s[kind];
+  }
+}
+
+template <class Lock> static Lock makeLock(unsigned thread_num) {
+  if constexpr (std::is_constructible<Lock, unsigned>::value) {
+    return Lock(thread_num);
+  } else {
+    return Lock();
+  }
+}
+
+/**Every thread only touches its own counter under the shared lock: the
+ * critical sections never conflict on data, which lock elision exploits.
+ */
+template <class Lock, int N>
+static void BM_LockDisjoint(benchmark::State &state) {
+  static Lock lock = makeLock<Lock>(state.threads);
+  static taomp::ThreadLocal<size_t> counts(state.threads);
+  taomp::init_pinned_thread(state.thread_index);
+  counts.get() = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      std::lock_guard<Lock> X(lock);
+      ++counts.get();
+    }
+  }
+  assert(counts.get() == size_t(N * state.iterations()));
+  if (!state.thread_index) {
+    reportElision(state, lock);
+  }
+}
+
 const int N = 1024 * 1024 * 2;
 const int P = 4;
 BENCHMARK_TEMPLATE(BM_LockHighContention0, taomp::TASLock, N)->Threads(P);
@@ -155,4 +201,14 @@ BENCHMARK_TEMPLATE(BM_LockHighContention, taomp::PThreadSpinLock, N)
 BENCHMARK_TEMPLATE(BM_LockHighContention, std::mutex, N)->Threads(P);
 BENCHMARK_TEMPLATE(BM_LockHighContention2, taomp::CLHLock, N)->Threads(P);
 BENCHMARK_TEMPLATE(BM_LockHighContention3, taomp::MCSLock, N)->Threads(P);
+BENCHMARK_TEMPLATE(BM_LockHighContention0,
+                   taomp::ElidedLock<taomp::TTASLock>, N)
+    ->Threads(P);
+BENCHMARK_TEMPLATE(BM_LockHighContention, taomp::ElidedLock<taomp::TTASLock>,
+                   N)
+    ->Threads(P);
+BENCHMARK_TEMPLATE(BM_LockDisjoint, taomp::TTASLock, N)->Threads(P);
+BENCHMARK_TEMPLATE(BM_LockDisjoint, taomp::ElidedLock<taomp::TTASLock, true>,
+                   N)
+    ->Threads(P);
 BENCHMARK_MAIN();
@@ -0,0 +1,106 @@
+#include "taomp/lock.hpp"
+#include "taomp/seq_lock.hpp"
+#include "taomp/utils.hpp"
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include "tbb/spin_rw_mutex.h"
+
+/**Reader scaling on a 120-byte snapshot: thread 0 writes once every
+ * write_period operations and reads otherwise, all other threads only read.
+ * SeqLock readers store nothing, the lock based readers all write the lock
+ * word (or the mutex) and serialize on its cache line.
+ */
+
+const int N = 1000;
+const int write_period = 64;
+const int thread_num = 16;
+
+struct Snapshot {
+  uint64_t fields[15];
+};
+
+template <bool MultiWriter> class SeqLocked {
+  taomp::SeqLock<Snapshot, MultiWriter> lock;
+
+public:
+  Snapshot read() { return lock.load(); }
+  void write(const Snapshot &s) { lock.store(s); }
+};
+
+// exclusive locks for readers and writers alike
+template <typename Lock> class Locked {
+  Lock lock;
+  Snapshot value{};
+
+public:
+  Snapshot read() {
+    std::lock_guard<Lock> guard(lock);
+    return value;
+  }
+  void write(const Snapshot &s) {
+    std::lock_guard<Lock> guard(lock);
+    value = s;
+  }
+};
+
+class SharedMutexLocked {
+  std::shared_mutex lock;
+  Snapshot value{};
+
+public:
+  Snapshot read() {
+    std::shared_lock<std::shared_mutex> guard(lock);
+    return value;
+  }
+  void write(const Snapshot &s) {
+    std::unique_lock<std::shared_mutex> guard(lock);
+    value = s;
+  }
+};
+
+class SpinRWLocked {
+  tbb::spin_rw_mutex lock;
+  Snapshot value{};
+
+public:
+  Snapshot read() {
+    tbb::spin_rw_mutex::scoped_lock guard(lock, false);
+    return value;
+  }
+  void write(const Snapshot &s) {
+    tbb::spin_rw_mutex::scoped_lock guard(lock, true);
+    value = s;
+  }
+};
+
+template <typename Guarded> static void BM_ReadMostly(benchmark::State &state) {
+  static Guarded guarded;
+  bool writer = !state.thread_index;
+  Snapshot s{};
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      if (writer && i % write_period == 0) {
+        for (auto &f : s.fields) {
+          ++f;
+        }
+        guarded.write(s);
+      } else {
+        benchmark::DoNotOptimize(guarded.read());
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+BENCHMARK_TEMPLATE(BM_ReadMostly, SeqLocked<false>)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_ReadMostly, SeqLocked<true>)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_ReadMostly, SharedMutexLocked)
+    ->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_ReadMostly, SpinRWLocked)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_ReadMostly, Locked<taomp::TTASLock>)
+    ->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_ReadMostly, Locked<std::mutex>)
+    ->ThreadRange(1, thread_num);
+BENCHMARK_MAIN();
@@ -0,0 +1,271 @@
+#include "taomp/counter.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/lock_third_party.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include "tbb/spin_mutex.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**Lock hand-off and fairness suite. Every lock runs with 1 to all cores
+ * threads, each pinned to one cpu by init_pinned_thread() (one per core and
+ * alternating the NUMA nodes first), with critical and non-critical sections
+ * of a given number of cycles (the two benchmark arguments). Besides the
+ * throughput, each run reports:
+ *   jain: Jain's fairness index of the per-thread acquisition counts,
+ *         (sum x)^2 / (n * sum x^2), 1 is perfectly fair, 1/n is one thread
+ *         taking everything;
+ *   handoff_p50/p99/max: cycles from an unlock to the acquisition by another,
+ *         waiting thread, as the upper bound of the log2 histogram bucket;
+ *   handoff_log2_<k>: the histogram itself.
+ * For regression tracking, write JSON with
+ *   --benchmark_out=locks.json --benchmark_out_format=json
+ */
+
+using namespace std::chrono_literals;
+
+const unsigned max_thread_num = 256;
+const int N = 1 << 12;
+
+static unsigned cpuNum() { return taomp::Topology::get().cpuNum(); }
+
+static void spinCycles(uint64_t cycles) {
+  if (!cycles) {
+    return;
+  }
+  taomp::TimeStamp start = taomp::readCPUCycleCount();
+  while (taomp::readCPUCycleCount() - start < cycles) {
+    continue;
+  }
+}
+
+/**Uniform interface over the different lock protocols: each thread owns a
+ * Context, which holds the queue node or ticket of the lock, if any.
+ */
+template <typename Lock> class LockAdapter {
+  Lock lock_;
+
+public:
+  struct Context {};
+  LockAdapter(unsigned) {}
+  void initContext(Context &) {}
+  void lock(Context &) { lock_.lock(); }
+  void unlock(Context &) { lock_.unlock(); }
+};
+
+template <typename Lock> struct WithBackoff {};
+
+template <typename Lock> class LockAdapter<WithBackoff<Lock>> {
+  Lock lock_;
+
+public:
+  struct Context {};
+  LockAdapter(unsigned) {}
+  void initContext(Context &) {}
+  void lock(Context &) { lock_.lock(taomp::ExpBackoff(100ns, 10us)); }
+  void unlock(Context &) { lock_.unlock(); }
+};
+
+template <> class LockAdapter<taomp::ArrayLock> {
+  taomp::ArrayLock lock_;
+
+public:
+  struct Context {
+    taomp::ArrayLock::HandleT handle;
+  };
+  LockAdapter(unsigned thread_num) : lock_(thread_num) {}
+  void initContext(Context &) {}
+  void lock(Context &c) { c.handle = lock_.lock(); }
+  void unlock(Context &c) { lock_.unlock(c.handle); }
+};
+
+template <> class LockAdapter<taomp::CLHLock> {
+  using QNode = taomp::CLHLock::QNode;
+  taomp::CLHLock lock_;
+  // nodes migrate between threads, so they are all owned by the adapter
+  std::vector<QNode *> nodes;
+
+  QNode *newNode() {
+    QNode *node = taomp::aligned_alloc<QNode>();
+    new (node) QNode(false);
+    nodes.push_back(node);
+    return node;
+  }
+
+public:
+  struct Context {
+    QNode *node;
+    QNode *pred;
+  };
+  LockAdapter(unsigned thread_num) {
+    nodes.reserve(thread_num + 1);
+    lock_.reset(newNode());
+    for (unsigned i = 0; i < thread_num; ++i) {
+      newNode();
+    }
+  }
+  ~LockAdapter() {
+    for (QNode *node : nodes) {
+      free(node);
+    }
+  }
+  void initContext(Context &c) { c.node = nodes[taomp::get_thread_id() + 1]; }
+  void lock(Context &c) { c.pred = lock_.lock(c.node); }
+  // the predecessor's node is recycled for the next lock()
+  void unlock(Context &c) {
+    lock_.unlock(c.node);
+    c.node = c.pred;
+  }
+};
+
+template <> class LockAdapter<taomp::MCSLock> {
+  using QNode = taomp::MCSLock::QNode;
+  taomp::MCSLock lock_;
+  taomp::ThreadLocal<QNode> nodes;
+
+public:
+  struct Context {
+    QNode *node;
+  };
+  LockAdapter(unsigned thread_num) : nodes(thread_num) {}
+  void initContext(Context &c) {
+    c.node = &nodes.get();
+    c.node->store(0, std::memory_order_relaxed);
+  }
+  void lock(Context &c) { lock_.lock(c.node); }
+  void unlock(Context &c) { lock_.unlock(c.node); }
+};
+
+struct SharedState {
+  // written only under the lock
+  uint64_t count = 0;
+  taomp::TimeStamp released = 0;
+  unsigned owner = ~0u;
+  taomp::ThreadLocal<uint64_t> acquisitions{max_thread_num};
+  taomp::ShardedHistogram<> handoff{max_thread_num};
+  // threads done with the lock and their acquisitions
+  std::atomic<unsigned> arrived{0};
+};
+
+template <typename Lock>
+static void BM_LockSuite(benchmark::State &state) {
+  static std::atomic<LockAdapter<Lock> *> shared_lock{nullptr};
+  static SharedState *shared;
+  unsigned tid = state.thread_index;
+  unsigned threads = state.threads;
+  uint64_t cs_cycles = state.range(0), ncs_cycles = state.range(1);
+  taomp::init_pinned_thread(tid);
+  if (!tid) {
+    shared = new SharedState;
+    shared_lock.store(new LockAdapter<Lock>(threads),
+                      std::memory_order_release);
+  }
+  LockAdapter<Lock> *lock;
+  while (!(lock = shared_lock.load(std::memory_order_acquire))) {
+    continue;
+  }
+  typename LockAdapter<Lock>::Context context;
+  lock->initContext(context);
+  uint64_t mine = 0;
+  uint64_t target = 0;
+  for (auto _ : state) {
+    // every iteration takes the shared count N * threads further; which
+    // thread gets the acquisitions is up to the lock
+    target += uint64_t(N) * threads;
+    while (true) {
+      taomp::TimeStamp start = taomp::readCPUCycleCount();
+      lock->lock(context);
+      taomp::TimeStamp now = taomp::readCPUCycleCount();
+      if (shared->count >= target) {
+        lock->unlock(context);
+        break;
+      }
+      if (shared->owner != tid && shared->released > start) {
+        shared->handoff.record(now - shared->released);
+      }
+      ++shared->count;
+      ++mine;
+      spinCycles(cs_cycles);
+      shared->owner = tid;
+      shared->released = taomp::readCPUCycleCount();
+      lock->unlock(context);
+      spinCycles(ncs_cycles);
+    }
+  }
+  shared->acquisitions[tid] = mine;
+  shared->arrived.fetch_add(1, std::memory_order_release);
+  state.SetItemsProcessed(mine);
+  // thread 0 aggregates and frees once every thread has arrived; counters
+  // are summed over threads, so only thread 0 reports
+  if (!tid) {
+    while (shared->arrived.load(std::memory_order_acquire) != threads) {
+      std::this_thread::yield();
+    }
+    double sum = 0, sum2 = 0;
+    for (unsigned i = 0; i < threads; ++i) {
+      double x = shared->acquisitions[i];
+      sum += x;
+      sum2 += x * x;
+    }
+    state.counters["jain"] = sum2 ? sum * sum / (threads * sum2) : 1;
+    auto hist = shared->handoff.read();
+    uint64_t total = 0;
+    for (uint64_t n : hist) {
+      total += n;
+    }
+    auto percentile = [&](double p) -> double {
+      uint64_t seen = 0;
+      for (unsigned b = 0; b < hist.size(); ++b) {
+        seen += hist[b];
+        if (seen && seen >= p * total) {
+          return b ? double(uint64_t(1) << (b - 1)) * 2 - 1 : 0;
+        }
+      }
+      return 0;
+    };
+    state.counters["handoff_p50"] = percentile(0.5);
+    state.counters["handoff_p99"] = percentile(0.99);
+    state.counters["handoff_max"] = percentile(1);
+    for (unsigned b = 0; b < hist.size(); ++b) {
+      if (hist[b]) {
+        state.counters["handoff_log2_" + std::to_string(b)] = hist[b];
+      }
+    }
+    shared_lock.store(nullptr, std::memory_order_relaxed);
+    delete lock;
+    delete shared;
+  }
+}
+
+static void configure(benchmark::internal::Benchmark *b) {
+  b->ArgNames({"cs_cycles", "ncs_cycles"});
+  for (int cs : {0, 100, 1000}) {
+    for (int ncs : {0, 1000}) {
+      b->Args({cs, ncs});
+    }
+  }
+  b->ThreadRange(1, std::min(cpuNum(), max_thread_num));
+  b->UseRealTime();
+}
+
+BENCHMARK_TEMPLATE(BM_LockSuite, taomp::TASLock)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, taomp::TTASLock)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, WithBackoff<taomp::TASLock>)
+    ->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, WithBackoff<taomp::TTASLock>)
+    ->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, taomp::ArrayLock)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, taomp::CLHLock)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, taomp::MCSLock)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, taomp::PThreadSpinLock)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, tbb::spin_mutex)->Apply(configure);
+BENCHMARK_TEMPLATE(BM_LockSuite, std::mutex)->Apply(configure);
+BENCHMARK_MAIN();
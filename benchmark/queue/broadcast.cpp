@@ -0,0 +1,116 @@
+#include "taomp/broadcast_ring.hpp"
+#include "taomp/ms_queue.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <vector>
+
+/**Fan-out of one event stream: thread 0 publishes N events per iteration,
+ * every other thread consumes all of them. Only the producer reports items,
+ * so items/s are events/s whatever the number of consumers.
+ * BM_Ring: one BroadcastRing, the consumers read it in batches.
+ * BM_QueuePerConsumer: the producer enqueues a copy of every event into one
+ * MSQueue per consumer.
+ */
+
+const int N = 1000;
+const int max_consumer_num = 8;
+const std::size_t capacity = 1024;
+
+struct Event {
+  uint64_t seq;
+  uint64_t payload[3];
+};
+
+template <typename Ring> static void BM_Ring(benchmark::State &state) {
+  static std::unique_ptr<Ring> ring;
+  unsigned consumer_num = state.threads - 1;
+  if (!state.thread_index) {
+    ring.reset(new Ring(consumer_num));
+  }
+  unsigned consumer = state.thread_index - 1;
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    if (!state.thread_index) {
+      for (int i = 0; i < N; ++i) {
+        ring->publish(Event{uint64_t(i), {}});
+      }
+    } else {
+      for (std::size_t got = 0; got < std::size_t(N);) {
+        got += ring->consume(
+            consumer, [&](uint64_t, const Event &e) { sum += e.seq; },
+            N - got);
+      }
+    }
+  }
+  benchmark::DoNotOptimize(sum);
+  if (!state.thread_index) {
+    state.SetItemsProcessed(state.iterations() * N);
+  }
+}
+
+static void BM_QueuePerConsumer(benchmark::State &state) {
+  using Queue = taomp::MSQueue<Event>;
+  static std::vector<std::unique_ptr<Queue>> queues;
+  unsigned consumer_num = state.threads - 1;
+  if (!state.thread_index) {
+    queues.clear();
+    for (unsigned c = 0; c < consumer_num; ++c) {
+      queues.emplace_back(new Queue(state.threads));
+    }
+  }
+  taomp::init_pinned_thread(state.thread_index);
+  uint64_t sum = 0;
+  for (auto _ : state) {
+    if (!state.thread_index) {
+      for (int i = 0; i < N; ++i) {
+        for (auto &q : queues) {
+          q->enqueue(Event{uint64_t(i), {}});
+        }
+      }
+    } else {
+      Queue &q = *queues[state.thread_index - 1];
+      for (int got = 0; got < N;) {
+        if (std::optional<Event> e = q.dequeue()) {
+          sum += e->seq;
+          ++got;
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+  benchmark::DoNotOptimize(sum);
+  if (!state.thread_index) {
+    state.SetItemsProcessed(state.iterations() * N);
+  }
+}
+
+using SpinRing = taomp::BroadcastRing<Event, capacity>;
+using BackoffRing = taomp::BroadcastRing<Event, capacity, taomp::SingleProducer,
+                                         taomp::BackoffWait<>>;
+using FutexRing = taomp::BroadcastRing<Event, capacity, taomp::SingleProducer,
+                                       taomp::FutexWait>;
+using MultiProducerRing =
+    taomp::MultiProducerBroadcastRing<Event, capacity, taomp::FutexWait>;
+
+BENCHMARK_TEMPLATE(BM_Ring, SpinRing)
+    ->DenseThreadRange(2, max_consumer_num + 1)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Ring, BackoffRing)
+    ->DenseThreadRange(2, max_consumer_num + 1)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Ring, FutexRing)
+    ->DenseThreadRange(2, max_consumer_num + 1)
+    ->UseRealTime();
+BENCHMARK_TEMPLATE(BM_Ring, MultiProducerRing)
+    ->DenseThreadRange(2, max_consumer_num + 1)
+    ->UseRealTime();
+BENCHMARK(BM_QueuePerConsumer)
+    ->DenseThreadRange(2, max_consumer_num + 1)
+    ->UseRealTime();
+BENCHMARK_MAIN();
@@ -0,0 +1,115 @@
+#include "taomp/kp_queue.hpp"
+#include "taomp/ms_queue.hpp"
+#include "taomp/timing.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+/**Per-operation latency distribution of the lock-free MSQueue and the
+ * wait-free KPQueue under a 50/50 enqueue/dequeue mix. Latencies are taken in
+ * readCPUCycleCount() ticks and reported in ns; the tail percentiles are
+ * reported as counters by the last thread to finish.
+ * BM_DequeueLatency only times the dequeues of MSQueue, which retire the
+ * nodes, with the hazard pointer scans run inline and by a reclaimer thread.
+ */
+
+const int N = 1000;
+const int thread_num = 16;
+
+static void reportPercentiles(benchmark::State &state,
+                              std::vector<taomp::TimeStamp> &samples) {
+  std::sort(samples.begin(), samples.end());
+  auto percentile = [&](double p) {
+    return double(taomp::ticksToNs(samples[size_t(p * (samples.size() - 1))]));
+  };
+  if (!samples.empty()) {
+    state.counters["p50"] = percentile(0.5);
+    state.counters["p99"] = percentile(0.99);
+    state.counters["p99.9"] = percentile(0.999);
+    state.counters["p99.99"] = percentile(0.9999);
+    state.counters["max"] = double(taomp::ticksToNs(samples.back()));
+  }
+  samples.clear();
+}
+
+template <typename QueueTy> static void BM_QueueLatency(benchmark::State &state) {
+  static QueueTy queue(thread_num);
+  static std::mutex samples_mutex;
+  static std::vector<taomp::TimeStamp> samples;
+  static std::atomic<int> finished{0};
+  taomp::init_pinned_thread(state.thread_index);
+  std::vector<taomp::TimeStamp> local;
+  local.reserve(2 * N);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      taomp::TimeStamp t0 = taomp::readCPUCycleCount();
+      queue.enqueue(i);
+      taomp::TimeStamp t1 = taomp::readCPUCycleCount();
+      benchmark::DoNotOptimize(queue.dequeue());
+      taomp::TimeStamp t2 = taomp::readCPUCycleCount();
+      if (local.size() + 2 <= local.capacity()) {
+        local.push_back(t1 - t0);
+        local.push_back(t2 - t1);
+      }
+    }
+  }
+  std::lock_guard<std::mutex> guard(samples_mutex);
+  samples.insert(samples.end(), local.begin(), local.end());
+  if (finished.fetch_add(1) + 1 != state.threads) {
+    return;
+  }
+  reportPercentiles(state, samples);
+  finished.store(0);
+}
+
+// thread id thread_num is left to the reclaimer
+template <bool Background>
+static void BM_DequeueLatency(benchmark::State &state) {
+  static taomp::MSQueue<int, false,
+                        taomp::HazardPointer<std::allocator<int>, true>, true>
+      queue(thread_num + 1);
+  static bool started = [] {
+    if (Background) {
+      queue.getGC().startReclaimer(thread_num, 1 << 16);
+    }
+    return true;
+  }();
+  (void)started;
+  static std::mutex samples_mutex;
+  static std::vector<taomp::TimeStamp> samples;
+  static std::atomic<int> finished{0};
+  taomp::init_pinned_thread(state.thread_index);
+  std::vector<taomp::TimeStamp> local;
+  local.reserve(N * 64);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      queue.enqueue(i);
+      taomp::TimeStamp t0 = taomp::readCPUCycleCount();
+      benchmark::DoNotOptimize(queue.dequeue());
+      taomp::TimeStamp t1 = taomp::readCPUCycleCount();
+      if (local.size() < local.capacity()) {
+        local.push_back(t1 - t0);
+      }
+    }
+  }
+  std::lock_guard<std::mutex> guard(samples_mutex);
+  samples.insert(samples.end(), local.begin(), local.end());
+  if (finished.fetch_add(1) + 1 != state.threads) {
+    return;
+  }
+  reportPercentiles(state, samples);
+  taomp::StatsSnapshot s = queue.snapshot();
+  state.counters["handoffs"] = s[taomp::StatKind::ReclaimHandOff];
+  state.counters["backpressure"] = s[taomp::StatKind::ReclaimBackpressure];
+  finished.store(0);
+}
+
+BENCHMARK_TEMPLATE(BM_QueueLatency, taomp::MSQueue<int>)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_QueueLatency, taomp::KPQueue<int>)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_DequeueLatency, false)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_DequeueLatency, true)->ThreadRange(1, thread_num);
+BENCHMARK_MAIN();
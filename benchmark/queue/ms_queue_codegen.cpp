@@ -0,0 +1,32 @@
+#include "taomp/ms_queue.hpp"
+#include <memory>
+
+/**Not a benchmark: a codegen probe which instantiates MSQueue<int> with each
+ * memory ordering policy behind a non-inline function, to compare the
+ * generated code, e.g. on aarch64, where SeqCstOrder gives ldar/stlr plus
+ * dmb around the CASes and AcqRelOrder only the acquire/release forms:
+ *   aarch64-linux-gnu-g++ -std=c++17 -O2 -S -I. \
+ *       benchmark/queue/ms_queue_codegen.cpp -o - | c++filt
+ * Add -march=armv8.1-a to get LSE casal instead of ldaxr/stlxr loops.
+ */
+
+namespace {
+using HP = taomp::HazardPointer<std::allocator<int>>;
+using SeqCstQueue = taomp::MSQueue<int, false, HP, false, taomp::SeqCstOrder>;
+using AcqRelQueue = taomp::MSQueue<int, false, HP, false, taomp::AcqRelOrder>;
+} // namespace
+
+__attribute__((noinline)) void probeEnqueueSeqCst(SeqCstQueue &q, int v) {
+  q.enqueue(v);
+}
+__attribute__((noinline)) std::optional<int>
+probeDequeueSeqCst(SeqCstQueue &q) {
+  return q.dequeue();
+}
+__attribute__((noinline)) void probeEnqueueAcqRel(AcqRelQueue &q, int v) {
+  q.enqueue(v);
+}
+__attribute__((noinline)) std::optional<int>
+probeDequeueAcqRel(AcqRelQueue &q) {
+  return q.dequeue();
+}
@@ -0,0 +1,175 @@
+#include "taomp/ms_queue.hpp"
+#include "taomp/multi_queue.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**Relaxed MultiQueues against the strict MSQueue. BM_Throughput runs
+ * enqueue/dequeue pairs. BM_RankError measures the ordering quality: every
+ * enqueue and dequeue takes a ticket from a global counter, and afterwards
+ * the events are replayed in ticket order; the rank error of a dequeue is
+ * the number of elements present with a smaller key than the one returned.
+ * FIFO keys are the enqueue tickets, priority keys a hash of them. The
+ * tickets serialize the threads, so its throughput is not comparable.
+ */
+
+const int N = 1000;
+const int thread_num = 16;
+const int prefill = 4096;
+
+template <typename QueueTy> using ElementOf =
+    typename decltype(std::declval<QueueTy &>().dequeue())::value_type;
+
+static uint64_t hashKey(uint64_t x) {
+  // splitmix64 finalizer, a bijection, so the keys stay unique
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+template <typename Ty> struct Element {
+  static Ty make(uint64_t ticket) { return Ty(ticket); }
+  static uint64_t key(const Ty &v) { return v; }
+};
+
+template <> struct Element<std::pair<uint64_t, uint64_t>> {
+  static std::pair<uint64_t, uint64_t> make(uint64_t ticket) {
+    return {hashKey(ticket), ticket};
+  }
+  static uint64_t key(const std::pair<uint64_t, uint64_t> &v) {
+    return v.first;
+  }
+};
+
+template <typename QueueTy>
+static void BM_Throughput(benchmark::State &state) {
+  using E = Element<ElementOf<QueueTy>>;
+  static QueueTy queue(thread_num);
+  taomp::init_pinned_thread(state.thread_index);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      queue.enqueue(E::make(i));
+      benchmark::DoNotOptimize(queue.dequeue());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N * 2);
+}
+
+struct Event {
+  uint64_t ticket;
+  uint64_t key;
+  bool enqueue;
+};
+
+static void reportRankError(benchmark::State &state,
+                            std::vector<Event> &events) {
+  std::sort(events.begin(), events.end(),
+            [](const Event &a, const Event &b) { return a.ticket < b.ticket; });
+  std::vector<uint64_t> keys;
+  for (const Event &e : events) {
+    if (e.enqueue) {
+      keys.push_back(e.key);
+    }
+  }
+  std::sort(keys.begin(), keys.end());
+  // Fenwick tree over the ranks of the keys present
+  std::vector<int64_t> tree(keys.size() + 1, 0);
+  auto add = [&](std::size_t i, int64_t v) {
+    for (++i; i < tree.size(); i += i & -i) {
+      tree[i] += v;
+    }
+  };
+  auto prefix = [&](std::size_t i) {
+    int64_t sum = 0;
+    for (; i; i -= i & -i) {
+      sum += tree[i];
+    }
+    return sum;
+  };
+  double total = 0;
+  int64_t max = 0, dequeues = 0;
+  for (const Event &e : events) {
+    std::size_t rank =
+        std::lower_bound(keys.begin(), keys.end(), e.key) - keys.begin();
+    if (e.enqueue) {
+      add(rank, 1);
+    } else {
+      int64_t error = prefix(rank);
+      total += error;
+      max = std::max(max, error);
+      ++dequeues;
+      add(rank, -1);
+    }
+  }
+  state.counters["rank_error_mean"] = dequeues ? total / dequeues : 0;
+  state.counters["rank_error_max"] = max;
+  events.clear();
+}
+
+template <typename QueueTy>
+static void BM_RankError(benchmark::State &state) {
+  using E = Element<ElementOf<QueueTy>>;
+  static QueueTy queue(thread_num);
+  static std::atomic<uint64_t> ticket{0};
+  static std::mutex events_mutex;
+  static std::vector<Event> events;
+  static std::atomic<int> finished{0};
+  taomp::init_pinned_thread(state.thread_index);
+  std::vector<Event> local;
+  if (!state.thread_index) {
+    // the queue is drained after every run, so all of its elements are
+    // recorded
+    for (int i = 0; i < prefill; ++i) {
+      uint64_t t = ticket.fetch_add(1);
+      auto v = E::make(t);
+      local.push_back({t, E::key(v), true});
+      queue.enqueue(std::move(v));
+    }
+  }
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      uint64_t t = ticket.fetch_add(1);
+      auto v = E::make(t);
+      local.push_back({t, E::key(v), true});
+      queue.enqueue(std::move(v));
+      if (auto r = queue.dequeue()) {
+        local.push_back({ticket.fetch_add(1), E::key(*r), false});
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N * 2);
+  std::lock_guard<std::mutex> guard(events_mutex);
+  events.insert(events.end(), local.begin(), local.end());
+  if (finished.fetch_add(1) + 1 != state.threads) {
+    return;
+  }
+  while (queue.dequeue()) {
+  }
+  reportRankError(state, events);
+  finished.store(0);
+}
+
+#define QUEUE_BENCHMARKS(BM)                                                   \
+  BENCHMARK_TEMPLATE(BM, taomp::MSQueue<uint64_t>)->ThreadRange(1, thread_num); \
+  BENCHMARK_TEMPLATE(BM, taomp::MultiQueue<uint64_t>)                          \
+      ->ThreadRange(1, thread_num);                                            \
+  BENCHMARK_TEMPLATE(BM, taomp::MultiQueue<uint64_t, taomp::MSSubQueue>)       \
+      ->ThreadRange(1, thread_num);                                            \
+  BENCHMARK_TEMPLATE(BM,                                                       \
+                     taomp::MultiQueue<uint64_t, taomp::BoundedSubQueue<1024>>) \
+      ->ThreadRange(1, thread_num);                                            \
+  BENCHMARK_TEMPLATE(BM, taomp::MultiQueue<uint64_t, taomp::LockedSubQueue, 2, \
+                                           1>)                                 \
+      ->ThreadRange(1, thread_num);                                            \
+  BENCHMARK_TEMPLATE(BM, taomp::RelaxedPriorityQueue<uint64_t>)                \
+      ->ThreadRange(1, thread_num)
+
+QUEUE_BENCHMARKS(BM_Throughput);
+QUEUE_BENCHMARKS(BM_RankError);
+BENCHMARK_MAIN();
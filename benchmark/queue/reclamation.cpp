@@ -0,0 +1,79 @@
+#include "taomp/hazard_eras.hpp"
+#include "taomp/hazard_pointer.hpp"
+#include "taomp/ms_queue.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <memory>
+
+/**Memory reclamation schemes compared as the GC of MSQueue, every thread
+ * running enqueue/dequeue pairs, with the scans and reclaimed nodes per
+ * dequeue as counters. BM_Traverse walks a list which never changes while
+ * protecting every node: a hazard pointer is a seq_cst store per node, a
+ * hazard era is only written again when the era has moved.
+ */
+
+const int N = 1000;
+const int thread_num = 16;
+const int list_length = 256;
+
+using HP = taomp::HazardPointer<std::allocator<int>, true>;
+using HE = taomp::HazardEras<std::allocator<int>, true>;
+
+template <typename GC> static void BM_Reclamation(benchmark::State &state) {
+  static taomp::MSQueue<int, false, GC, true> queue(thread_num);
+  taomp::init_pinned_thread(state.thread_index);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      queue.enqueue(i);
+      benchmark::DoNotOptimize(queue.dequeue());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N * 2);
+  if (!state.thread_index) {
+    taomp::StatsSnapshot s = queue.snapshot();
+    double dequeues = double(state.iterations()) * N * state.threads;
+    state.counters["scans/deq"] = s[taomp::StatKind::Scan] / dequeues;
+    state.counters["reclaimed/deq"] = s[taomp::StatKind::Reclaimed] / dequeues;
+  }
+}
+
+struct ListNode {
+  taomp::Atomic<ListNode *> next{nullptr};
+  int value = 0;
+};
+
+template <typename GC> static void BM_Traverse(benchmark::State &state) {
+  using RGC = typename taomp::internal::RebindGC<GC, ListNode>::type;
+  static RGC gc(thread_num, 2 * thread_num);
+  static taomp::Atomic<ListNode *> head = [] {
+    ListNode *h = nullptr;
+    for (int i = 0; i < list_length; ++i) {
+      ListNode *node = new (gc.allocate(1)) ListNode();
+      node->value = i;
+      node->next.store(h, std::memory_order_relaxed);
+      h = node;
+    }
+    return h;
+  }();
+  taomp::init_pinned_thread(state.thread_index);
+  unsigned slot = state.thread_index << 1;
+  for (auto _ : state) {
+    long sum = 0;
+    ListNode *cur = gc.protect(slot, head);
+    for (unsigned k = 1; cur; k ^= 1) {
+      sum += cur->value;
+      cur = gc.protect(slot + k, cur->next);
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  gc.clear(slot);
+  gc.clear(slot + 1);
+  state.SetItemsProcessed(state.iterations() * list_length);
+}
+
+BENCHMARK_TEMPLATE(BM_Reclamation, HP)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_Reclamation, HE)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_Traverse, HP)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_Traverse, HE)->ThreadRange(1, thread_num);
+BENCHMARK_MAIN();
@@ -0,0 +1,92 @@
+#include "taomp/hazard_pointer.hpp"
+#include "taomp/rcu.hpp"
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include "benchmark/benchmark.h"
+#include <atomic>
+#include <memory>
+
+/**Read throughput of a read-mostly table: every thread reads the current
+ * table N times per iteration, and thread 0 also swaps in a new one every
+ * UpdateEvery reads. Readers protect the table with an RcuQsbr, whose
+ * threads are online during an iteration and offline between them, an RcuMb
+ * read-side critical section, or a hazard pointer, which costs a store, a
+ * full fence and a re-check per read.
+ */
+
+const int N = 1 << 12;
+const int UpdateEvery = 1 << 10;
+const unsigned max_thread_num = 64;
+
+struct Table {
+  int routes[16];
+};
+
+static int readTable(const Table *t) {
+  int sum = 0;
+  for (int r : t->routes) {
+    sum += r;
+  }
+  return sum;
+}
+
+template <typename Rcu> static void BM_RcuRead(benchmark::State &state) {
+  static Rcu rcu(max_thread_num);
+  static taomp::RcuPtr<Table, Rcu> table(rcu, std::make_unique<Table>());
+  unsigned tid = state.thread_index;
+  taomp::init_pinned_thread(tid);
+  int i = 0;
+  for (auto _ : state) {
+    // offline between iterations, where google benchmark may block the
+    // thread while thread 0 waits for a grace period
+    rcu.threadOnline();
+    for (int k = 0; k < N; ++k) {
+      {
+        taomp::RcuReadGuard<Rcu> guard(rcu);
+        benchmark::DoNotOptimize(readTable(table.get()));
+      }
+      if (!tid && ++i == UpdateEvery) {
+        i = 0;
+        table.update(std::make_unique<Table>());
+      }
+    }
+    rcu.threadOffline();
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+static void BM_HazardPointerRead(benchmark::State &state) {
+  static taomp::HazardPointer<std::allocator<Table>> hp(max_thread_num,
+                                                        max_thread_num);
+  static std::atomic<Table *> table{new Table()};
+  unsigned tid = state.thread_index;
+  taomp::init_pinned_thread(tid);
+  int i = 0;
+  for (auto _ : state) {
+    for (int k = 0; k < N; ++k) {
+      Table *t = table.load(std::memory_order_acquire);
+      while (true) {
+        hp.preserve(tid, t, std::memory_order_seq_cst);
+        Table *t1 = table.load(std::memory_order_acquire);
+        if (t1 == t) {
+          break;
+        }
+        t = t1;
+      }
+      benchmark::DoNotOptimize(readTable(t));
+      hp.preserve<Table>(tid, nullptr, std::memory_order_release);
+      if (!tid && ++i == UpdateEvery) {
+        i = 0;
+        Table *fresh = hp.allocate(1);
+        new (fresh) Table();
+        hp.retire(table.exchange(fresh, std::memory_order_acq_rel));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+BENCHMARK_TEMPLATE(BM_RcuRead, taomp::RcuQsbr)->ThreadRange(1, max_thread_num);
+BENCHMARK_TEMPLATE(BM_RcuRead, taomp::RcuMb)->ThreadRange(1, max_thread_num);
+BENCHMARK(BM_HazardPointerRead)->ThreadRange(1, max_thread_num);
+BENCHMARK_MAIN();
@@ -0,0 +1,120 @@
+#include "taomp/shm.hpp"
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/**One-way message throughput between two processes: a ShmChannel in a memfd
+ * arena, where the consumer reads every message in place, against an
+ * AF_UNIX SOCK_SEQPACKET socketpair, which copies every message into and out
+ * of the kernel. The consumer is forked per benchmark run and acknowledges
+ * every batch of N messages, so an iteration is N messages end to end.
+ */
+
+const int N = 1000;
+
+template <std::size_t MessageSize> struct ShmState {
+  taomp::ShmChannel<MessageSize, 256> channel;
+  taomp::Atomic<uint64_t> consumed{0};
+  taomp::Atomic<bool> stop{false};
+};
+
+template <std::size_t MessageSize>
+static void BM_ShmChannel(benchmark::State &state) {
+  using State = ShmState<MessageSize>;
+  taomp::ShmArena arena = taomp::ShmArena::anonymous(sizeof(State) + 8192);
+  State *shared = arena.construct<State>();
+  pid_t pid = fork();
+  if (pid == 0) {
+    uint64_t consumed = 0, sum = 0;
+    while (!shared->stop.load(std::memory_order_acquire)) {
+      char *msg = shared->channel.receive();
+      if (!msg) {
+        std::this_thread::yield();
+        continue;
+      }
+      sum += msg[0] + msg[MessageSize - 1];
+      shared->channel.release(msg);
+      shared->consumed.store(++consumed, std::memory_order_release);
+    }
+    benchmark::DoNotOptimize(sum);
+    _exit(0);
+  }
+  uint64_t sent = 0;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      char *msg;
+      while (!(msg = shared->channel.acquire())) {
+        std::this_thread::yield();
+      }
+      msg[0] = msg[MessageSize - 1] = char(i);
+      shared->channel.post(msg);
+    }
+    sent += N;
+    while (shared->consumed.load(std::memory_order_acquire) < sent) {
+      std::this_thread::yield();
+    }
+  }
+  shared->stop.store(true, std::memory_order_release);
+  waitpid(pid, nullptr, 0);
+  state.SetItemsProcessed(state.iterations() * N);
+  state.SetBytesProcessed(state.iterations() * N * MessageSize);
+}
+
+template <std::size_t MessageSize>
+static void BM_UnixSocket(benchmark::State &state) {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds)) {
+    state.SkipWithError("socketpair failed");
+    return;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    std::vector<char> msg(MessageSize);
+    uint64_t sum = 0;
+    int count = 0;
+    while (read(fds[1], msg.data(), MessageSize) > 0) {
+      sum += msg[0] + msg[MessageSize - 1];
+      if (++count == N) {
+        char ack = 0;
+        count = 0;
+        if (write(fds[1], &ack, 1) != 1) {
+          break;
+        }
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+    _exit(0);
+  }
+  close(fds[1]);
+  std::vector<char> msg(MessageSize);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      msg[0] = msg[MessageSize - 1] = char(i);
+      if (write(fds[0], msg.data(), MessageSize) != ssize_t(MessageSize)) {
+        state.SkipWithError("write failed");
+        break;
+      }
+    }
+    char ack;
+    if (read(fds[0], &ack, 1) != 1) {
+      state.SkipWithError("read failed");
+      break;
+    }
+  }
+  close(fds[0]);
+  waitpid(pid, nullptr, 0);
+  state.SetItemsProcessed(state.iterations() * N);
+  state.SetBytesProcessed(state.iterations() * N * MessageSize);
+}
+
+BENCHMARK_TEMPLATE(BM_ShmChannel, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_ShmChannel, 4096)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_UnixSocket, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_UnixSocket, 4096)->UseRealTime();
+BENCHMARK_MAIN();
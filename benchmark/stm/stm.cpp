@@ -0,0 +1,307 @@
+#include "taomp/lock.hpp"
+#include "taomp/stm.hpp"
+#include "benchmark/benchmark.h"
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+/**TL2 transactions against a global std::mutex and fine-grained TTASLocks:
+ * BM_Bank: transfers between two random accounts, the fine-grained version
+ * locks both accounts in index order.
+ * BM_List: a sorted linked list set of keys in [0, key_range), 10% inserts,
+ * 10% removes and 80% lookups. The fine-grained version is the hand-over-
+ * hand locked list; the transactional one reuses removed nodes per thread,
+ * since a node may still be read by a transaction about to abort.
+ */
+
+const int N = 1000;
+const int thread_num = 16;
+const unsigned account_num = 1024;
+const int key_range = 512;
+
+static uint64_t nextRandom(uint64_t &x) {
+  x = x * 6364136223846793005ull + 1442695040888963407ull;
+  return x >> 33;
+}
+
+class StmBank {
+  taomp::TVar<long> accounts[account_num];
+
+public:
+  void transfer(unsigned from, unsigned to, long amount) {
+    taomp::atomically([&] {
+      accounts[from].store(accounts[from].load() - amount);
+      accounts[to].store(accounts[to].load() + amount);
+    });
+  }
+};
+
+class GlobalLockBank {
+  std::mutex lock;
+  long accounts[account_num] = {};
+
+public:
+  void transfer(unsigned from, unsigned to, long amount) {
+    std::lock_guard<std::mutex> guard(lock);
+    accounts[from] -= amount;
+    accounts[to] += amount;
+  }
+};
+
+class FineGrainedBank {
+  struct Account {
+    alignas(taomp::CacheLineSize) taomp::TTASLock lock;
+    long balance = 0;
+  };
+  Account accounts[account_num];
+
+public:
+  void transfer(unsigned from, unsigned to, long amount) {
+    if (from == to) {
+      return;
+    }
+    Account &first = accounts[std::min(from, to)];
+    Account &second = accounts[std::max(from, to)];
+    std::lock_guard<taomp::TTASLock> guard1(first.lock);
+    std::lock_guard<taomp::TTASLock> guard2(second.lock);
+    accounts[from].balance -= amount;
+    accounts[to].balance += amount;
+  }
+};
+
+template <typename Bank> static void BM_Bank(benchmark::State &state) {
+  static Bank bank;
+  uint64_t x = state.thread_index + 1;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      unsigned from = nextRandom(x) % account_num;
+      unsigned to = nextRandom(x) % account_num;
+      bank.transfer(from, to, nextRandom(x) % 100);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+class StmList {
+  struct Node {
+    taomp::TVar<int> key;
+    taomp::TVar<Node *> next;
+  };
+  Node head, tail;
+
+  static std::vector<Node *> &pool() {
+    static thread_local std::vector<Node *> nodes;
+    return nodes;
+  }
+
+  // the last node with a key below key, and its successor
+  std::pair<Node *, Node *> find(int key) {
+    Node *pred = &head;
+    Node *curr = pred->next.load();
+    while (curr->key.load() < key) {
+      pred = curr;
+      curr = curr->next.load();
+    }
+    return {pred, curr};
+  }
+
+public:
+  StmList() {
+    head.key.store(INT_MIN);
+    tail.key.store(INT_MAX);
+    head.next.store(&tail);
+  }
+
+  bool insert(int key) {
+    Node *node;
+    if (pool().empty()) {
+      node = new Node;
+    } else {
+      node = pool().back();
+      pool().pop_back();
+    }
+    bool inserted = taomp::atomically([&] {
+      auto [pred, curr] = find(key);
+      if (curr->key.load() == key) {
+        return false;
+      }
+      node->key.store(key);
+      node->next.store(curr);
+      pred->next.store(node);
+      return true;
+    });
+    if (!inserted) {
+      pool().push_back(node);
+    }
+    return inserted;
+  }
+
+  bool remove(int key) {
+    Node *removed = taomp::atomically([&]() -> Node * {
+      auto [pred, curr] = find(key);
+      if (curr->key.load() != key) {
+        return nullptr;
+      }
+      pred->next.store(curr->next.load());
+      return curr;
+    });
+    if (removed) {
+      pool().push_back(removed);
+    }
+    return removed;
+  }
+
+  bool contains(int key) {
+    return taomp::atomically(
+        [&] { return find(key).second->key.load() == key; });
+  }
+};
+
+class GlobalLockList {
+  struct Node {
+    int key;
+    Node *next;
+  };
+  std::mutex lock;
+  Node tail{INT_MAX, nullptr};
+  Node head{INT_MIN, &tail};
+
+  Node *findPred(int key) {
+    Node *pred = &head;
+    while (pred->next->key < key) {
+      pred = pred->next;
+    }
+    return pred;
+  }
+
+public:
+  bool insert(int key) {
+    std::lock_guard<std::mutex> guard(lock);
+    Node *pred = findPred(key);
+    if (pred->next->key == key) {
+      return false;
+    }
+    pred->next = new Node{key, pred->next};
+    return true;
+  }
+
+  bool remove(int key) {
+    std::lock_guard<std::mutex> guard(lock);
+    Node *pred = findPred(key);
+    Node *curr = pred->next;
+    if (curr->key != key) {
+      return false;
+    }
+    pred->next = curr->next;
+    delete curr;
+    return true;
+  }
+
+  bool contains(int key) {
+    std::lock_guard<std::mutex> guard(lock);
+    return findPred(key)->next->key == key;
+  }
+};
+
+class FineGrainedList {
+  struct Node {
+    int key;
+    Node *next;
+    taomp::TTASLock lock;
+    Node(int key, Node *next) : key(key), next(next) {}
+  };
+  Node tail{INT_MAX, nullptr};
+  Node head{INT_MIN, &tail};
+
+  // returns pred and curr = pred->next, both locked, curr->key >= key
+  std::pair<Node *, Node *> find(int key) {
+    Node *pred = &head;
+    pred->lock.lock();
+    Node *curr = pred->next;
+    curr->lock.lock();
+    while (curr->key < key) {
+      pred->lock.unlock();
+      pred = curr;
+      curr = curr->next;
+      curr->lock.lock();
+    }
+    return {pred, curr};
+  }
+
+public:
+  bool insert(int key) {
+    auto [pred, curr] = find(key);
+    bool inserted = curr->key != key;
+    if (inserted) {
+      pred->next = new Node{key, curr};
+    }
+    curr->lock.unlock();
+    pred->lock.unlock();
+    return inserted;
+  }
+
+  bool remove(int key) {
+    auto [pred, curr] = find(key);
+    bool removed = curr->key == key;
+    if (removed) {
+      pred->next = curr->next;
+    }
+    curr->lock.unlock();
+    pred->lock.unlock();
+    if (removed) {
+      // nobody else can reach curr: it would have to hold pred first
+      delete curr;
+    }
+    return removed;
+  }
+
+  bool contains(int key) {
+    auto [pred, curr] = find(key);
+    bool found = curr->key == key;
+    curr->lock.unlock();
+    pred->lock.unlock();
+    return found;
+  }
+};
+
+template <typename List> static List &prefilledList() {
+  static List list;
+  static bool filled = [] {
+    for (int key = 0; key < key_range; key += 2) {
+      list.insert(key);
+    }
+    return true;
+  }();
+  (void)filled;
+  return list;
+}
+
+template <typename List> static void BM_List(benchmark::State &state) {
+  List &list = prefilledList<List>();
+  uint64_t x = state.thread_index + 1;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      int key = nextRandom(x) % key_range;
+      unsigned op = nextRandom(x) % 10;
+      if (op == 0) {
+        list.insert(key);
+      } else if (op == 1) {
+        list.remove(key);
+      } else {
+        benchmark::DoNotOptimize(list.contains(key));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+BENCHMARK_TEMPLATE(BM_Bank, StmBank)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_Bank, GlobalLockBank)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_Bank, FineGrainedBank)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_List, StmList)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_List, GlobalLockList)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_List, FineGrainedList)->ThreadRange(1, thread_num);
+BENCHMARK_MAIN();
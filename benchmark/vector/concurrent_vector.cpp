@@ -0,0 +1,107 @@
+#include "taomp/concurrent_vector.hpp"
+#include "taomp/lock.hpp"
+#include "benchmark/benchmark.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "tbb/concurrent_vector.h"
+
+/**A shared append-only log of 16-byte records:
+ * BM_Append: every thread pushes N records per iteration. Thread 0 starts
+ * every run on a fresh vector, the iterations are fixed so that the memory
+ * stays bounded on 64 threads.
+ * BM_Read: indexed reads at pseudo-random positions of a prefilled vector.
+ * LockedVector is the std::vector behind a lock being replaced; its reads
+ * take the lock too, since a push may reallocate.
+ */
+
+const int N = 1000;
+const int thread_num = 64;
+const int iterations = 64;
+const unsigned prefill = 1 << 20;
+
+struct Record {
+  uint64_t key, value;
+};
+
+class TaompVector {
+  taomp::ConcurrentVector<Record> vec;
+
+public:
+  void push(const Record &r) { vec.push_back(r); }
+  uint64_t read(unsigned i) { return vec[i].value; }
+};
+
+class TbbVector {
+  tbb::concurrent_vector<Record> vec;
+
+public:
+  void push(const Record &r) { vec.push_back(r); }
+  uint64_t read(unsigned i) { return vec[i].value; }
+};
+
+template <typename Lock> class LockedVector {
+  Lock lock;
+  std::vector<Record> vec;
+
+public:
+  void push(const Record &r) {
+    std::lock_guard<Lock> guard(lock);
+    vec.push_back(r);
+  }
+  uint64_t read(unsigned i) {
+    std::lock_guard<Lock> guard(lock);
+    return vec[i].value;
+  }
+};
+
+template <typename Vector> static void BM_Append(benchmark::State &state) {
+  static std::unique_ptr<Vector> vec;
+  if (!state.thread_index) {
+    vec.reset(new Vector);
+  }
+  uint64_t key = uint64_t(state.thread_index) << 32;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      vec->push(Record{key++, uint64_t(i)});
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+template <typename Vector> static void BM_Read(benchmark::State &state) {
+  static std::unique_ptr<Vector> vec;
+  if (!state.thread_index) {
+    vec.reset(new Vector);
+    for (unsigned i = 0; i < prefill; ++i) {
+      vec->push(Record{i, i});
+    }
+  }
+  uint64_t x = state.thread_index + 1;
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i) {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+      benchmark::DoNotOptimize(vec->read((x >> 33) % prefill));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+
+BENCHMARK_TEMPLATE(BM_Append, TaompVector)
+    ->ThreadRange(1, thread_num)
+    ->Iterations(iterations);
+BENCHMARK_TEMPLATE(BM_Append, TbbVector)
+    ->ThreadRange(1, thread_num)
+    ->Iterations(iterations);
+BENCHMARK_TEMPLATE(BM_Append, LockedVector<std::mutex>)
+    ->ThreadRange(1, thread_num)
+    ->Iterations(iterations);
+BENCHMARK_TEMPLATE(BM_Append, LockedVector<taomp::TTASLock>)
+    ->ThreadRange(1, thread_num)
+    ->Iterations(iterations);
+BENCHMARK_TEMPLATE(BM_Read, TaompVector)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_Read, TbbVector)->ThreadRange(1, thread_num);
+BENCHMARK_TEMPLATE(BM_Read, LockedVector<std::mutex>)
+    ->ThreadRange(1, thread_num);
+BENCHMARK_MAIN();
@@ -10,10 +10,10 @@ public:
   ThreadLocalAllocator(unsigned thread_num) : arr(new T*[thread_num]{}) {
   }
   T* allocate() {
-    return arr[tm::get_thread_id()];
+    return arr[get_thread_id()];
   }
   void deallocate(T* p) {
-    arr[tm::get_thread_id()] = p;
+    arr[get_thread_id()] = p;
   }
 };
 }
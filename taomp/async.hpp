@@ -0,0 +1,336 @@
+#pragma once
+
+#if __has_include(<coroutine>) && __cplusplus > 201703L
+
+#include "taomp/atomic.hpp"
+#include "taomp/condition_variable.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**C++20 coroutine counterparts of the blocking primitives: a coroutine which
+ * has to wait for AsyncMutex or AsyncQueue suspends and gives its thread back
+ * to the executor, instead of spinning or sleeping in it. A suspended
+ * coroutine is resumed by posting it to the executor it named when it began
+ * to wait.
+ * The executors are minimal, meant for tests and benchmarks: ManualExecutor
+ * runs everything on the thread calling run(), ThreadPoolExecutor on a fixed
+ * number of threads sharing one FIFO.
+ */
+
+namespace taomp {
+
+class Executor {
+public:
+  virtual ~Executor() = default;
+  virtual void post(std::coroutine_handle<> handle) = 0;
+
+  /**co_await schedule() continues on this executor, behind what is already
+   * queued.
+   */
+  auto schedule() {
+    struct Awaiter {
+      Executor &executor;
+      bool await_ready() const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> handle) {
+        executor.post(handle);
+      }
+      void await_resume() const noexcept {}
+    };
+    return Awaiter{*this};
+  }
+};
+
+/**A coroutine which starts when posted to an executor and frees itself when
+ * it returns. Exceptions terminate.
+ */
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() {
+      return {std::coroutine_handle<promise_type>::from_promise(*this)};
+    }
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept { return {}; }
+    void return_void() {}
+    void unhandled_exception() { std::terminate(); }
+  };
+  std::coroutine_handle<promise_type> handle;
+};
+
+inline void spawn(Executor &executor, DetachedTask task) {
+  executor.post(task.handle);
+}
+
+/**Single threaded: post() may only be called from the thread which runs it.
+ */
+class ManualExecutor : public Executor {
+  std::deque<std::coroutine_handle<>> ready;
+
+public:
+  void post(std::coroutine_handle<> handle) override {
+    ready.push_back(handle);
+  }
+
+  /**Resume coroutines until none is ready, returns how many were resumed.
+   */
+  std::size_t run() {
+    std::size_t n = 0;
+    while (!ready.empty()) {
+      std::coroutine_handle<> handle = ready.front();
+      ready.pop_front();
+      handle.resume();
+      ++n;
+    }
+    return n;
+  }
+};
+
+/**thread_num threads, numbered first_tid, first_tid + 1, ... by
+ * init_thread(), resume the posted coroutines in FIFO order and sleep on a
+ * ConditionVariable while there is none.
+ */
+class ThreadPoolExecutor : public Executor {
+  TTASLock lock;
+  ConditionVariable cv;
+  std::deque<std::coroutine_handle<>> ready;
+  bool stopping = false;
+  std::vector<std::thread> threads;
+
+  void work(unsigned tid) {
+    init_thread(tid);
+    while (true) {
+      std::coroutine_handle<> handle;
+      {
+        std::unique_lock<TTASLock> guard(lock);
+        cv.wait(guard, [this] { return stopping || !ready.empty(); });
+        if (ready.empty()) {
+          return;
+        }
+        handle = ready.front();
+        ready.pop_front();
+      }
+      handle.resume();
+    }
+  }
+
+public:
+  ThreadPoolExecutor(unsigned thread_num, unsigned first_tid = 0) {
+    for (unsigned i = 0; i < thread_num; ++i) {
+      threads.emplace_back([this, tid = first_tid + i] { work(tid); });
+    }
+  }
+  ThreadPoolExecutor(const ThreadPoolExecutor &) = delete;
+  ThreadPoolExecutor &operator=(const ThreadPoolExecutor &) = delete;
+
+  /**Runs what is queued, then joins the threads. Coroutines suspended on
+   * something else are never resumed.
+   */
+  ~ThreadPoolExecutor() {
+    {
+      std::lock_guard<TTASLock> guard(lock);
+      stopping = true;
+    }
+    cv.notify_all();
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  void post(std::coroutine_handle<> handle) override {
+    {
+      std::lock_guard<TTASLock> guard(lock);
+      ready.push_back(handle);
+    }
+    cv.notify_one();
+  }
+};
+
+/**MCS lock for coroutines. Like MCSLock, the caller provides the queue node,
+ * usually a local of the coroutine, which lives in its frame across the
+ * suspension:
+ *   AsyncMutex::QNode node;
+ *   co_await mutex.lock(node, executor);
+ *   ...
+ *   mutex.unlock(node);
+ * A waiter appends its node with one exchange on the tail and links it
+ * behind its predecessor; unlock() hands the lock to the next node directly
+ * and posts its coroutine, so the lock is passed in FIFO order and nobody
+ * spins except an unlocker whose successor is between the exchange and the
+ * link.
+ */
+class AsyncMutex {
+public:
+  struct QNode {
+    Atomic<QNode *> next{nullptr};
+    std::coroutine_handle<> handle;
+    Executor *executor = nullptr;
+  };
+
+private:
+  Atomic<QNode *> tail{nullptr};
+
+  class LockAwaiter {
+    AsyncMutex &mutex;
+    QNode &node;
+    QNode *pred = nullptr;
+
+  public:
+    LockAwaiter(AsyncMutex &mutex, QNode &node, Executor &executor)
+        : mutex(mutex), node(node) {
+      node.next.store(nullptr, std::memory_order_relaxed);
+      node.executor = &executor;
+    }
+
+    bool await_ready() {
+      pred = mutex.tail.exchange(&node, std::memory_order_acq_rel);
+      return !pred;
+    }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+      node.handle = handle;
+      // from here on, the coroutine may be resumed by the unlocker
+      pred->next.store(&node, std::memory_order_release);
+    }
+
+    void await_resume() const noexcept {}
+  };
+
+public:
+  AsyncMutex() = default;
+  AsyncMutex(const AsyncMutex &) = delete;
+  AsyncMutex &operator=(const AsyncMutex &) = delete;
+
+  /**Awaitable; the coroutine is resumed on executor if it has to wait.
+   */
+  LockAwaiter lock(QNode &node, Executor &executor) {
+    return LockAwaiter(*this, node, executor);
+  }
+
+  bool try_lock(QNode &node) {
+    node.next.store(nullptr, std::memory_order_relaxed);
+    QNode *expected = nullptr;
+    return tail.compare_exchange_strong(expected, &node,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed);
+  }
+
+  void unlock(QNode &node) {
+    QNode *expected = &node;
+    if (tail.compare_exchange_strong(expected, nullptr,
+                                     std::memory_order_acq_rel,
+                                     std::memory_order_relaxed)) {
+      return;
+    }
+    QNode *next;
+    while (!(next = node.next.load(std::memory_order_acquire))) {
+      std::this_thread::yield();
+    }
+    next->executor->post(next->handle);
+  }
+};
+
+/**Unbounded MPMC queue for coroutines: push() never waits, co_await pop()
+ * suspends while the queue is empty. A push hands its value directly to the
+ * oldest suspended pop, whose awaiter is the waiting list node, and posts it
+ * to the executor it named. The items and the waiters are kept under a
+ * TTASLock held for a few instructions only.
+ */
+template <typename Ty> class AsyncQueue {
+  class PopAwaiter;
+  TTASLock lock;
+  std::deque<Ty> items;
+  PopAwaiter *head = nullptr, *tail = nullptr;
+
+  class PopAwaiter {
+    friend class AsyncQueue;
+    AsyncQueue &queue;
+    Executor &executor;
+    std::optional<Ty> value;
+    std::coroutine_handle<> handle;
+    PopAwaiter *next = nullptr;
+
+  public:
+    PopAwaiter(AsyncQueue &queue, Executor &executor)
+        : queue(queue), executor(executor) {}
+
+    bool await_ready() {
+      std::lock_guard<TTASLock> guard(queue.lock);
+      if (queue.items.empty()) {
+        return false;
+      }
+      value.emplace(std::move(queue.items.front()));
+      queue.items.pop_front();
+      return true;
+    }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      std::lock_guard<TTASLock> guard(queue.lock);
+      if (!queue.items.empty()) {
+        value.emplace(std::move(queue.items.front()));
+        queue.items.pop_front();
+        return false;
+      }
+      if (queue.tail) {
+        queue.tail->next = this;
+      } else {
+        queue.head = this;
+      }
+      queue.tail = this;
+      return true;
+    }
+
+    Ty await_resume() { return std::move(*value); }
+  };
+
+public:
+  AsyncQueue() = default;
+  AsyncQueue(const AsyncQueue &) = delete;
+  AsyncQueue &operator=(const AsyncQueue &) = delete;
+
+  void push(Ty value) {
+    PopAwaiter *waiter;
+    {
+      std::lock_guard<TTASLock> guard(lock);
+      waiter = head;
+      if (!waiter) {
+        items.push_back(std::move(value));
+        return;
+      }
+      head = waiter->next;
+      if (!head) {
+        tail = nullptr;
+      }
+      waiter->value.emplace(std::move(value));
+    }
+    waiter->executor.post(waiter->handle);
+  }
+
+  /**Awaitable returning the value; the coroutine is resumed on executor if
+   * it has to wait.
+   */
+  PopAwaiter pop(Executor &executor) { return PopAwaiter(*this, executor); }
+
+  std::optional<Ty> try_pop() {
+    std::lock_guard<TTASLock> guard(lock);
+    if (items.empty()) {
+      return {};
+    }
+    std::optional<Ty> ret(std::move(items.front()));
+    items.pop_front();
+    return ret;
+  }
+};
+
+} // namespace taomp
+
+#endif
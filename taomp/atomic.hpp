@@ -0,0 +1,299 @@
+#pragma once
+
+#include "taomp/utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+/**Atomic<T> is the atomic type used by the lock-free containers and the
+ * locks. Normally it is an alias of std::atomic<T>. When TAOMP_SCHEDULE_TEST
+ * is defined, every operation on it is first a schedule point: threads run
+ * one at a time under a schedule::Scheduler, which picks the next thread to
+ * run at each schedule point with a seeded Strategy, so every interleaving
+ * found is replayable from its seed.
+ * Operations by threads not started by a Scheduler pass straight through.
+ */
+
+namespace taomp {
+namespace schedule {
+
+class Strategy {
+public:
+  virtual ~Strategy() = default;
+  virtual void start(unsigned thread_num) = 0;
+  /**Pick the next thread among the live ones. current is the thread at the
+   * schedule point, which may have just finished.
+   */
+  virtual unsigned next(const std::vector<bool> &live, unsigned current,
+                        uint64_t step) = 0;
+};
+
+/**Uniformly random choice at every schedule point.
+ */
+class RandomWalk : public Strategy {
+  uint64_t seed;
+  std::mt19937_64 rng;
+  std::vector<unsigned> candidates;
+
+public:
+  RandomWalk(uint64_t seed) : seed(seed) {}
+
+  void start(unsigned) override { rng.seed(seed); }
+
+  unsigned next(const std::vector<bool> &live, unsigned,
+                uint64_t) override {
+    candidates.clear();
+    for (unsigned i = 0; i < live.size(); ++i) {
+      if (live[i]) {
+        candidates.push_back(i);
+      }
+    }
+    return candidates[rng() % candidates.size()];
+  }
+};
+
+/**Probabilistic concurrency testing, from:
+ * Burckhardt, Kothari, Musuvathi, Nagarakatte. A Randomized Scheduler with
+ * Probabilistic Guarantees of Finding Bugs. ASPLOS 2010.
+ * The live thread with the highest priority runs. Threads start with random
+ * priorities above depth, and at depth - 1 random steps out of
+ * expected_steps the running thread drops to a priority below all others,
+ * which finds a bug of depth d with probability at least 1 / (n * k^(d-1)).
+ * Spin loops would never yield to a lower priority thread, so a thread which
+ * runs for spin_bound consecutive steps is demoted as well.
+ */
+class PCT : public Strategy {
+  uint64_t seed;
+  uint64_t expected_steps;
+  unsigned depth;
+  unsigned spin_bound;
+  std::mt19937_64 rng;
+  std::vector<int64_t> priority;
+  std::vector<uint64_t> change_points;
+  int64_t lowest;
+  unsigned last;
+  unsigned run_length;
+
+public:
+  PCT(uint64_t seed, uint64_t expected_steps, unsigned depth = 3,
+      unsigned spin_bound = 64)
+      : seed(seed), expected_steps(expected_steps), depth(depth),
+        spin_bound(spin_bound) {}
+
+  void start(unsigned thread_num) override {
+    rng.seed(seed);
+    priority.resize(thread_num);
+    for (unsigned i = 0; i < thread_num; ++i) {
+      priority[i] = depth + i;
+    }
+    std::shuffle(priority.begin(), priority.end(), rng);
+    change_points.clear();
+    for (unsigned i = 1; i < depth; ++i) {
+      change_points.push_back(rng() % expected_steps + 1);
+    }
+    std::sort(change_points.begin(), change_points.end());
+    lowest = depth;
+    last = ~0u;
+    run_length = 0;
+  }
+
+  unsigned next(const std::vector<bool> &live, unsigned current,
+                uint64_t step) override {
+    run_length = current == last ? run_length + 1 : 0;
+    last = current;
+    bool demote = run_length >= spin_bound;
+    for (uint64_t point : change_points) {
+      demote |= point == step;
+    }
+    if (demote && live[current]) {
+      priority[current] = --lowest;
+      run_length = 0;
+    }
+    unsigned ret = ~0u;
+    for (unsigned i = 0; i < live.size(); ++i) {
+      if (live[i] && (ret == ~0u || priority[i] > priority[ret])) {
+        ret = i;
+      }
+    }
+    return ret;
+  }
+};
+
+class Scheduler;
+
+namespace internal {
+inline thread_local Scheduler *active = nullptr;
+} // namespace internal
+
+class Scheduler {
+  Strategy &strategy;
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::vector<bool> live;
+  unsigned current;
+  uint64_t step;
+
+  void waitTurn(std::unique_lock<std::mutex> &guard, unsigned tid) {
+    cv.wait(guard, [&] { return current == tid; });
+  }
+
+  void finish(unsigned tid) {
+    std::unique_lock<std::mutex> guard(mutex);
+    live[tid] = false;
+    if (std::find(live.begin(), live.end(), true) != live.end()) {
+      current = strategy.next(live, tid, ++step);
+    }
+    cv.notify_all();
+  }
+
+public:
+  Scheduler(Strategy &strategy) : strategy(strategy), current(0), step(0) {}
+
+  /**Run each function on its own thread, with thread id = its index, until
+   * all of them return. Only one of them runs at any time.
+   */
+  void run(const std::vector<std::function<void()>> &fns) {
+    unsigned thread_num = fns.size();
+    live.assign(thread_num, true);
+    step = 0;
+    strategy.start(thread_num);
+    current = strategy.next(live, 0, 0);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < thread_num; ++i) {
+      threads.emplace_back([this, &fns, i] {
+        init_thread(i);
+        {
+          std::unique_lock<std::mutex> guard(mutex);
+          waitTurn(guard, i);
+        }
+        internal::active = this;
+        fns[i]();
+        internal::active = nullptr;
+        finish(i);
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+
+  void yield() {
+    unsigned tid = get_thread_id();
+    std::unique_lock<std::mutex> guard(mutex);
+    current = strategy.next(live, tid, ++step);
+    if (current != tid) {
+      cv.notify_all();
+      waitTurn(guard, tid);
+    }
+  }
+
+  uint64_t steps() const { return step; }
+};
+
+inline void schedulePoint() {
+  if (Scheduler *s = internal::active) {
+    s->yield();
+  }
+}
+
+/**std::atomic<T> with a schedule point before every operation.
+ */
+template <typename T> class ScheduledAtomic : public std::atomic<T> {
+  using Base = std::atomic<T>;
+  using Order = std::memory_order;
+  static constexpr Order SeqCst = std::memory_order_seq_cst;
+
+public:
+  ScheduledAtomic() = default;
+  constexpr ScheduledAtomic(T v) : Base(v) {}
+  ScheduledAtomic(const ScheduledAtomic &) = delete;
+  ScheduledAtomic &operator=(const ScheduledAtomic &) = delete;
+
+  T load(Order order = SeqCst) const {
+    schedulePoint();
+    return Base::load(order);
+  }
+  operator T() const { return load(); }
+  void store(T v, Order order = SeqCst) {
+    schedulePoint();
+    Base::store(v, order);
+  }
+  T operator=(T v) {
+    store(v);
+    return v;
+  }
+  T exchange(T v, Order order = SeqCst) {
+    schedulePoint();
+    return Base::exchange(v, order);
+  }
+  bool compare_exchange_strong(T &expected, T desired, Order success,
+                               Order failure) {
+    schedulePoint();
+    return Base::compare_exchange_strong(expected, desired, success, failure);
+  }
+  bool compare_exchange_strong(T &expected, T desired, Order order = SeqCst) {
+    schedulePoint();
+    return Base::compare_exchange_strong(expected, desired, order);
+  }
+  bool compare_exchange_weak(T &expected, T desired, Order success,
+                             Order failure) {
+    schedulePoint();
+    return Base::compare_exchange_weak(expected, desired, success, failure);
+  }
+  bool compare_exchange_weak(T &expected, T desired, Order order = SeqCst) {
+    schedulePoint();
+    return Base::compare_exchange_weak(expected, desired, order);
+  }
+  template <typename D> T fetch_add(D arg, Order order = SeqCst) {
+    schedulePoint();
+    return Base::fetch_add(arg, order);
+  }
+  template <typename D> T fetch_sub(D arg, Order order = SeqCst) {
+    schedulePoint();
+    return Base::fetch_sub(arg, order);
+  }
+  template <typename D> T fetch_and(D arg, Order order = SeqCst) {
+    schedulePoint();
+    return Base::fetch_and(arg, order);
+  }
+  template <typename D> T fetch_or(D arg, Order order = SeqCst) {
+    schedulePoint();
+    return Base::fetch_or(arg, order);
+  }
+};
+
+} // namespace schedule
+
+#ifdef TAOMP_SCHEDULE_TEST
+template <typename T> using Atomic = schedule::ScheduledAtomic<T>;
+#else
+template <typename T> using Atomic = std::atomic<T>;
+#endif
+
+/**Memory ordering policies of the lock-free containers. protect orders the
+ * publication of a hazard pointer before the load re-validating it, which
+ * needs StoreLoad ordering and hence seq_cst in every policy.
+ */
+struct SeqCstOrder {
+  static constexpr std::memory_order load = std::memory_order_seq_cst;
+  static constexpr std::memory_order store = std::memory_order_seq_cst;
+  static constexpr std::memory_order cas = std::memory_order_seq_cst;
+  static constexpr std::memory_order cas_failure = std::memory_order_seq_cst;
+  static constexpr std::memory_order protect = std::memory_order_seq_cst;
+};
+
+struct AcqRelOrder {
+  static constexpr std::memory_order load = std::memory_order_acquire;
+  static constexpr std::memory_order store = std::memory_order_release;
+  static constexpr std::memory_order cas = std::memory_order_acq_rel;
+  static constexpr std::memory_order cas_failure = std::memory_order_acquire;
+  static constexpr std::memory_order protect = std::memory_order_seq_cst;
+};
+
+} // namespace taomp
@@ -0,0 +1,124 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/futex.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+
+/**Barriers for a fixed set of thread_num threads, which call await() with
+ * their get_thread_id() in [0, thread_num).
+ */
+
+namespace taomp {
+
+/**Sense-reversing barrier: the last thread to arrive resets the count and
+ * flips the global sense, the others spin, then sleep on a futex, until the
+ * sense equals their own. The futex is only woken if some thread went to
+ * sleep.
+ */
+class SenseBarrier {
+  alignas(CacheLineSize) Atomic<unsigned> count;
+  alignas(CacheLineSize) Atomic<uint32_t> sense{0};
+  Atomic<unsigned> sleepers{0};
+  unsigned thread_num;
+  unsigned spin_count;
+  ThreadLocal<uint32_t> local_sense;
+
+public:
+  SenseBarrier(unsigned thread_num, unsigned spin_count = 1 << 10)
+      : count(thread_num), thread_num(thread_num), spin_count(spin_count),
+        local_sense(thread_num) {
+    for (unsigned i = 0; i < thread_num; ++i) {
+      local_sense[i] = 0;
+    }
+  }
+  SenseBarrier(const SenseBarrier &) = delete;
+  SenseBarrier &operator=(const SenseBarrier &) = delete;
+
+  void await(unsigned tid = get_thread_id()) {
+    uint32_t my_sense = local_sense[tid] ^= 1;
+    if (count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      count.store(thread_num, std::memory_order_relaxed);
+      sense.store(my_sense, std::memory_order_seq_cst);
+      if (sleepers.load(std::memory_order_seq_cst)) {
+        futexWake(sense);
+      }
+      return;
+    }
+    for (unsigned i = 0; i < spin_count; ++i) {
+      if (sense.load(std::memory_order_acquire) == my_sense) {
+        return;
+      }
+    }
+    sleepers.fetch_add(1, std::memory_order_seq_cst);
+    while (sense.load(std::memory_order_seq_cst) != my_sense) {
+      futexWait(sense, my_sense ^ 1);
+    }
+    sleepers.fetch_sub(1, std::memory_order_relaxed);
+  }
+};
+
+/**Dissemination barrier (Hensgen, Finkel and Manber; the variant of
+ * Mellor-Crummey and Scott): in round k thread i signals thread
+ * (i + 2^k) mod thread_num and waits for the signal of thread
+ * (i - 2^k) mod thread_num, so every thread knows of every other one after
+ * ceil(log2(thread_num)) rounds. All flags of a thread live in its own cache
+ * line, and two sets of them, used alternately with a sense, make
+ * resetting unnecessary. There are no shared hot spots, but every round
+ * spins (then yields), so it suits threads which own their cores.
+ */
+class DisseminationBarrier {
+  static constexpr unsigned MaxRounds = 32;
+  struct Flags {
+    Atomic<uint32_t> flags[2][MaxRounds];
+    uint32_t parity = 0;
+    uint32_t sense = 1;
+    Flags() {
+      for (auto &set : flags) {
+        for (auto &flag : set) {
+          flag.store(0, std::memory_order_relaxed);
+        }
+      }
+    }
+  };
+  unsigned thread_num;
+  unsigned rounds;
+  unsigned spin_count;
+  ThreadLocal<Flags> flags;
+
+public:
+  DisseminationBarrier(unsigned thread_num, unsigned spin_count = 1 << 10)
+      : thread_num(thread_num), rounds(0), spin_count(spin_count),
+        flags(thread_num) {
+    while ((1u << rounds) < thread_num) {
+      ++rounds;
+    }
+  }
+  DisseminationBarrier(const DisseminationBarrier &) = delete;
+  DisseminationBarrier &operator=(const DisseminationBarrier &) = delete;
+
+  void await(unsigned tid = get_thread_id()) {
+    Flags &mine = flags[tid];
+    for (unsigned k = 0; k < rounds; ++k) {
+      unsigned partner = (tid + (1u << k)) % thread_num;
+      flags[partner].flags[mine.parity][k].store(mine.sense,
+                                                 std::memory_order_release);
+      Atomic<uint32_t> &flag = mine.flags[mine.parity][k];
+      unsigned i = 0;
+      while (flag.load(std::memory_order_acquire) != mine.sense) {
+        if (++i >= spin_count) {
+          std::this_thread::yield();
+        }
+      }
+    }
+    if (mine.parity) {
+      mine.sense ^= 1;
+    }
+    mine.parity ^= 1;
+  }
+};
+
+} // namespace taomp
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <type_traits>
+
+/**Bounded MPMC ring queue from Dmitry Vyukov:
+ * http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+ * Every cell carries a sequence number. A producer claims the cell at
+ * enqueue_pos once its sequence equals the position, and publishes the value
+ * by setting the sequence to position + 1; a consumer claims it at that
+ * sequence and hands it back to the producers with position + Capacity.
+ * One CAS per operation, no allocation and no pointers: the cells are stored
+ * inline, so a queue of trivially copyable values can be placed in memory
+ * shared between processes, see shm.hpp.
+ */
+
+namespace taomp {
+
+template <typename Ty, std::size_t Capacity> class BoundedQueue {
+  static_assert(Capacity >= 2 && !(Capacity & (Capacity - 1)),
+                "Capacity must be a power of two");
+  static constexpr std::size_t Mask = Capacity - 1;
+
+  struct Cell {
+    Atomic<std::size_t> sequence;
+    Ty value;
+  };
+
+  alignas(CacheLineSize) Atomic<std::size_t> enqueue_pos;
+  alignas(CacheLineSize) Atomic<std::size_t> dequeue_pos;
+  alignas(CacheLineSize) Cell cells[Capacity];
+
+public:
+  BoundedQueue() : enqueue_pos(0), dequeue_pos(0) {
+    for (std::size_t i = 0; i < Capacity; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+  BoundedQueue(const BoundedQueue &) = delete;
+  BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+  static constexpr std::size_t capacity() { return Capacity; }
+
+  /**Returns false if the queue is full.
+   */
+  bool enqueue(const Ty &value) {
+    std::size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &cells[pos & Mask];
+      std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(seq) - intptr_t(pos);
+      if (diff == 0) {
+        if (enqueue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    cell->value = value;
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**Returns an empty optional if the queue is empty.
+   */
+  std::optional<Ty> dequeue() {
+    std::size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+    Cell *cell;
+    while (true) {
+      cell = &cells[pos & Mask];
+      std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+      intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos.compare_exchange_weak(pos, pos + 1,
+                                              std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return {};
+      } else {
+        pos = dequeue_pos.load(std::memory_order_relaxed);
+      }
+    }
+    Ty value = cell->value;
+    cell->sequence.store(pos + Capacity, std::memory_order_release);
+    return value;
+  }
+};
+
+} // namespace taomp
@@ -0,0 +1,270 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/futex.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+/**Broadcast ring buffer after the LMAX Disruptor: every consumer sees every
+ * event, in order, without copying it into a queue of its own. Events are
+ * numbered by a 64-bit sequence and live in cell sequence % Capacity.
+ * Every consumer owns a padded cursor, the number of events it has consumed.
+ * A producer claims sequences, waits until the slowest cursor is less than
+ * Capacity behind them, writes the cells and publishes them; a consumer
+ * reads every published event from its cursor on in one batch, then advances
+ * its cursor once.
+ * SingleProducer claims with a plain counter and publishes with one store of
+ * the cursor; MultiProducer claims with a fetch_add and publishes every cell
+ * by storing its sequence into a per-cell flag, so that the consumers find
+ * the end of the published prefix when producers finish out of order.
+ * The wait policy decides how both sides wait: SpinWait busy spins,
+ * BackoffWait spins with a backoff policy from lock.hpp, FutexWait sleeps on
+ * a futex after a short spin.
+ */
+
+namespace taomp {
+
+class SpinWait {
+public:
+  template <typename Ready> void wait(Ready ready) {
+    while (!ready()) {
+      continue;
+    }
+  }
+  void notify() {}
+};
+
+template <typename Backoff = ExpBackoff> class BackoffWait {
+  Backoff backoff;
+
+public:
+  BackoffWait(const Backoff &backoff) : backoff(backoff) {}
+  BackoffWait()
+      : backoff(std::chrono::nanoseconds(100), std::chrono::microseconds(10)) {
+  }
+
+  template <typename Ready> void wait(Ready ready) {
+    Backoff local = backoff;
+    while (!ready()) {
+      local.backoff();
+    }
+  }
+  void notify() {}
+};
+
+/**The waiters announce themselves before the last check of their condition
+ * and the notifier looks for them after its store, both behind a seq_cst
+ * fence, so either the notifier sees the waiter or the waiter sees the
+ * store; a wake between the check and the sleep changes the epoch, which
+ * makes futexWait() return at once.
+ */
+class FutexWait {
+  alignas(CacheLineSize) Atomic<uint32_t> epoch{0};
+  Atomic<uint32_t> waiters{0};
+  unsigned spin_count;
+
+public:
+  FutexWait(unsigned spin_count = 256) : spin_count(spin_count) {}
+
+  template <typename Ready> void wait(Ready ready) {
+    for (unsigned i = 0; i < spin_count; ++i) {
+      if (ready()) {
+        return;
+      }
+    }
+    while (true) {
+      uint32_t e = epoch.load(std::memory_order_acquire);
+      waiters.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (ready()) {
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return;
+      }
+      futexWait(epoch, e);
+      waiters.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  void notify() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters.load(std::memory_order_relaxed)) {
+      epoch.fetch_add(1, std::memory_order_release);
+      futexWake(epoch);
+    }
+  }
+};
+
+template <std::size_t Capacity> class SingleProducer {
+  alignas(CacheLineSize) uint64_t next = 0;
+  alignas(CacheLineSize) Atomic<uint64_t> cursor{0};
+
+public:
+  uint64_t claim(std::size_t n) {
+    uint64_t seq = next;
+    next += n;
+    return seq;
+  }
+  void publish(uint64_t seq, std::size_t n) {
+    cursor.store(seq + n, std::memory_order_release);
+  }
+  /**The end of the published events from seq on.
+   */
+  uint64_t published(uint64_t seq) const {
+    (void)seq;
+    return cursor.load(std::memory_order_acquire);
+  }
+};
+
+template <std::size_t Capacity> class MultiProducer {
+  alignas(CacheLineSize) Atomic<uint64_t> claimed{0};
+  // sequence + 1 of the event last published in the cell, 0 for none
+  alignas(CacheLineSize) Atomic<uint64_t> flags[Capacity]{};
+
+public:
+  uint64_t claim(std::size_t n) {
+    return claimed.fetch_add(n, std::memory_order_relaxed);
+  }
+  void publish(uint64_t seq, std::size_t n) {
+    for (uint64_t s = seq; s < seq + n; ++s) {
+      flags[s % Capacity].store(s + 1, std::memory_order_release);
+    }
+  }
+  uint64_t published(uint64_t seq) const {
+    // a consumer is never more than Capacity behind, so a flag of seq + 1
+    // is this round's
+    uint64_t end = seq;
+    while (end < seq + Capacity &&
+           flags[end % Capacity].load(std::memory_order_acquire) == end + 1) {
+      ++end;
+    }
+    return end;
+  }
+};
+
+template <typename Ty, std::size_t Capacity,
+          template <std::size_t> class ProducerPolicy = SingleProducer,
+          typename WaitPolicy = SpinWait>
+class BroadcastRing {
+  static_assert(Capacity >= 2 && !(Capacity & (Capacity - 1)),
+                "Capacity must be a power of two");
+  static constexpr std::size_t Mask = Capacity - 1;
+
+  struct Cursor {
+    Atomic<uint64_t> consumed{0};
+  };
+
+  ProducerPolicy<Capacity> producer;
+  ThreadLocal<Cursor> cursors;
+  // the slowest cursor last seen by a producer, never ahead of it
+  alignas(CacheLineSize) Atomic<uint64_t> gate_cache{0};
+  WaitPolicy waiter;
+  alignas(CacheLineSize) Ty cells[Capacity];
+
+  uint64_t slowest() {
+    uint64_t ret = std::numeric_limits<uint64_t>::max();
+    for (unsigned c = 0; c < cursors.size(); ++c) {
+      ret = std::min(ret, cursors[c].consumed.load(std::memory_order_acquire));
+    }
+    return ret;
+  }
+
+  // claims n sequences and waits until all consumers have freed their cells
+  uint64_t claim(std::size_t n) {
+    uint64_t seq = producer.claim(n);
+    uint64_t needed = seq + n;
+    // acquire/release: with several producers the cache may come from
+    // another producer, whose acquire loads of the cursors must carry over
+    // the consumers' reads of the cells about to be overwritten
+    if (needed > gate_cache.load(std::memory_order_acquire) + Capacity) {
+      waiter.wait([&] {
+        uint64_t gate = slowest();
+        gate_cache.store(gate, std::memory_order_release);
+        return needed <= gate + Capacity;
+      });
+    }
+    return seq;
+  }
+
+public:
+  /**args are passed on to the wait policy.
+   */
+  template <typename... Args>
+  BroadcastRing(unsigned consumer_num, Args &&... args)
+      : cursors(consumer_num), waiter(std::forward<Args>(args)...) {}
+  BroadcastRing(const BroadcastRing &) = delete;
+  BroadcastRing &operator=(const BroadcastRing &) = delete;
+
+  static constexpr std::size_t capacity() { return Capacity; }
+  unsigned consumerNum() const { return cursors.size(); }
+
+  /**Returns the sequence of the event.
+   */
+  uint64_t publish(const Ty &value) {
+    uint64_t seq = claim(1);
+    cells[seq & Mask] = value;
+    producer.publish(seq, 1);
+    waiter.notify();
+    return seq;
+  }
+
+  /**Publishes n <= Capacity events at once, filled by f(sequence, Ty &).
+   */
+  template <typename F> uint64_t publishBatch(std::size_t n, F &&f) {
+    uint64_t seq = claim(n);
+    for (uint64_t s = seq; s < seq + n; ++s) {
+      f(s, cells[s & Mask]);
+    }
+    producer.publish(seq, n);
+    waiter.notify();
+    return seq;
+  }
+
+  /**Calls f(sequence, const Ty &) on up to max_batch published events from
+   * the cursor of consumer on, without waiting. Returns how many.
+   */
+  template <typename F>
+  std::size_t tryConsume(unsigned consumer, F &&f,
+                         std::size_t max_batch = Capacity) {
+    Atomic<uint64_t> &cursor = cursors[consumer].consumed;
+    uint64_t seq = cursor.load(std::memory_order_relaxed);
+    uint64_t end = std::min<uint64_t>(producer.published(seq), seq + max_batch);
+    for (uint64_t s = seq; s < end; ++s) {
+      f(s, static_cast<const Ty &>(cells[s & Mask]));
+    }
+    if (end != seq) {
+      // release: the reads above happen before a producer reuses the cells
+      cursor.store(end, std::memory_order_release);
+      waiter.notify();
+    }
+    return end - seq;
+  }
+
+  /**Like tryConsume(), but waits for at least one event.
+   */
+  template <typename F>
+  std::size_t consume(unsigned consumer, F &&f,
+                      std::size_t max_batch = Capacity) {
+    uint64_t seq = cursors[consumer].consumed.load(std::memory_order_relaxed);
+    waiter.wait([&] { return producer.published(seq) != seq; });
+    return tryConsume(consumer, f, max_batch);
+  }
+
+  /**Events consumer has consumed so far.
+   */
+  uint64_t position(unsigned consumer) {
+    return cursors[consumer].consumed.load(std::memory_order_acquire);
+  }
+};
+
+template <typename Ty, std::size_t Capacity, typename WaitPolicy = SpinWait>
+using MultiProducerBroadcastRing =
+    BroadcastRing<Ty, Capacity, MultiProducer, WaitPolicy>;
+
+} // namespace taomp
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <utility>
+
+/**Append-only vector for many concurrent writers and readers. Elements live
+ * in the geometrically growing segments of internal::SegmentIndex, so they
+ * are never moved or copied once constructed, and the segment of an index is
+ * found with one clz.
+ * push_back claims its index with one fetch_add and constructs the element in
+ * place; the thread first touching a segment claims it with a CAS and
+ * allocates it zeroed, which leaves the pages to the OS instead of clearing
+ * the whole segment on that push, while other pushes into the segment wait
+ * for it to be published. Every slot has a ready flag, all-zero while empty,
+ * set with release after the element is constructed: an index below size()
+ * may still be under construction, readers check ready() or use tryGet().
+ * Elements are not destroyed before the vector, hence references stay valid
+ * and iterating with forEach() is safe while other threads push.
+ */
+
+namespace taomp {
+
+template <typename T, unsigned FirstSegmentBits = 5> class ConcurrentVector {
+  using Index = internal::SegmentIndex<FirstSegmentBits>;
+
+  // slots are used in zeroed memory without constructing ready
+  struct Slot {
+    Atomic<bool> ready;
+    alignas(T) unsigned char storage[sizeof(T)];
+
+    T *get() { return reinterpret_cast<T *>(storage); }
+  };
+
+  Atomic<Slot *> segments[Index::MaxSegments]{};
+  Atomic<unsigned> count{0};
+
+  // segments[seg] while its first thread allocates it
+  static Slot *busy() { return reinterpret_cast<Slot *>(alignof(Slot)); }
+
+  /**Zeroed memory, i.e. slots with ready == false. calloc takes large blocks
+   * straight from mmap, whose pages the OS zeroes on first touch, so nothing
+   * is written here.
+   */
+  static Slot *allocateZeroed(std::size_t n) {
+    if constexpr (alignof(Slot) <= alignof(std::max_align_t)) {
+      void *p = calloc(n, sizeof(Slot));
+      assert(p);
+      return static_cast<Slot *>(p);
+    } else {
+      Slot *p = taomp::aligned_alloc<Slot, alignof(Slot)>(n);
+      memset(static_cast<void *>(p), 0, n * sizeof(Slot));
+      return p;
+    }
+  }
+
+  Slot *segment(unsigned seg) {
+    Slot *s = segments[seg].load(std::memory_order_acquire);
+    if (s && s != busy()) {
+      return s;
+    }
+    if (!s && segments[seg].compare_exchange_strong(
+                  s, busy(), std::memory_order_relaxed,
+                  std::memory_order_acquire)) {
+      Slot *fresh = allocateZeroed(Index::segmentSize(seg));
+      segments[seg].store(fresh, std::memory_order_release);
+      return fresh;
+    }
+    while ((s = segments[seg].load(std::memory_order_acquire)) == busy()) {
+      std::this_thread::yield();
+    }
+    return s;
+  }
+
+  Slot &slot(unsigned i) {
+    unsigned seg = Index::segment(i);
+    return segment(seg)[Index::offset(i, seg)];
+  }
+
+  /**nullptr if the segment of i is not allocated yet.
+   */
+  Slot *findSlot(unsigned i) const {
+    unsigned seg = Index::segment(i);
+    Slot *s = segments[seg].load(std::memory_order_acquire);
+    return s && s != busy() ? s + Index::offset(i, seg) : nullptr;
+  }
+
+public:
+  ConcurrentVector() = default;
+  ConcurrentVector(const ConcurrentVector &) = delete;
+  ConcurrentVector &operator=(const ConcurrentVector &) = delete;
+
+  ~ConcurrentVector() {
+    for (unsigned seg = 0; seg < Index::MaxSegments; ++seg) {
+      Slot *s = segments[seg].load(std::memory_order_relaxed);
+      if (!s) {
+        continue;
+      }
+      for (std::size_t i = 0; i < Index::segmentSize(seg); ++i) {
+        if (s[i].ready.load(std::memory_order_relaxed)) {
+          s[i].get()->~T();
+        }
+      }
+      free(s);
+    }
+  }
+
+  /**Returns the index of the new element.
+   */
+  template <typename... Args> unsigned emplace_back(Args &&... args) {
+    unsigned i = count.fetch_add(1, std::memory_order_relaxed);
+    assert(i != ~0u && "ConcurrentVector is full");
+    Slot &s = slot(i);
+    new (s.storage) T(std::forward<Args>(args)...);
+    s.ready.store(true, std::memory_order_release);
+    return i;
+  }
+  unsigned push_back(const T &value) { return emplace_back(value); }
+  unsigned push_back(T &&value) { return emplace_back(std::move(value)); }
+
+  /**The number of indices claimed so far, including elements still under
+   * construction.
+   */
+  std::size_t size() const { return count.load(std::memory_order_acquire); }
+
+  bool ready(unsigned i) const {
+    Slot *s = findSlot(i);
+    return s && s->ready.load(std::memory_order_acquire);
+  }
+
+  /**nullptr unless the element at i is constructed.
+   */
+  const T *tryGet(unsigned i) const {
+    Slot *s = findSlot(i);
+    return s && s->ready.load(std::memory_order_acquire) ? s->get() : nullptr;
+  }
+
+  /**i must be ready(), e.g. returned by a push_back which happened-before.
+   */
+  const T &operator[](unsigned i) const {
+    const T *p = tryGet(i);
+    assert(p);
+    return *p;
+  }
+
+  /**Calls f(index, element) for every constructed element below the size()
+   * at the start, in index order, skipping those still under construction.
+   */
+  template <typename F> void forEach(F &&f) const {
+    std::size_t n = size();
+    for (unsigned seg = 0; seg < Index::MaxSegments; ++seg) {
+      std::size_t first = Index::segmentSize(seg) - Index::segmentSize(0);
+      if (first >= n) {
+        break;
+      }
+      Slot *s = segments[seg].load(std::memory_order_acquire);
+      if (!s || s == busy()) {
+        continue;
+      }
+      std::size_t last = first + Index::segmentSize(seg);
+      for (std::size_t i = first; i < last && i < n; ++i) {
+        Slot &cell = s[i - first];
+        if (cell.ready.load(std::memory_order_acquire)) {
+          f(unsigned(i), static_cast<const T &>(*cell.get()));
+        }
+      }
+    }
+  }
+};
+
+} // namespace taomp
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/futex.hpp"
+#include "taomp/lock.hpp"
+#include <atomic>
+#include <cstdint>
+
+/**Condition variable for any BasicLockable, e.g. TASLock, TTASLock or a
+ * std::unique_lock of one. Waiters queue in FIFO order, each sleeping on
+ * the futex word of its own node on its stack.
+ * notify_all() does wait morphing: instead of waking every waiter to stampede
+ * on the lock, it detaches the queue and wakes only its head. A waiter woken
+ * this way passes the wake up on to the next one once it has reacquired the
+ * lock, so the woken threads enter the lock one after the other and at most
+ * one of them contends for it at a time. The kernel can do this for futex
+ * based mutexes with FUTEX_CMP_REQUEUE; for a user space lock the chain of
+ * waiters is the requeue.
+ */
+
+namespace taomp {
+
+class ConditionVariable {
+  enum : uint32_t { Waiting, Notified, Broadcast };
+  struct Node {
+    Atomic<uint32_t> state{Waiting};
+    Node *next = nullptr;
+  };
+  TTASLock queue_lock;
+  Node *head = nullptr;
+  Node *tail = nullptr;
+  unsigned spin_count;
+
+  static void wake(Node *node, uint32_t state) {
+    node->state.store(state, std::memory_order_release);
+    // the node may be gone already, a stray wake up is harmless
+    futexWake(node->state, 1);
+  }
+
+public:
+  ConditionVariable(unsigned spin_count = 1 << 8) : spin_count(spin_count) {}
+  ConditionVariable(const ConditionVariable &) = delete;
+  ConditionVariable &operator=(const ConditionVariable &) = delete;
+
+  template <typename Lock> void wait(Lock &lock) {
+    Node node;
+    queue_lock.lock();
+    if (tail) {
+      tail->next = &node;
+    } else {
+      head = &node;
+    }
+    tail = &node;
+    queue_lock.unlock();
+    lock.unlock();
+    uint32_t state = spinThenWait(node.state, Waiting, spin_count);
+    lock.lock();
+    if (state == Broadcast && node.next) {
+      wake(node.next, Broadcast);
+    }
+  }
+
+  template <typename Lock, typename Predicate>
+  void wait(Lock &lock, Predicate pred) {
+    while (!pred()) {
+      wait(lock);
+    }
+  }
+
+  void notify_one() {
+    queue_lock.lock();
+    Node *node = head;
+    if (node) {
+      head = node->next;
+      if (!head) {
+        tail = nullptr;
+      }
+    }
+    queue_lock.unlock();
+    if (node) {
+      wake(node, Notified);
+    }
+  }
+
+  void notify_all() {
+    queue_lock.lock();
+    Node *node = head;
+    head = tail = nullptr;
+    queue_lock.unlock();
+    if (node) {
+      wake(node, Broadcast);
+    }
+  }
+};
+
+} // namespace taomp
@@ -0,0 +1,216 @@
+#pragma once
+
+#include "taomp/utils.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+/**Statistics accumulators sharded over ThreadLocal. Each thread only writes
+ * its own padded shard with relaxed load/store pairs (no RMW, no shared cache
+ * line), and readers aggregate over all shards. A read is therefore not a
+ * snapshot: it sees every update which happened-before it, and any subset of
+ * the concurrent ones.
+ */
+
+namespace taomp {
+
+template <typename T = uint64_t> class ShardedCounter {
+  ThreadLocal<std::atomic<T>> shards;
+
+public:
+  ShardedCounter(unsigned thread_num) : shards(thread_num) {
+    for (unsigned i = 0; i < thread_num; ++i) {
+      shards[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void add(T v = 1, unsigned tid = get_thread_id()) {
+    std::atomic<T> &shard = shards[tid];
+    shard.store(shard.load(std::memory_order_relaxed) + v,
+                std::memory_order_relaxed);
+  }
+
+  T read() {
+    T sum = 0;
+    for (unsigned i = 0; i < shards.size(); ++i) {
+      sum += shards[i].load(std::memory_order_relaxed);
+    }
+    return sum;
+  }
+};
+
+/**Keeps the extremum according to Compare, e.g. std::less for a minimum.
+ */
+template <typename T, typename Compare> class ShardedExtremum {
+  ThreadLocal<std::atomic<T>> shards;
+  T identity;
+
+public:
+  ShardedExtremum(unsigned thread_num, T identity)
+      : shards(thread_num), identity(identity) {
+    for (unsigned i = 0; i < thread_num; ++i) {
+      shards[i].store(identity, std::memory_order_relaxed);
+    }
+  }
+
+  void update(T v, unsigned tid = get_thread_id()) {
+    std::atomic<T> &shard = shards[tid];
+    if (Compare()(v, shard.load(std::memory_order_relaxed))) {
+      shard.store(v, std::memory_order_relaxed);
+    }
+  }
+
+  T read() {
+    T ret = identity;
+    for (unsigned i = 0; i < shards.size(); ++i) {
+      T v = shards[i].load(std::memory_order_relaxed);
+      if (Compare()(v, ret)) {
+        ret = v;
+      }
+    }
+    return ret;
+  }
+};
+
+template <typename T = uint64_t>
+class ShardedMin : public ShardedExtremum<T, std::less<T>> {
+public:
+  ShardedMin(unsigned thread_num)
+      : ShardedExtremum<T, std::less<T>>(thread_num,
+                                         std::numeric_limits<T>::max()) {}
+};
+
+template <typename T = uint64_t>
+class ShardedMax : public ShardedExtremum<T, std::greater<T>> {
+public:
+  ShardedMax(unsigned thread_num)
+      : ShardedExtremum<T, std::greater<T>>(thread_num,
+                                            std::numeric_limits<T>::lowest()) {
+  }
+};
+
+/**Histogram with power-of-two buckets: bucket 0 counts the value 0, bucket i
+ * counts [2^(i-1), 2^i), the last bucket also takes everything above.
+ */
+template <unsigned BucketNum = 65> class ShardedHistogram {
+public:
+  using Snapshot = std::array<uint64_t, BucketNum>;
+
+private:
+  ThreadLocal<std::array<std::atomic<uint64_t>, BucketNum>> shards;
+
+public:
+  ShardedHistogram(unsigned thread_num) : shards(thread_num) {
+    for (unsigned i = 0; i < thread_num; ++i) {
+      for (auto &b : shards[i]) {
+        b.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  static unsigned bucket(uint64_t v) {
+    unsigned b = v ? 64 - __builtin_clzll(v) : 0;
+    return b < BucketNum ? b : BucketNum - 1;
+  }
+
+  void record(uint64_t v, unsigned tid = get_thread_id()) {
+    std::atomic<uint64_t> &b = shards[tid][bucket(v)];
+    b.store(b.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  Snapshot read() {
+    Snapshot ret{};
+    for (unsigned i = 0; i < shards.size(); ++i) {
+      for (unsigned b = 0; b < BucketNum; ++b) {
+        ret[b] += shards[i][b].load(std::memory_order_relaxed);
+      }
+    }
+    return ret;
+  }
+};
+
+/**Two-level scalable non-zero indicator:
+ * Ellen, Lev, Luchangco, Moir. SNZI: Scalable NonZero Indicators. PODC 2007.
+ * Threads arrive/depart at a leaf chosen by thread id; a leaf only touches
+ * the root when its surplus goes from 0 to non-zero and back, using the
+ * paper's intermediate 1/2 state so that query() never misses a completed
+ * arrive. query() is a single load of the root.
+ */
+class SNZI {
+  // leaf word: high 32 bits version, low 32 bits twice the surplus (1 == 1/2)
+  ThreadLocal<std::atomic<uint64_t>> leaves;
+  alignas(CacheLineSize) std::atomic<int64_t> root;
+
+  static uint64_t pack(uint32_t version, uint32_t count2) {
+    return uint64_t(version) << 32 | count2;
+  }
+  static uint32_t version(uint64_t x) { return uint32_t(x >> 32); }
+  static uint32_t count2(uint64_t x) { return uint32_t(x); }
+
+  std::atomic<uint64_t> &leaf(unsigned tid) {
+    return leaves[tid % leaves.size()];
+  }
+
+  void rootArrive() { root.fetch_add(1, std::memory_order_acq_rel); }
+  void rootDepart() { root.fetch_sub(1, std::memory_order_acq_rel); }
+
+public:
+  SNZI(unsigned leaf_num) : leaves(leaf_num), root(0) {
+    for (unsigned i = 0; i < leaf_num; ++i) {
+      leaves[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void arrive(unsigned tid = get_thread_id()) {
+    std::atomic<uint64_t> &x = leaf(tid);
+    bool succ = false;
+    unsigned undo = 0;
+    while (!succ) {
+      uint64_t v = x.load(std::memory_order_acquire);
+      if (count2(v) >= 2) {
+        if (x.compare_exchange_strong(v, pack(version(v), count2(v) + 2),
+                                      std::memory_order_acq_rel)) {
+          succ = true;
+        }
+      }
+      if (count2(v) == 0) {
+        uint64_t half = pack(version(v) + 1, 1);
+        if (x.compare_exchange_strong(v, half, std::memory_order_acq_rel)) {
+          succ = true;
+          v = half;
+        }
+      }
+      if (count2(v) == 1) {
+        rootArrive();
+        if (!x.compare_exchange_strong(v, pack(version(v), 2),
+                                       std::memory_order_acq_rel)) {
+          ++undo;
+        }
+      }
+    }
+    for (; undo; --undo) {
+      rootDepart();
+    }
+  }
+
+  void depart(unsigned tid = get_thread_id()) {
+    std::atomic<uint64_t> &x = leaf(tid);
+    uint64_t v = x.load(std::memory_order_acquire);
+    while (true) {
+      assert(count2(v) >= 2);
+      if (x.compare_exchange_weak(v, pack(version(v), count2(v) - 2),
+                                  std::memory_order_acq_rel)) {
+        if (count2(v) == 2) {
+          rootDepart();
+        }
+        return;
+      }
+    }
+  }
+
+  bool query() { return root.load(std::memory_order_acquire) > 0; }
+};
+
+} // namespace taomp
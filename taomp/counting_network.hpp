@@ -0,0 +1,341 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/**Counting networks and diffracting trees, after Aspnes, Herlihy, Shavit.
+ * Counting Networks. JACM 1994 and Shavit, Zemach. Diffracting Trees.
+ * TOCS 1996.
+ * A balancer is a toggle sending its tokens alternately to its first and its
+ * second output. A Balancer<N> is a network of them with N outputs having the
+ * step property: once all tokens have left, output i has seen
+ * ceil((n - i) / N) of n tokens, whichever inputs they entered on. Tokens
+ * entering on different inputs mostly toggle different balancers, so there
+ * is no single hot cache line.
+ * NetworkCounter turns a Balancer<N> into a Counter by giving output i the
+ * values i, i + N, i + 2N, ...; in a quiescent state the values handed out
+ * are exactly 0 .. n-1, but a token may overtake a slower one, so they are
+ * not linearizable.
+ * The toggles retry their CAS with a backoff policy from lock.hpp, which is
+ * copied for every traversal so that ExpBackoff keeps its state per thread.
+ */
+
+namespace taomp {
+
+class Counter {
+public:
+  virtual ~Counter() = default;
+  virtual uint64_t getAndIncrement(unsigned tid) = 0;
+  uint64_t getAndIncrement() { return getAndIncrement(get_thread_id()); }
+};
+
+template <unsigned N> class Balancer {
+  static_assert(N && !(N & (N - 1)), "the width must be a power of two");
+
+public:
+  static constexpr unsigned Width = N;
+  virtual ~Balancer() = default;
+  /**Routes one token of thread tid, returns its output in [0, N).
+   */
+  virtual unsigned traverse(unsigned tid) = 0;
+  unsigned traverse() { return traverse(get_thread_id()); }
+};
+
+namespace internal {
+class Toggle {
+  alignas(CacheLineSize) Atomic<bool> state{false};
+
+public:
+  template <typename Backoff> unsigned traverse(const Backoff &backoff) {
+    bool v = state.load(std::memory_order_relaxed);
+    while (!state.compare_exchange_weak(v, !v, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+      backoff.backoff();
+    }
+    return v;
+  }
+};
+
+/**One exchanger slot of a prism: a token finding another one waiting takes
+ * output 1 and sends the waiting one to output 0, so the pair leaves the
+ * toggle below unchanged.
+ */
+class PrismSlot {
+  enum : unsigned { Empty, Waiting, Paired };
+  alignas(CacheLineSize) Atomic<unsigned> state{Empty};
+
+public:
+  /**The output, or -1 if no partner came within spin loads.
+   */
+  int visit(unsigned spin) {
+    unsigned s = state.load(std::memory_order_acquire);
+    if (s == Waiting &&
+        state.compare_exchange_strong(s, Paired, std::memory_order_acq_rel)) {
+      return 1;
+    }
+    if (s != Empty ||
+        !state.compare_exchange_strong(s, Waiting, std::memory_order_acq_rel)) {
+      return -1;
+    }
+    for (unsigned i = 0; i < spin; ++i) {
+      if (state.load(std::memory_order_acquire) == Paired) {
+        state.store(Empty, std::memory_order_release);
+        return 0;
+      }
+    }
+    s = Waiting;
+    if (state.compare_exchange_strong(s, Empty, std::memory_order_acq_rel)) {
+      return -1;
+    }
+    // paired after the last load
+    state.store(Empty, std::memory_order_release);
+    return 0;
+  }
+};
+} // namespace internal
+
+/**A network of toggles laid out by a subclass. A token enters on input
+ * tid % N; every toggle knows the two places (another toggle or an output)
+ * its outputs lead to.
+ */
+template <unsigned N, typename Backoff = NoBackoff>
+class CountingNetwork : public Balancer<N> {
+protected:
+  // a toggle index, or an output with OutputBit set
+  static constexpr uint32_t OutputBit = 1u << 31;
+  using Target = uint32_t;
+  using Targets = std::vector<Target>;
+
+private:
+  std::vector<std::pair<Target, Target>> edges;
+  std::unique_ptr<internal::Toggle[]> toggles;
+  Targets inputs;
+  Backoff backoff;
+
+protected:
+  CountingNetwork(const Backoff &backoff) : backoff(backoff) {}
+
+  static Targets outputs() {
+    Targets ret;
+    for (unsigned i = 0; i < N; ++i) {
+      ret.push_back(i | OutputBit);
+    }
+    return ret;
+  }
+
+  Target addToggle(Target first, Target second) {
+    edges.emplace_back(first, second);
+    return edges.size() - 1;
+  }
+
+  /**Called by the subclass once the layout is complete.
+   */
+  void finish(Targets ins) {
+    inputs = std::move(ins);
+    toggles.reset(new internal::Toggle[edges.size()]);
+  }
+
+public:
+  unsigned traverse(unsigned tid) final {
+    Backoff local = backoff;
+    Target t = inputs[tid % N];
+    while (!(t & OutputBit)) {
+      const std::pair<Target, Target> &e = edges[t];
+      t = toggles[t].traverse(local) ? e.second : e.first;
+    }
+    return t & ~OutputBit;
+  }
+  using Balancer<N>::traverse;
+
+  unsigned toggleNum() const { return edges.size(); }
+};
+
+/**Bitonic[N]: two Bitonic[N/2] followed by a Merger[N], log N (log N + 1) / 2
+ * layers of N/2 toggles.
+ */
+template <unsigned N, typename Backoff = NoBackoff>
+class BitonicNetwork : public CountingNetwork<N, Backoff> {
+  using Base = CountingNetwork<N, Backoff>;
+  using typename Base::Targets;
+
+  Targets merger(unsigned width, const Targets &outs) {
+    unsigned half = width / 2;
+    Targets layer;
+    for (unsigned i = 0; i < half; ++i) {
+      layer.push_back(this->addToggle(outs[2 * i], outs[2 * i + 1]));
+    }
+    if (width == 2) {
+      return {layer[0], layer[0]};
+    }
+    Targets sub[2] = {merger(half, layer), merger(half, layer)};
+    // the even inputs of the first half and the odd ones of the second half
+    // go to the first sub merger
+    Targets ins(width);
+    for (unsigned i = 0; i < width; ++i) {
+      ins[i] = sub[(i < half ? i : i + 1) % 2][i / 2];
+    }
+    return ins;
+  }
+
+  Targets bitonic(unsigned width, const Targets &outs) {
+    Targets ins = merger(width, outs);
+    if (width == 2) {
+      return ins;
+    }
+    unsigned half = width / 2;
+    Targets first = bitonic(half, Targets(ins.begin(), ins.begin() + half));
+    Targets second = bitonic(half, Targets(ins.begin() + half, ins.end()));
+    first.insert(first.end(), second.begin(), second.end());
+    return first;
+  }
+
+public:
+  BitonicNetwork(const Backoff &backoff = Backoff()) : Base(backoff) {
+    static_assert(N >= 2, "a network needs two outputs");
+    this->finish(bitonic(N, Base::outputs()));
+  }
+};
+
+/**Periodic[N]: log N Block[N] in a row. The first layer of a Block joins
+ * wires i and N-1-i, then a Block[N/2] takes the upper and one the lower
+ * half of the wires.
+ */
+template <unsigned N, typename Backoff = NoBackoff>
+class PeriodicNetwork : public CountingNetwork<N, Backoff> {
+  using Base = CountingNetwork<N, Backoff>;
+  using typename Base::Targets;
+
+  Targets block(unsigned width, const Targets &outs) {
+    unsigned half = width / 2;
+    Targets wires = outs;
+    if (width > 2) {
+      Targets north = block(half, Targets(outs.begin(), outs.begin() + half));
+      Targets south = block(half, Targets(outs.begin() + half, outs.end()));
+      std::copy(north.begin(), north.end(), wires.begin());
+      std::copy(south.begin(), south.end(), wires.begin() + half);
+    }
+    Targets ins(width);
+    for (unsigned i = 0; i < half; ++i) {
+      ins[i] = ins[width - 1 - i] =
+          this->addToggle(wires[i], wires[width - 1 - i]);
+    }
+    return ins;
+  }
+
+public:
+  PeriodicNetwork(const Backoff &backoff = Backoff()) : Base(backoff) {
+    static_assert(N >= 2, "a network needs two outputs");
+    Targets ins = Base::outputs();
+    for (unsigned w = N; w > 1; w /= 2) {
+      ins = block(N, ins);
+    }
+    this->finish(ins);
+  }
+};
+
+/**A binary tree of N - 1 toggles, node k having children 2k and 2k + 1; the
+ * toggle at depth d decides bit d of the output. In front of every toggle a
+ * prism of exchanger slots pairs up tokens arriving together, which then
+ * leave on different sides without touching the toggle. The root prism has
+ * prism_width slots, each level below half as many (at least one), since it
+ * sees half the traffic.
+ */
+template <unsigned N, typename Backoff = NoBackoff>
+class DiffractingTree : public Balancer<N> {
+  struct Node {
+    internal::Toggle toggle;
+    unsigned prism_begin = 0, prism_size = 1;
+  };
+  struct Rng {
+    uint64_t state;
+  };
+
+  std::unique_ptr<Node[]> nodes;
+  std::unique_ptr<internal::PrismSlot[]> prisms;
+  ThreadLocal<Rng> rngs;
+  unsigned spin;
+  Backoff backoff;
+
+  // xorshift64
+  uint64_t next(unsigned tid) {
+    uint64_t x = rngs[tid].state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    rngs[tid].state = x;
+    return x;
+  }
+
+public:
+  DiffractingTree(unsigned thread_num, unsigned prism_width = 8,
+                  unsigned spin = 64, const Backoff &backoff = Backoff())
+      : nodes(new Node[N]), rngs(thread_num), spin(spin), backoff(backoff) {
+    unsigned prism_num = 0;
+    for (unsigned k = 1, width = prism_width; k < N; k *= 2, width /= 2) {
+      for (unsigned i = k; i < 2 * k; ++i) {
+        nodes[i].prism_begin = prism_num;
+        nodes[i].prism_size = width ? width : 1;
+        prism_num += nodes[i].prism_size;
+      }
+    }
+    prisms.reset(new internal::PrismSlot[prism_num ? prism_num : 1]);
+    for (unsigned tid = 0; tid < thread_num; ++tid) {
+      rngs[tid].state = (uint64_t(tid + 1) * 0x9e3779b97f4a7c15ull) | 1;
+    }
+  }
+
+  unsigned traverse(unsigned tid) final {
+    Backoff local = backoff;
+    unsigned wire = 0;
+    for (unsigned k = 1, bit = 0; k < N; ++bit) {
+      Node &node = nodes[k];
+      int side = spin ? prisms[node.prism_begin + next(tid) % node.prism_size]
+                            .visit(spin)
+                      : -1;
+      if (side < 0) {
+        side = node.toggle.traverse(local);
+      }
+      wire |= unsigned(side) << bit;
+      k = 2 * k + side;
+    }
+    return wire;
+  }
+  using Balancer<N>::traverse;
+};
+
+/**Output i of the balancer hands out i, i + N, i + 2N, ...
+ */
+template <typename Net> class NetworkCounter : public Counter {
+  static constexpr unsigned N = Net::Width;
+  struct Output {
+    alignas(CacheLineSize) Atomic<uint64_t> next;
+  };
+
+  Net net;
+  Output outputs[N];
+
+public:
+  template <typename... Args>
+  NetworkCounter(Args &&... args) : net(std::forward<Args>(args)...) {
+    for (unsigned i = 0; i < N; ++i) {
+      outputs[i].next.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  uint64_t getAndIncrement(unsigned tid) override {
+    return outputs[net.traverse(tid)].next.fetch_add(
+        N, std::memory_order_relaxed);
+  }
+  using Counter::getAndIncrement;
+
+  Net &network() { return net; }
+};
+
+} // namespace taomp
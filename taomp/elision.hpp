@@ -0,0 +1,144 @@
+#pragma once
+
+#include "taomp/stats.hpp"
+#include "taomp/utils.hpp"
+#include <cstdint>
+#if defined(__x86_64__) || defined(__amd64__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define TAOMP_HAVE_RTM_INTRINSICS
+#endif
+
+/**Lock elision with Intel RTM. ElidedLock<Lock> runs the critical section as
+ * a hardware transaction which only reads the lock word, so critical
+ * sections which do not conflict on data run in parallel. The lock word is
+ * in the read set: a thread which really acquires the lock aborts every
+ * transaction in flight, and a transaction which finds the lock held aborts
+ * itself, waits until it is free and retries.
+ * After MaxAttempts aborts, or at once on an abort the hardware reports as
+ * not worth retrying (e.g. capacity), the lock is really acquired.
+ * RTM support is detected once with CPUID; without it (other CPUs, or RTM
+ * disabled by microcode) ElidedLock is a pass-through to Lock.
+ * The functions using RTM instructions are compiled for the rtm target
+ * only, so no -mrtm is needed.
+ */
+
+namespace taomp {
+
+inline bool rtmSupported() {
+#ifdef TAOMP_HAVE_RTM_INTRINSICS
+  static const bool supported = [] {
+    // CPUID.(EAX=07H, ECX=0):EBX[11]
+    unsigned eax, ebx, ecx, edx;
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+      return false;
+    }
+    return bool(ebx & (1u << 11));
+  }();
+  return supported;
+#else
+  return false;
+#endif
+}
+
+namespace internal {
+inline constexpr unsigned XAbortLockBusy = 0xff;
+#ifdef TAOMP_HAVE_RTM_INTRINSICS
+__attribute__((target("rtm"))) inline unsigned xbegin() { return _xbegin(); }
+__attribute__((target("rtm"))) inline void xend() { _xend(); }
+__attribute__((target("rtm"))) inline void xabortLockBusy() {
+  _xabort(XAbortLockBusy);
+}
+__attribute__((target("rtm"))) inline bool xtest() { return _xtest(); }
+#endif
+} // namespace internal
+
+/**Lock must be BasicLockable and provide isLocked(), e.g. TASLock or
+ * TTASLock. The statistics count commits, aborts by reason and fallbacks to
+ * the real lock.
+ */
+template <typename Lock, bool CollectStats = false, unsigned MaxAttempts = 3>
+class ElidedLock : public Stats<CollectStats> {
+  Lock lock_;
+  bool rtm;
+
+#ifdef TAOMP_HAVE_RTM_INTRINSICS
+  bool tryElide() {
+    for (unsigned attempt = 0; attempt < MaxAttempts; ++attempt) {
+      unsigned status = internal::xbegin();
+      if (status == _XBEGIN_STARTED) {
+        if (!lock_.isLocked()) {
+          return true;
+        }
+        internal::xabortLockBusy();
+      }
+      if ((status & _XABORT_EXPLICIT) &&
+          _XABORT_CODE(status) == internal::XAbortLockBusy) {
+        this->count(StatKind::ElisionLockBusy);
+        // retrying right away would abort again
+        while (lock_.isLocked()) {
+          continue;
+        }
+        continue;
+      }
+      if (status & _XABORT_CONFLICT) {
+        this->count(StatKind::ElisionConflict);
+      } else if (status & _XABORT_CAPACITY) {
+        this->count(StatKind::ElisionCapacity);
+      } else {
+        this->count(StatKind::ElisionOtherAbort);
+      }
+      if (!(status & _XABORT_RETRY)) {
+        break;
+      }
+    }
+    this->count(StatKind::ElisionFallback);
+    return false;
+  }
+#endif
+
+public:
+  ElidedLock(unsigned thread_num = 1)
+      : Stats<CollectStats>(thread_num), rtm(rtmSupported()) {}
+  ElidedLock(const ElidedLock &) = delete;
+  ElidedLock &operator=(const ElidedLock &) = delete;
+
+  static bool elisionSupported() { return rtmSupported(); }
+
+  template <class T> void lock(const T &backoffer) {
+#ifdef TAOMP_HAVE_RTM_INTRINSICS
+    if (rtm && tryElide()) {
+      return;
+    }
+#endif
+    lock_.lock(backoffer);
+  }
+
+  void lock() {
+#ifdef TAOMP_HAVE_RTM_INTRINSICS
+    if (rtm && tryElide()) {
+      return;
+    }
+#endif
+    lock_.lock();
+  }
+
+  /**Always really acquires the lock.
+   */
+  bool try_lock() { return lock_.try_lock(); }
+
+  void unlock() {
+#ifdef TAOMP_HAVE_RTM_INTRINSICS
+    if (rtm && internal::xtest()) {
+      internal::xend();
+      this->count(StatKind::ElisionCommit);
+      return;
+    }
+#endif
+    lock_.unlock();
+  }
+
+  bool isLocked() const { return lock_.isLocked(); }
+};
+
+} // namespace taomp
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+/**Thin wrappers of the futex syscall on a 32-bit Atomic. Process private
+ * futexes are used, so these must not be applied to words in memory shared
+ * between processes.
+ */
+
+namespace taomp {
+
+/**Sleep while word == expected. Returns on a wake up, a signal, a spurious
+ * wake up or immediately if the word differs: callers re-check in a loop.
+ */
+inline void futexWait(Atomic<uint32_t> &word, uint32_t expected) {
+  static_assert(sizeof(Atomic<uint32_t>) == sizeof(uint32_t));
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word),
+          FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+
+/**Wake at most count waiters, returns the number woken.
+ */
+inline int futexWake(Atomic<uint32_t> &word, int count = INT_MAX) {
+  return syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word),
+                 FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+
+/**Spin up to spin_count rounds, then yield as many, then sleep on the futex
+ * until word != expected. Returns the new value.
+ */
+inline uint32_t spinThenWait(Atomic<uint32_t> &word, uint32_t expected,
+                             unsigned spin_count) {
+  uint32_t v;
+  for (unsigned i = 0; i < spin_count; ++i) {
+    if ((v = word.load(std::memory_order_acquire)) != expected) {
+      return v;
+    }
+  }
+  for (unsigned i = 0; i < spin_count; ++i) {
+    if ((v = word.load(std::memory_order_acquire)) != expected) {
+      return v;
+    }
+    std::this_thread::yield();
+  }
+  while ((v = word.load(std::memory_order_acquire)) == expected) {
+    futexWait(word, expected);
+  }
+  return v;
+}
+
+} // namespace taomp
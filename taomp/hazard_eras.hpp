@@ -0,0 +1,191 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/stats.hpp"
+#include "taomp/trace.hpp"
+#include "taomp/utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**Hazard Eras from:
+ * Ramalhete, Correia. Brief Announcement: Hazard Eras - Non-Blocking Memory
+ * Reclamation. SPAA 2017.
+ * A global era clock advances on retirement. Every node records the era of
+ * its allocation and of its retirement, and instead of the pointer a reader
+ * publishes the current era, which it only has to write again when the
+ * clock has moved since: protecting the nodes of a stable structure costs
+ * two loads. A retired node is freed once no published era lies within its
+ * [birth, retire] interval.
+ * Like hazard pointers, and unlike epochs, the memory a stalled thread pins
+ * is bounded: the nodes which were alive in the eras it published.
+ * The eras live in a header allocated in front of every node, so the node
+ * type needs no extra fields. The interface mirrors HazardPointer:
+ * allocate(), retire(), protect() and clear() with thread_num * k slots, and
+ * a retired node is destroyed before it is freed.
+ */
+
+namespace taomp {
+
+template <typename AllocatorTy, bool CollectStats = false>
+class HazardEras {
+public:
+  using value_type = typename AllocatorTy::value_type;
+
+private:
+  static constexpr uint64_t NoEra = 0;
+  struct Block {
+    uint64_t birth;
+    uint64_t retire;
+    value_type node;
+  };
+  using BlockAlloc =
+      typename std::allocator_traits<AllocatorTy>::template rebind_alloc<Block>;
+  BlockAlloc alloc;
+  unsigned thread_num, total_slot_num;
+  unsigned retire_threshold;
+  alignas(CacheLineSize) Atomic<uint64_t> era_clock{1};
+  Atomic<uint64_t> *eras;
+  ThreadLocal<std::vector<Block *>> retired;
+  Stats<CollectStats> stats_;
+
+  static Block *blockOf(value_type *p) {
+    return reinterpret_cast<Block *>(reinterpret_cast<char *>(p) -
+                                     offsetof(Block, node));
+  }
+
+  // ends the lifetime of a retired node, e.g. of the values left in it
+  void destroyAndDeallocate(Block *b) {
+    std::destroy_at(&b->node);
+    std::allocator_traits<BlockAlloc>::deallocate(alloc, b, 1);
+  }
+
+  void scan(std::vector<Block *> &list) {
+    trace(TraceKind::ScanBegin, this, list.size());
+    std::vector<uint64_t> published;
+    published.reserve(total_slot_num);
+    for (unsigned i = 0; i < total_slot_num; ++i) {
+      uint64_t era = eras[i].load(std::memory_order_seq_cst);
+      if (era != NoEra) {
+        published.push_back(era);
+      }
+    }
+    std::sort(published.begin(), published.end());
+    std::size_t kept = 0;
+    for (Block *b : list) {
+      auto it = std::lower_bound(published.begin(), published.end(), b->birth);
+      if (it != published.end() && *it <= b->retire) {
+        list[kept++] = b;
+      } else {
+        destroyAndDeallocate(b);
+      }
+    }
+    stats_.count(StatKind::Scan);
+    stats_.count(StatKind::Reclaimed, list.size() - kept);
+    list.resize(kept);
+    trace(TraceKind::ScanEnd, this, kept);
+  }
+
+public:
+  HazardEras(unsigned thread_num, unsigned total_slot_num,
+             unsigned retire_threshold = 0)
+      : thread_num(thread_num), total_slot_num(total_slot_num),
+        retire_threshold(retire_threshold
+                             ? retire_threshold
+                             : std::max(64u, 2 * total_slot_num)),
+        eras(new Atomic<uint64_t>[total_slot_num]), retired(thread_num),
+        stats_(thread_num) {
+    for (unsigned i = 0; i < total_slot_num; ++i) {
+      eras[i].store(NoEra, std::memory_order_relaxed);
+    }
+  }
+  HazardEras(const HazardEras &) = delete;
+  HazardEras &operator=(const HazardEras &) = delete;
+
+  ~HazardEras() {
+    for (unsigned tid = 0; tid < thread_num; ++tid) {
+      for (Block *b : retired[tid]) {
+        destroyAndDeallocate(b);
+      }
+    }
+    delete[] eras;
+  }
+
+  value_type *allocate(std::size_t n) {
+    assert(n == 1);
+    (void)n;
+    Block *b = std::allocator_traits<BlockAlloc>::allocate(alloc, 1);
+    b->birth = era_clock.load(std::memory_order_acquire);
+    return &b->node;
+  }
+
+  /**Frees a node which was never retired, without destroying it.
+   */
+  void deallocate(value_type *p, std::size_t n) {
+    assert(n == 1);
+    (void)n;
+    std::allocator_traits<BlockAlloc>::deallocate(alloc, blockOf(p), 1);
+  }
+
+  void retire(value_type *p) {
+    Block *b = blockOf(p);
+    uint64_t era = era_clock.load(std::memory_order_acquire);
+    b->retire = era;
+    auto &list = retired.get();
+    list.push_back(b);
+    if (era_clock.load(std::memory_order_acquire) == era) {
+      era_clock.fetch_add(1, std::memory_order_acq_rel);
+    }
+    if (list.size() >= retire_threshold) {
+      scan(list);
+    }
+  }
+
+  /**Load src, publishing the current era in slot index until the era is the
+   * same before and after the load. order must give StoreLoad ordering,
+   * i.e. seq_cst.
+   */
+  template <typename T>
+  T *protect(unsigned index, const Atomic<T *> &src,
+             std::memory_order order = std::memory_order_seq_cst) {
+    assert(index < total_slot_num);
+    Atomic<uint64_t> &slot = eras[index];
+    uint64_t published = slot.load(std::memory_order_relaxed);
+    while (true) {
+      T *p = src.load(order);
+      uint64_t era = era_clock.load(order);
+      if (era == published) {
+        return p;
+      }
+      slot.store(era, order);
+      published = era;
+    }
+  }
+
+  void clear(unsigned index,
+             std::memory_order order = std::memory_order_release) {
+    assert(index < total_slot_num);
+    eras[index].store(NoEra, order);
+  }
+
+  uint64_t era() const { return era_clock.load(std::memory_order_relaxed); }
+
+  /**Retired nodes of all threads not freed yet. Only exact when the other
+   * threads are quiescent.
+   */
+  std::size_t retiredCount() {
+    std::size_t ret = 0;
+    for (unsigned tid = 0; tid < thread_num; ++tid) {
+      ret += retired[tid].size();
+    }
+    return ret;
+  }
+
+  Stats<CollectStats> &stats() { return stats_; }
+};
+
+} // namespace taomp
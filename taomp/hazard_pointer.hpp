@@ -1,19 +1,37 @@
 #pragma once
 
+#include "taomp/atomic.hpp"
+#include "taomp/futex.hpp"
+#include "taomp/stats.hpp"
+#include "taomp/trace.hpp"
 #include "taomp/utils.hpp"
 
 #include "llvm/ADT/DenseSet.h"
 #include <atomic>
 #include <forward_list>
 #include <iostream>
+#include <memory>
 #include <string>
+#include <thread>
+#include <vector>
 
 namespace taomp {
-template <typename AllocatorTy> class HazardPointer : public AllocatorTy {
+/**By default a thread whose retired list is full scans all hazard pointers
+ * and frees the unprotected nodes itself, so one operation in a few pays for
+ * O(H + R) frees. After startReclaimer(), a full list is instead handed off
+ * as a batch through a lock-free MPSC list to a reclaimer thread, which scans
+ * and frees (into the allocator, e.g. back into a SlabAllocator pool) on
+ * behalf of the workers. Once the nodes handed off but not freed yet exceed
+ * max_backlog, workers fall back to scanning themselves until the reclaimer
+ * catches up.
+ * A retired node is destroyed through the allocator before it is freed.
+ */
+template <typename AllocatorTy, bool CollectStats = false>
+class HazardPointer : public AllocatorTy {
   using HpTy = void *;
   // it is impossible to have large number of threads or hps
   unsigned total_hp_num, thread_num;
-  std::atomic<HpTy> *hps;
+  Atomic<HpTy> *hps;
   struct ThreadLocal {
     HpTy *start;
     unsigned size;
@@ -22,12 +40,40 @@ template <typename AllocatorTy> class HazardPointer : public AllocatorTy {
   HpTy *tls_storage;
   unsigned deallocate_threshold;
   unsigned storage_per_thread;
+  Stats<CollectStats> stats_;
+  struct RetiredBatch {
+    RetiredBatch *next;
+    std::vector<HpTy> nodes;
+  };
+  // background reclamation, only used after startReclaimer()
+  bool background = false;
+  std::size_t max_backlog = 0;
+  alignas(CacheLineSize) Atomic<RetiredBatch *> pending{nullptr};
+  Atomic<std::size_t> backlog{0};
+  Atomic<uint32_t> wake_word{0};
+  Atomic<bool> reclaimer_sleeping{false};
+  Atomic<bool> reclaimer_stop{false};
+  // the nodes the reclaimer found protected, only touched by the reclaimer
+  std::vector<HpTy> background_retired;
+  std::thread reclaimer;
+
+  // ends the lifetime of a retired node, e.g. of the values left in it
+  void destroyAndDeallocate(HpTy hp) {
+    auto *p = reinterpret_cast<typename AllocatorTy::value_type *>(hp);
+    std::allocator_traits<AllocatorTy>::destroy(*this, p);
+    this->deallocate(p, 1);
+  }
+
   unsigned defaultDeallocateThreshold() {
     // guarantee that after scan(), at least one slot is empty
     return total_hp_num + 1;
   }
-  void scan(ThreadLocal &tl) {
-    assert(tl.start >= tls_storage);
+  /**Free the nodes of [start, start + size) which no hazard pointer holds,
+   * move the others to the front and return their number.
+   */
+  unsigned reclaim(HpTy *start, unsigned size) {
+    // the retiring stores are ordered before reading the hazard pointers
+    std::atomic_thread_fence(std::memory_order_seq_cst);
     llvm::DenseSet<HpTy> hp_set(total_hp_num);
     for (unsigned i = 0; i < total_hp_num; ++i) {
       HpTy hp = hps[i].load(std::memory_order_relaxed);
@@ -36,35 +82,108 @@ template <typename AllocatorTy> class HazardPointer : public AllocatorTy {
       }
     }
     unsigned i1 = 0, i2 = 0;
-    for (; i1 < tl.size; ++i1) {
-      HpTy hp = tl.start[i1];
+    for (; i1 < size; ++i1) {
+      HpTy hp = start[i1];
       if (hp_set.find(hp) == hp_set.end()) {
-        this->deallocate(
-            reinterpret_cast<typename AllocatorTy::value_type *>(hp), 1);
+        destroyAndDeallocate(hp);
       } else {
-        tl.start[i2++] = hp;
+        start[i2++] = hp;
       }
     }
-    tl.size = i2;
+    stats_.count(StatKind::Scan);
+    stats_.count(StatKind::Reclaimed, size - i2);
+    return i2;
+  }
+
+  void scan(ThreadLocal &tl) {
+    assert(tl.start >= tls_storage);
+    trace(TraceKind::ScanBegin, this, tl.size);
+    tl.size = reclaim(tl.start, tl.size);
+    trace(TraceKind::ScanEnd, this, tl.size);
     assert(tl.size < deallocate_threshold);
   }
 
+  void handOff(ThreadLocal &tl) {
+    RetiredBatch *batch =
+        new RetiredBatch{nullptr, std::vector<HpTy>(tl.start, tl.start + tl.size)};
+    backlog.fetch_add(tl.size, std::memory_order_relaxed);
+    tl.size = 0;
+    batch->next = pending.load(std::memory_order_relaxed);
+    while (!pending.compare_exchange_weak(batch->next, batch,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+    }
+    stats_.count(StatKind::ReclaimHandOff);
+    if (reclaimer_sleeping.exchange(false, std::memory_order_seq_cst)) {
+      wake_word.fetch_add(1, std::memory_order_release);
+      futexWake(wake_word, 1);
+    }
+  }
+
+  void reclaimLoop(unsigned tid) {
+    init_thread(tid);
+    unsigned idle_rounds = 0;
+    while (true) {
+      uint32_t seq = wake_word.load(std::memory_order_acquire);
+      RetiredBatch *batch = pending.exchange(nullptr, std::memory_order_acquire);
+      if (!batch) {
+        if (reclaimer_stop.load(std::memory_order_acquire)) {
+          // the workers are done, so nothing left should be protected
+          std::size_t size = background_retired.size();
+          background_retired.resize(reclaim(background_retired.data(), size));
+          backlog.fetch_sub(size - background_retired.size(),
+                            std::memory_order_release);
+          break;
+        }
+        // a worker handing off to a sleeping reclaimer pays for the wake up,
+        // so poll for a while first
+        if (++idle_rounds < 64) {
+          std::this_thread::yield();
+          continue;
+        }
+        idle_rounds = 0;
+        reclaimer_sleeping.store(true, std::memory_order_seq_cst);
+        if (pending.load(std::memory_order_seq_cst) ||
+            reclaimer_stop.load(std::memory_order_seq_cst)) {
+          reclaimer_sleeping.store(false, std::memory_order_relaxed);
+          continue;
+        }
+        futexWait(wake_word, seq);
+        reclaimer_sleeping.store(false, std::memory_order_relaxed);
+        continue;
+      }
+      idle_rounds = 0;
+      while (batch) {
+        background_retired.insert(background_retired.end(),
+                                  batch->nodes.begin(), batch->nodes.end());
+        RetiredBatch *next = batch->next;
+        delete batch;
+        batch = next;
+      }
+      std::size_t size = background_retired.size();
+      trace(TraceKind::ScanBegin, this, size);
+      std::size_t kept = reclaim(background_retired.data(), size);
+      background_retired.resize(kept);
+      trace(TraceKind::ScanEnd, this, kept);
+      backlog.fetch_sub(size - kept, std::memory_order_release);
+    }
+  }
+
 public:
   HazardPointer(unsigned thread_num, unsigned total_hp_num,
                 unsigned deallocate_threshold_ = 0)
       : total_hp_num(total_hp_num), thread_num(thread_num),
-        hps(new std::atomic<HpTy>[total_hp_num] {}),
+        hps(new Atomic<HpTy>[total_hp_num] {}),
         tls(new ThreadLocal[thread_num]{}),
-        deallocate_threshold(deallocate_threshold_) {
+        deallocate_threshold(deallocate_threshold_), stats_(thread_num) {
     if (deallocate_threshold == 0) {
       deallocate_threshold = defaultDeallocateThreshold();
     }
     assert(deallocate_threshold >= defaultDeallocateThreshold());
     unsigned tmp_ = deallocate_threshold * sizeof(HpTy);
-    unsigned tmp1_ = tmp_ / std::hardware_constructive_interference_size;
-    unsigned tmp2_ = tmp_ % std::hardware_constructive_interference_size;
-    storage_per_thread = (tmp2_ ? tmp1_ + 1 : tmp1_) *
-                         std::hardware_constructive_interference_size;
+    unsigned tmp1_ = tmp_ / CacheLineSize;
+    unsigned tmp2_ = tmp_ % CacheLineSize;
+    storage_per_thread = (tmp2_ ? tmp1_ + 1 : tmp1_) * CacheLineSize;
     tls_storage =
         reinterpret_cast<HpTy *>(::malloc(thread_num * storage_per_thread));
     assert(tls_storage);
@@ -83,6 +202,10 @@ public:
   }
 
   ~HazardPointer() {
+    stopReclaimer();
+    for (HpTy hp : background_retired) {
+      destroyAndDeallocate(hp);
+    }
     for (unsigned i = 0; i < thread_num; ++i) {
       forcedDeallocate(i);
     }
@@ -94,14 +217,45 @@ public:
   void forcedDeallocate(unsigned tid) {
     ThreadLocal &tl = tls[tid];
     for (unsigned i = 0; i < tl.size; ++i) {
-      this->deallocate(
-          reinterpret_cast<typename AllocatorTy::value_type *>(tl.start[i]), 1);
+      destroyAndDeallocate(tl.start[i]);
     }
     tl.size = 0;
   }
 
   void forcedDeallocate() { forcedDeallocate(get_thread_id()); }
 
+  /**Start the reclaimer thread, which runs as thread id tid: a spare id no
+   * worker uses, as the stats and a per-thread allocator are indexed by it.
+   * Call it before the workers start retiring.
+   */
+  void startReclaimer(unsigned tid, std::size_t max_backlog_) {
+    assert(!background && tid < thread_num);
+    max_backlog = max_backlog_;
+    reclaimer_stop.store(false, std::memory_order_relaxed);
+    background = true;
+    reclaimer = std::thread([this, tid] { reclaimLoop(tid); });
+  }
+
+  /**Let the reclaimer process everything handed off so far and join it.
+   * Call it after the workers stop retiring.
+   */
+  void stopReclaimer() {
+    if (!background) {
+      return;
+    }
+    reclaimer_stop.store(true, std::memory_order_seq_cst);
+    wake_word.fetch_add(1, std::memory_order_release);
+    futexWake(wake_word);
+    reclaimer.join();
+    background = false;
+  }
+
+  /**Nodes handed off to the reclaimer and not freed yet.
+   */
+  std::size_t backgroundBacklog() const {
+    return backlog.load(std::memory_order_relaxed);
+  }
+
   template <typename T> void retire(T *p_) {
     HpTy p = reinterpret_cast<HpTy>(p_);
     unsigned tid = get_thread_id();
@@ -115,7 +269,14 @@ public:
            tls_storage + storage_per_thread * thread_num);
     tl.start[tl.size++] = p;
     if (tl.size == deallocate_threshold) {
-      scan(tl);
+      if (!background) {
+        scan(tl);
+      } else if (backlog.load(std::memory_order_acquire) < max_backlog) {
+        handOff(tl);
+      } else {
+        stats_.count(StatKind::ReclaimBackpressure);
+        scan(tl);
+      }
       assert(tl.size < deallocate_threshold);
       std::string output_string = std::string("scan ") + std::to_string(tid) + " " + std::to_string(tl.size) + "\n";
     }
@@ -129,15 +290,41 @@ public:
     hps[index].store(reinterpret_cast<HpTy>(hp_), order);
   }
 
-  template <typename T> std::atomic<T *> &get(unsigned index) {
+  template <typename T> Atomic<T *> &get(unsigned index) {
     assert(index < total_hp_num);
-    return *reinterpret_cast<std::atomic<T *> *>(&hps[index]);
+    return *reinterpret_cast<Atomic<T *> *>(&hps[index]);
   }
 
-  template <typename T> std::atomic<T *> *getHp(unsigned index) {
+  template <typename T> Atomic<T *> *getHp(unsigned index) {
     assert(index < total_hp_num);
-    return reinterpret_cast<std::atomic<T *> *>(hps + index);
+    return reinterpret_cast<Atomic<T *> *>(hps + index);
   }
+
+  /**Load src and publish it in hazard pointer index until src is stable.
+   * order must give StoreLoad ordering, i.e. seq_cst.
+   */
+  template <typename T>
+  T *protect(unsigned index, const Atomic<T *> &src,
+             std::memory_order order = std::memory_order_seq_cst) {
+    Atomic<T *> &hp = get<T>(index);
+    T *p = src.load(order);
+    while (true) {
+      hp.store(p, order);
+      T *p1 = src.load(order);
+      if (p1 == p) {
+        return p;
+      }
+      p = p1;
+    }
+  }
+
+  void clear(unsigned index,
+             std::memory_order order = std::memory_order_seq_cst) {
+    assert(index < total_hp_num);
+    hps[index].store(nullptr, order);
+  }
+
+  Stats<CollectStats> &stats() { return stats_; }
 };
 
 } // namespace taomp
@@ -0,0 +1,317 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/hazard_pointer.hpp"
+#include "taomp/trace.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+
+/**Wait-free MPMC queue from:
+ * Kogan, Petrank. Wait-Free Queues With Multiple Enqueuers and Dequeuers.
+ * PPoPP 2011.
+ * Every operation is announced in a per-thread descriptor and every thread
+ * helps all pending operations with a phase not larger than its own before
+ * finishing, so an operation completes in O(thread_num) steps of the queue
+ * algorithm. The only unbounded loops left are the hazard pointer
+ * publish/validate loops, which retry only when a descriptor or the queue end
+ * moved, i.e. when some operation made progress.
+ */
+
+namespace taomp {
+
+template <typename Ty> struct KPQueueNode {
+  Atomic<KPQueueNode *> next;
+  Ty value;
+  unsigned enq_tid;
+  Atomic<unsigned> deq_tid;
+};
+
+template <typename Ty> struct KPQueueOpDesc {
+  uint64_t phase;
+  bool pending;
+  bool enqueue;
+  KPQueueNode<Ty> *node;
+  // result of a finished dequeue, copied out by the helper which finished it
+  Ty value;
+};
+
+template <typename Ty, bool GetLinearizationPoint = false,
+          typename NodeGC = HazardPointer<std::allocator<KPQueueNode<Ty>>>,
+          typename DescGC = HazardPointer<std::allocator<KPQueueOpDesc<Ty>>>>
+class KPQueue : public LinearizationPoint<GetLinearizationPoint> {
+  using Node = KPQueueNode<Ty>;
+  using OpDesc = KPQueueOpDesc<Ty>;
+  static constexpr unsigned NoThread = ~0u;
+  unsigned thread_num;
+  // two node hps per thread: head/tail and its successor; one desc hp
+  NodeGC node_gc;
+  DescGC desc_gc;
+  Atomic<Node *> head, tail;
+  Atomic<uint64_t> phase_count;
+  ThreadLocal<Atomic<OpDesc *>> state;
+
+  Node *newNode(unsigned enq_tid) {
+    return new (node_gc.allocate(1)) Node{nullptr, Ty(), enq_tid, NoThread};
+  }
+
+  OpDesc *newDesc(uint64_t phase, bool pending, bool enqueue, Node *node) {
+    return new (desc_gc.allocate(1))
+        OpDesc{phase, pending, enqueue, node, Ty()};
+  }
+
+  Atomic<Node *> &nodeHp(unsigned tid, unsigned index) {
+    return node_gc.template get<Node>((tid << 1) + index);
+  }
+
+  Atomic<OpDesc *> &descHp(unsigned tid) {
+    return desc_gc.template get<OpDesc>(tid);
+  }
+
+  OpDesc *protectDesc(unsigned tid, unsigned owner) {
+    Atomic<OpDesc *> &hp = descHp(tid);
+    OpDesc *desc = state[owner].load();
+    while (true) {
+      hp.store(desc);
+      OpDesc *desc1 = state[owner].load();
+      if (desc1 == desc) {
+        return desc;
+      }
+      desc = desc1;
+    }
+  }
+
+  static bool isStillPending(OpDesc *desc, uint64_t phase) {
+    return desc->pending && desc->phase <= phase;
+  }
+
+  // desc was never published if the cas fails, so it needs no hp scan
+  bool casDesc(unsigned owner, OpDesc *expected, OpDesc *desc) {
+    if (state[owner].compare_exchange_strong(expected, desc)) {
+      desc_gc.retire(expected);
+      return true;
+    }
+    desc->~OpDesc();
+    desc_gc.deallocate(desc, 1);
+    return false;
+  }
+
+  void publish(unsigned tid, OpDesc *desc) {
+    desc_gc.retire(state[tid].exchange(desc));
+  }
+
+  void help(unsigned tid, uint64_t phase) {
+    for (unsigned i = 0; i < thread_num; ++i) {
+      OpDesc *desc = protectDesc(tid, i);
+      if (!isStillPending(desc, phase)) {
+        continue;
+      }
+      if (desc->enqueue) {
+        helpEnq(tid, i, phase);
+      } else {
+        helpDeq(tid, i, phase);
+      }
+    }
+  }
+
+  void helpEnq(unsigned tid, unsigned owner, uint64_t phase) {
+    Atomic<Node *> &hp = nodeHp(tid, 0);
+    while (true) {
+      Node *last = tail.load();
+      hp.store(last);
+      if (tail.load() != last) {
+        continue;
+      }
+      Node *next = last->next.load();
+      if (next) {
+        helpFinishEnq(tid);
+        continue;
+      }
+      // must be checked after last is read, see the paper's invariant on
+      // pending enqueue descriptors
+      OpDesc *desc = protectDesc(tid, owner);
+      if (!isStillPending(desc, phase)) {
+        return;
+      }
+      if (last->next.compare_exchange_strong(next, desc->node)) {
+        helpFinishEnq(tid);
+        return;
+      }
+    }
+  }
+
+  void helpFinishEnq(unsigned tid) {
+    Atomic<Node *> &hp1 = nodeHp(tid, 0);
+    Atomic<Node *> &hp2 = nodeHp(tid, 1);
+    Node *last = tail.load();
+    hp1.store(last);
+    if (tail.load() != last) {
+      return;
+    }
+    Node *next = last->next.load();
+    if (!next) {
+      return;
+    }
+    hp2.store(next);
+    if (tail.load() != last) {
+      return;
+    }
+    unsigned owner = next->enq_tid;
+    OpDesc *desc = protectDesc(tid, owner);
+    if (tail.load() == last && desc->pending && desc->node == next) {
+      casDesc(owner, desc, newDesc(desc->phase, false, true, next));
+    }
+    tail.compare_exchange_strong(last, next);
+  }
+
+  void helpDeq(unsigned tid, unsigned owner, uint64_t phase) {
+    Atomic<Node *> &hp = nodeHp(tid, 0);
+    while (true) {
+      OpDesc *desc = protectDesc(tid, owner);
+      if (!isStillPending(desc, phase)) {
+        return;
+      }
+      Node *first = head.load();
+      hp.store(first);
+      if (head.load() != first) {
+        continue;
+      }
+      Node *last = tail.load();
+      Node *next = first->next.load();
+      if (head.load() != first) {
+        continue;
+      }
+      if (first == last) {
+        if (next) {
+          helpFinishEnq(tid);
+          continue;
+        }
+        desc = protectDesc(tid, owner);
+        if (tail.load() == last && isStillPending(desc, phase)) {
+          casDesc(owner, desc, newDesc(desc->phase, false, false, nullptr));
+        }
+        continue;
+      }
+      desc = protectDesc(tid, owner);
+      if (!isStillPending(desc, phase)) {
+        return;
+      }
+      if (head.load() == first && desc->node != first) {
+        if (!casDesc(owner, desc,
+                     newDesc(desc->phase, true, false, first))) {
+          continue;
+        }
+      }
+      unsigned no_thread = NoThread;
+      first->deq_tid.compare_exchange_strong(no_thread, owner);
+      helpFinishDeq(tid);
+    }
+  }
+
+  void helpFinishDeq(unsigned tid) {
+    Atomic<Node *> &hp1 = nodeHp(tid, 0);
+    Atomic<Node *> &hp2 = nodeHp(tid, 1);
+    Node *first = head.load();
+    hp1.store(first);
+    if (head.load() != first) {
+      return;
+    }
+    Node *next = first->next.load();
+    unsigned owner = first->deq_tid.load();
+    if (owner == NoThread || !next) {
+      return;
+    }
+    hp2.store(next);
+    if (head.load() != first) {
+      return;
+    }
+    OpDesc *desc = protectDesc(tid, owner);
+    if (head.load() != first) {
+      return;
+    }
+    if (desc->pending) {
+      OpDesc *done = newDesc(desc->phase, false, false, desc->node);
+      done->value = next->value;
+      casDesc(owner, desc, done);
+    }
+    head.compare_exchange_strong(first, next);
+  }
+
+  void clearHps(unsigned tid) {
+    nodeHp(tid, 0).store(nullptr);
+    nodeHp(tid, 1).store(nullptr);
+    descHp(tid).store(nullptr);
+  }
+
+public:
+  KPQueue(unsigned thread_num)
+      : LinearizationPoint<GetLinearizationPoint>(thread_num),
+        thread_num(thread_num), node_gc(thread_num, 2 * thread_num),
+        desc_gc(thread_num, thread_num), phase_count(0), state(thread_num) {
+    Node *sentinel = newNode(NoThread);
+    head = sentinel;
+    tail = sentinel;
+    for (unsigned i = 0; i < thread_num; ++i) {
+      state[i] = newDesc(0, false, true, nullptr);
+    }
+  }
+
+  ~KPQueue() {
+    Node *node = head.load();
+    while (node) {
+      Node *next = node->next.load();
+      node->~Node();
+      node_gc.deallocate(node, 1);
+      node = next;
+    }
+    for (unsigned i = 0; i < thread_num; ++i) {
+      OpDesc *desc = state[i].load();
+      desc->~OpDesc();
+      desc_gc.deallocate(desc, 1);
+    }
+  }
+
+  // The linearization point may be executed by a helper, so the whole
+  // announce-help-finish window is reported as the linearization interval.
+  void enqueue(Ty value) {
+    trace(TraceKind::EnqueueBegin, this);
+    unsigned tid = get_thread_id();
+    Node *node = newNode(tid);
+    node->value = value;
+    uint64_t phase = phase_count.fetch_add(1) + 1;
+    this->linearizeBefore();
+    publish(tid, newDesc(phase, true, true, node));
+    help(tid, phase);
+    helpFinishEnq(tid);
+    this->linearizeAfter();
+    clearHps(tid);
+    trace(TraceKind::EnqueueEnd, this);
+  }
+
+  std::optional<Ty> dequeue() {
+    trace(TraceKind::DequeueBegin, this);
+    unsigned tid = get_thread_id();
+    uint64_t phase = phase_count.fetch_add(1) + 1;
+    this->linearizeBefore();
+    publish(tid, newDesc(phase, true, false, nullptr));
+    help(tid, phase);
+    helpFinishDeq(tid);
+    this->linearizeAfter();
+    clearHps(tid);
+    // a finished descriptor is never replaced by other threads
+    OpDesc *desc = state[tid].load();
+    if (!desc->node) {
+      trace(TraceKind::DequeueEnd, this);
+      return {};
+    }
+    Ty value = desc->value;
+    node_gc.retire(desc->node);
+    trace(TraceKind::DequeueEnd, this, 1);
+    return value;
+  }
+};
+
+} // namespace taomp
@@ -0,0 +1,533 @@
+#pragma once
+
+#include "taomp/utils.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**Offline linearizability checking of recorded histories, after:
+ * Wing, Gong. Testing and Verifying Concurrent Objects. JPDC 1993.
+ * Lowe. Testing for Linearizability. CCPE 2017 (just-in-time search).
+ * Horn, Kroening. Faster Linearizability Checking via P-Compositionality.
+ * FORTE 2015.
+ *
+ * Every operation carries the interval [before, after] in which it took
+ * effect, e.g. the rdtsc stamps of LinearizationPoint. Call and return events
+ * are replayed in timestamp order, and an operation is only linearized "just
+ * in time": when its return event is reached, the search linearizes some of
+ * the operations whose interval is still open, ending with the returning one.
+ * Operations are thus never reordered across a gap in the intervals, which
+ * prunes the WGL search tree to the operations that really overlap. Each
+ * thread has at most one pending operation, so a configuration is (event,
+ * bit mask of already linearized pending operations, model state); explored
+ * configurations are cached with a copy of the model state, and the search
+ * backtracks by undoing operations on a single model state.
+ */
+
+namespace taomp {
+
+struct Operation {
+  unsigned tid;
+  unsigned kind;
+  int64_t arg;
+  std::optional<int64_t> result;
+  TimeStamp before, after;
+};
+
+namespace internal {
+template <typename It> uint64_t hashRange(It first, It last) {
+  // FNV-1a over the 64-bit values
+  uint64_t h = 14695981039346656037ull;
+  for (; first != last; ++first) {
+    h = (h ^ uint64_t(*first)) * 1099511628211ull;
+  }
+  return h;
+}
+} // namespace internal
+
+/**Search hints of a model, built once per history:
+ * violation() may name an operation which cannot be linearized, found by a
+ * cheap check before the search; a failing search has to exhaust all
+ * interleavings before giving up, so this is what keeps broken histories
+ * fast. priority(i) orders the candidates for linearization (smaller first),
+ * admissible(i) may reject linearizing operation i at this point of the
+ * search when no linearization of the whole history can do so, and
+ * linearized(i)/undone(i) track the search. The default tries operations in
+ * return order.
+ */
+class DefaultHints {
+  const std::vector<Operation> &history;
+
+public:
+  DefaultHints(const std::vector<Operation> &history) : history(history) {}
+  std::optional<std::size_t> violation() const { return {}; }
+  TimeStamp priority(std::size_t i) const { return history[i].after; }
+  bool admissible(std::size_t) const { return true; }
+  void linearized(std::size_t) {}
+  void undone(std::size_t) {}
+};
+
+/**A Model has a default constructed initial State, a Hints type and
+ * bool apply(State &, const Operation &), which performs the operation and
+ * returns whether the recorded result matches the sequential specification,
+ * void undo(State &, const Operation &), which reverts a successful apply, and
+ * uint64_t hash(const State &).
+ */
+struct QueueModel {
+  enum Kind : unsigned { Enqueue, Dequeue };
+  using State = std::deque<int64_t>;
+
+  /**When enqueued values are unique, the dequeue order dictates the enqueue
+   * order: enqueues are tried in the order their values are dequeued, and
+   * enq(v) cannot be linearized while the enqueue of some u is not, if deq(u)
+   * returns before deq(v) is called, or if u is dequeued and v never is. This
+   * cuts every wrong enqueue order as soon as it is tried instead of when the
+   * values are dequeued, possibly much later.
+   * The violations of Henzinger et al. (Aspect-Oriented Linearizability
+   * Proofs, CONCUR 2013) which involve no empty dequeue are found up front:
+   * a value dequeued more often than enqueued, dequeued before
+   * its enqueue is called, and enq(u) preceding enq(v) while deq(v) precedes
+   * deq(u) or u is never dequeued.
+   */
+  class Hints {
+    const std::vector<Operation> &history;
+    bool unique = true;
+    std::unordered_map<int64_t, std::size_t> dequeued_by;
+    std::optional<std::size_t> violation_;
+    // return times of the dequeues of values not enqueued yet in the search
+    std::multiset<TimeStamp> unlinearized;
+
+    const Operation *dequeueOf(std::size_t i) const {
+      auto it = dequeued_by.find(history[i].arg);
+      return it == dequeued_by.end() ? nullptr : &history[it->second];
+    }
+
+    void findViolation() {
+      std::unordered_map<int64_t, std::size_t> enqueued_by;
+      std::vector<std::size_t> enqueues;
+      for (std::size_t i = 0; i < history.size(); ++i) {
+        if (history[i].kind == Enqueue) {
+          enqueued_by.emplace(history[i].arg, i);
+          enqueues.push_back(i);
+        }
+      }
+      for (auto &d : dequeued_by) {
+        auto it = enqueued_by.find(d.first);
+        if (it == enqueued_by.end() ||
+            history[d.second].after < history[it->second].before) {
+          violation_ = d.second;
+          return;
+        }
+      }
+      // for each enq(v), the latest deq(u).before over all enq(u) returning
+      // before enq(v) is called, via a prefix maximum over the enqueues
+      // sorted by return time
+      auto deqBefore = [&](std::size_t i) {
+        const Operation *deq = dequeueOf(i);
+        return deq ? deq->before : std::numeric_limits<TimeStamp>::max();
+      };
+      std::sort(enqueues.begin(), enqueues.end(),
+                [&](std::size_t a, std::size_t b) {
+                  return history[a].after < history[b].after;
+                });
+      std::vector<TimeStamp> prefix_max(enqueues.size());
+      for (std::size_t k = 0; k < enqueues.size(); ++k) {
+        prefix_max[k] = std::max(k ? prefix_max[k - 1] : 0,
+                                 deqBefore(enqueues[k]));
+      }
+      for (std::size_t i : enqueues) {
+        const Operation *deq = dequeueOf(i);
+        if (!deq) {
+          continue;
+        }
+        auto it = std::lower_bound(
+            enqueues.begin(), enqueues.end(), history[i].before,
+            [&](std::size_t j, TimeStamp t) { return history[j].after < t; });
+        if (it != enqueues.begin() &&
+            prefix_max[it - enqueues.begin() - 1] > deq->after) {
+          violation_ = dequeued_by.at(history[i].arg);
+          return;
+        }
+      }
+    }
+
+  public:
+    Hints(const std::vector<Operation> &history) : history(history) {
+      std::unordered_map<int64_t, std::size_t> enqueue_num, dequeue_num;
+      for (const Operation &op : history) {
+        if (op.kind == Enqueue && ++enqueue_num[op.arg] > 1) {
+          unique = false;
+        }
+      }
+      // a value dequeued more often than it is enqueued
+      for (std::size_t i = 0; i < history.size(); ++i) {
+        if (history[i].kind == Dequeue && history[i].result) {
+          int64_t v = history[i].result.value();
+          if (++dequeue_num[v] > enqueue_num[v]) {
+            violation_ = i;
+            return;
+          }
+        }
+      }
+      if (!unique) {
+        return;
+      }
+      for (std::size_t i = 0; i < history.size(); ++i) {
+        if (history[i].kind == Dequeue && history[i].result) {
+          dequeued_by.emplace(history[i].result.value(), i);
+        }
+      }
+      findViolation();
+      for (std::size_t i = 0; i < history.size(); ++i) {
+        if (history[i].kind == Enqueue) {
+          if (const Operation *deq = dequeueOf(i)) {
+            unlinearized.insert(deq->after);
+          }
+        }
+      }
+    }
+
+    std::optional<std::size_t> violation() const { return violation_; }
+
+    TimeStamp priority(std::size_t i) const {
+      if (history[i].kind != Enqueue) {
+        return history[i].after;
+      }
+      const Operation *deq = dequeueOf(i);
+      return deq ? deq->after : std::numeric_limits<TimeStamp>::max();
+    }
+
+    bool admissible(std::size_t i) const {
+      if (history[i].kind != Enqueue || !unique) {
+        return true;
+      }
+      const Operation *deq = dequeueOf(i);
+      if (!deq) {
+        return unlinearized.empty();
+      }
+      // skip the entry of deq itself (or an equal one, which passes anyway)
+      auto it = unlinearized.begin();
+      if (*it == deq->after) {
+        ++it;
+      }
+      return it == unlinearized.end() || *it >= deq->before;
+    }
+
+    void linearized(std::size_t i) {
+      if (history[i].kind == Enqueue) {
+        if (const Operation *deq = dequeueOf(i)) {
+          unlinearized.erase(unlinearized.find(deq->after));
+        }
+      }
+    }
+
+    void undone(std::size_t i) {
+      if (history[i].kind == Enqueue) {
+        if (const Operation *deq = dequeueOf(i)) {
+          unlinearized.insert(deq->after);
+        }
+      }
+    }
+  };
+
+  static bool apply(State &s, const Operation &op) {
+    if (op.kind == Enqueue) {
+      s.push_back(op.arg);
+      return true;
+    }
+    if (s.empty()) {
+      return !op.result;
+    }
+    if (op.result != s.front()) {
+      return false;
+    }
+    s.pop_front();
+    return true;
+  }
+  static void undo(State &s, const Operation &op) {
+    if (op.kind == Enqueue) {
+      s.pop_back();
+    } else if (op.result) {
+      s.push_front(op.result.value());
+    }
+  }
+  static uint64_t hash(const State &s) {
+    return internal::hashRange(s.begin(), s.end());
+  }
+};
+
+struct StackModel {
+  enum Kind : unsigned { Push, Pop };
+  using State = std::vector<int64_t>;
+  using Hints = DefaultHints;
+  static bool apply(State &s, const Operation &op) {
+    if (op.kind == Push) {
+      s.push_back(op.arg);
+      return true;
+    }
+    if (s.empty()) {
+      return !op.result;
+    }
+    if (op.result != s.back()) {
+      return false;
+    }
+    s.pop_back();
+    return true;
+  }
+  static void undo(State &s, const Operation &op) {
+    if (op.kind == Push) {
+      s.pop_back();
+    } else if (op.result) {
+      s.push_back(op.result.value());
+    }
+  }
+  static uint64_t hash(const State &s) {
+    return internal::hashRange(s.begin(), s.end());
+  }
+};
+
+/**Set operations return whether they found/changed the key (result 0 or 1).
+ * Operations on different keys commute, so set histories are P-compositional
+ * and are checked one key at a time, see checkLinearizableByKey().
+ */
+struct SetModel {
+  enum Kind : unsigned { Insert, Remove, Contains };
+  using State = std::set<int64_t>;
+  using Hints = DefaultHints;
+  static bool apply(State &s, const Operation &op) {
+    bool present = s.count(op.arg);
+    bool expected = op.kind == Insert ? !present : present;
+    if (op.result != int64_t(expected)) {
+      return false;
+    }
+    if (op.kind == Insert) {
+      s.insert(op.arg);
+    } else if (op.kind == Remove) {
+      s.erase(op.arg);
+    }
+    return true;
+  }
+  static void undo(State &s, const Operation &op) {
+    if (op.kind == Insert) {
+      s.erase(op.arg);
+    } else if (op.kind == Remove) {
+      s.insert(op.arg);
+    }
+  }
+  static uint64_t hash(const State &s) {
+    return internal::hashRange(s.begin(), s.end());
+  }
+  static int64_t key(const Operation &op) { return op.arg; }
+};
+
+struct LinearizabilityResult {
+  bool linearizable = true;
+  // index into the history of the operation which could not be linearized
+  std::size_t failed = 0;
+  explicit operator bool() const { return linearizable; }
+};
+
+template <typename Model> class LinearizabilityChecker {
+  using State = typename Model::State;
+  static constexpr std::size_t None = ~std::size_t(0);
+
+  struct Event {
+    TimeStamp time;
+    bool is_return;
+    std::size_t op;
+  };
+
+  // undo log of the search; Linearize entries are the choice points
+  struct TrailEntry {
+    enum { Call, Return, Linearize } kind;
+    std::size_t event;
+    unsigned tid;
+    // for Linearize: index of the choice among the sorted candidates
+    unsigned choice;
+  };
+
+  // an explored configuration; the state itself is kept, as two states may
+  // share a hash
+  struct Config {
+    std::size_t event;
+    uint64_t mask;
+    uint64_t hash;
+    State state;
+    bool operator==(const Config &other) const {
+      return event == other.event && mask == other.mask &&
+             hash == other.hash && state == other.state;
+    }
+  };
+
+  struct ConfigHash {
+    std::size_t operator()(const Config &c) const {
+      return c.event * 0x9e3779b97f4a7c15ull ^ c.mask * 0xc2b2ae3d27d4eb4full ^
+             c.hash;
+    }
+  };
+
+  const std::vector<Operation> &history;
+  typename Model::Hints hints;
+
+public:
+  LinearizabilityChecker(const std::vector<Operation> &history)
+      : history(history), hints(history) {}
+
+  LinearizabilityResult check() {
+    if (std::optional<std::size_t> violation = hints.violation()) {
+      LinearizabilityResult ret;
+      ret.linearizable = false;
+      ret.failed = violation.value();
+      return ret;
+    }
+    std::vector<Event> events;
+    events.reserve(2 * history.size());
+    unsigned thread_num = 0;
+    for (std::size_t i = 0; i < history.size(); ++i) {
+      assert(history[i].before <= history[i].after);
+      events.push_back({history[i].before, false, i});
+      events.push_back({history[i].after, true, i});
+      thread_num = std::max(thread_num, history[i].tid + 1);
+    }
+    assert(thread_num <= 64);
+    // calls first on ties: touching intervals are treated as overlapping
+    std::sort(events.begin(), events.end(), [](const Event &a, const Event &b) {
+      if (a.time != b.time) {
+        return a.time < b.time;
+      }
+      return a.is_return < b.is_return;
+    });
+
+    std::vector<std::size_t> pending(thread_num, None);
+    std::vector<std::size_t> candidates;
+    std::vector<TrailEntry> trail;
+    std::unordered_set<Config, ConfigHash> explored;
+    State state{};
+    uint64_t mask = 0;
+    std::size_t ev = 0, deepest = 0;
+    unsigned first_choice = 0;
+    while (ev < events.size()) {
+      const Event &e = events[ev];
+      unsigned t = history[e.op].tid;
+      uint64_t bit = uint64_t(1) << t;
+      if (!e.is_return) {
+        assert(pending[t] == None);
+        pending[t] = e.op;
+        trail.push_back({TrailEntry::Call, ev, t, 0});
+        ++ev;
+        first_choice = 0;
+        continue;
+      }
+      if (mask & bit) {
+        mask &= ~bit;
+        pending[t] = None;
+        trail.push_back({TrailEntry::Return, ev, t, 0});
+        ++ev;
+        first_choice = 0;
+        continue;
+      }
+      // linearize one more pending operation; by default the returning one
+      // has the smallest priority and goes first
+      candidates.clear();
+      for (unsigned p = 0; p < thread_num; ++p) {
+        if (pending[p] != None && !(mask & (uint64_t(1) << p))) {
+          candidates.push_back(pending[p]);
+        }
+      }
+      std::sort(candidates.begin(), candidates.end(),
+                [&](std::size_t a, std::size_t b) {
+                  return std::make_pair(hints.priority(a), history[a].tid) <
+                         std::make_pair(hints.priority(b), history[b].tid);
+                });
+      bool found = false;
+      for (unsigned k = first_choice; k < candidates.size(); ++k) {
+        const Operation &op = history[candidates[k]];
+        uint64_t pbit = uint64_t(1) << op.tid;
+        if (!hints.admissible(candidates[k]) || !Model::apply(state, op)) {
+          continue;
+        }
+        if (!explored.insert({ev, mask | pbit, Model::hash(state), state})
+                 .second) {
+          Model::undo(state, op);
+          continue;
+        }
+        hints.linearized(candidates[k]);
+        mask |= pbit;
+        trail.push_back({TrailEntry::Linearize, ev, op.tid, k});
+        found = true;
+        break;
+      }
+      if (found) {
+        first_choice = 0;
+        continue;
+      }
+      deepest = std::max(deepest, ev);
+      // backtrack to the last choice point with untried alternatives
+      while (true) {
+        if (trail.empty()) {
+          LinearizabilityResult ret;
+          ret.linearizable = false;
+          ret.failed = events[deepest].op;
+          return ret;
+        }
+        TrailEntry entry = trail.back();
+        trail.pop_back();
+        ev = entry.event;
+        if (entry.kind == TrailEntry::Call) {
+          pending[entry.tid] = None;
+        } else if (entry.kind == TrailEntry::Return) {
+          pending[entry.tid] = events[ev].op;
+          mask |= uint64_t(1) << entry.tid;
+        } else {
+          Model::undo(state, history[pending[entry.tid]]);
+          hints.undone(pending[entry.tid]);
+          mask &= ~(uint64_t(1) << entry.tid);
+          first_choice = entry.choice + 1;
+          break;
+        }
+      }
+    }
+    return {};
+  }
+};
+
+template <typename Model>
+LinearizabilityResult
+checkLinearizable(const std::vector<Operation> &history) {
+  return LinearizabilityChecker<Model>(history).check();
+}
+
+/**P-compositional check: split the history by Model::key() and check each
+ * sub-history on its own.
+ */
+template <typename Model>
+LinearizabilityResult
+checkLinearizableByKey(const std::vector<Operation> &history) {
+  std::unordered_map<int64_t, std::vector<std::size_t>> partitions;
+  for (std::size_t i = 0; i < history.size(); ++i) {
+    partitions[Model::key(history[i])].push_back(i);
+  }
+  for (auto &p : partitions) {
+    std::vector<Operation> sub;
+    sub.reserve(p.second.size());
+    for (std::size_t i : p.second) {
+      sub.push_back(history[i]);
+    }
+    LinearizabilityResult ret = checkLinearizable<Model>(sub);
+    if (!ret) {
+      ret.failed = p.second[ret.failed];
+      return ret;
+    }
+  }
+  return {};
+}
+
+} // namespace taomp
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "atomic.hpp"
+#include "timing.hpp"
+#include "trace.hpp"
 #include "utils.hpp"
 #include <atomic>
 #include <cassert>
@@ -16,23 +19,35 @@ public:
   void backoff() const {}
 };
 
+/**Spins on readCPUCycleCount() when the calibration found an invariant
+ * counter, on steady_clock otherwise (readCPUCycleCount() is 0 on targets
+ * without a counter); the durations are converted to the clock once.
+ */
 class ExpBackoff {
-  using ClockTy = std::chrono::high_resolution_clock;
   using DurationTy = std::chrono::nanoseconds;
-  DurationTy min, max;
-  mutable DurationTy state;
-  static ClockTy::time_point now() {
-    return ClockTy::now();
+  bool ticks;
+  TimeStamp min, max;
+  mutable TimeStamp state;
+
+  TimeStamp units(DurationTy d) const {
+    return ticks ? nsToTicks(d.count()) : TimeStamp(d.count());
+  }
+  TimeStamp now() const {
+    return ticks ? readCPUCycleCount() : TimeStamp(internal::steadyNs());
   }
+
 public:
-  ExpBackoff(DurationTy min, DurationTy max) : min(min), max(max), state(min) {}
+  ExpBackoff(DurationTy min, DurationTy max)
+      : ticks(tickCalibration().invariant), min(units(min)), max(units(max)),
+        state(this->min) {}
   void backoff() const {
-    ClockTy::time_point end = now() + state;
+    TimeStamp start = now();
+    TimeStamp duration = state;
     state *= 2;
     if (state > max) {
       state = min;
     }
-    while (now() < end) {
+    while (now() - start < duration) {
       continue;
     }
   }
@@ -45,7 +60,7 @@ public:
  */
 class TASLock {
 protected:
-  std::atomic<bool> state{false};
+  Atomic<bool> state{false};
 
 public:
   TASLock() = default;
@@ -59,15 +74,30 @@ public:
     while (state.exchange(true, std::memory_order_acq_rel)) {
       backoffer.backoff();
     }
+    trace(TraceKind::LockAcquire, this);
   }
 
   void lock() {
     return lock(NoBackoff());
   }
 
-  void unlock() { state.store(false, std::memory_order_release); }
+  void unlock() {
+    trace(TraceKind::LockRelease, this);
+    state.store(false, std::memory_order_release);
+  }
 
-  bool try_lock() { return !state.exchange(true, std::memory_order_acq_rel); }
+  /**Reading the state puts the lock into the read set of a transaction, see
+   * ElidedLock.
+   */
+  bool isLocked() const { return state.load(std::memory_order_acquire); }
+
+  bool try_lock() {
+    if (state.exchange(true, std::memory_order_acq_rel)) {
+      return false;
+    }
+    trace(TraceKind::LockAcquire, this);
+    return true;
+  }
 };
 
 class TTASLock : public TASLock {
@@ -80,6 +110,7 @@ public:
         backoffer.backoff();
       }
     }
+    trace(TraceKind::LockAcquire, this);
   }
   void lock() {
     return lock(NoBackoff());
@@ -89,8 +120,8 @@ public:
 /***ArrayLock doesn't satisfy Lockable concept(no try_lock())
  */
 class ArrayLock {
-  std::atomic<bool> *ptr;
-  std::atomic<unsigned> pos;
+  Atomic<bool> *ptr;
+  Atomic<unsigned> pos;
   unsigned bucket_mask;
 
 public:
@@ -98,24 +129,30 @@ public:
   ArrayLock(unsigned thread_num)
       : ptr(nullptr), pos(0), bucket_mask(MaskLeadingZero(thread_num)) {
     assert(thread_num);
-    ptr = new std::atomic<bool>[thread_num << 4];
+    // handles wrap around at bucket_mask, which may exceed thread_num - 1
+    unsigned slot_num = bucket_mask + 1;
+    ptr = new Atomic<bool>[slot_num << 4];
     assert(ptr);
-    for (int i = 1; i < thread_num; ++i) {
-      ptr[i] = false;
+    for (unsigned i = 1; i < slot_num; ++i) {
+      ptr[i << 4] = false;
     }
     ptr[0] = true;
   };
 
+  ~ArrayLock() { delete[] ptr; }
+
   HandleT lock() {
     unsigned handle = pos.fetch_add(1, std::memory_order_acq_rel);
     handle &= bucket_mask;
     while (!ptr[handle << 4].load(std::memory_order_acquire)) {
       continue;
     }
+    trace(TraceKind::LockAcquire, this);
     return handle;
   }
 
   void unlock(HandleT handle) {
+    trace(TraceKind::LockRelease, this);
     ptr[handle << 4].store(false, std::memory_order_relaxed);
     handle = (handle + 1) & bucket_mask;
     ptr[handle << 4].store(true, std::memory_order_release);
@@ -134,7 +171,7 @@ public:
 
 class CLHLock {
 public:
-  using QNode = std::atomic<bool>;
+  using QNode = Atomic<bool>;
   CLHLock(BORROW(QNode *init_tail = nullptr)) : tail(init_tail) {}
 
   GIVE(QNode *) lock(TAKE(QNode *in)) {
@@ -145,10 +182,12 @@ public:
         continue;
       }
     }
+    trace(TraceKind::LockAcquire, this);
     return ret;
   }
 
   void unlock(BORROW(QNode *in)) {
+    trace(TraceKind::LockRelease, this);
     in->store(false, std::memory_order_release);
   }
 
@@ -157,12 +196,12 @@ public:
   }
 
 private:
-  std::atomic<QNode *> tail;
+  Atomic<QNode *> tail;
 };
 
 class MCSLock {
 public:
-  using QNode = std::atomic<uintptr_t>;
+  using QNode = Atomic<uintptr_t>;
   MCSLock(BORROW(QNode *init_tail = nullptr)) : tail(init_tail) {}
   void lock(BORROW(QNode *in)) {
     QNode *old_tail = tail.exchange(in, std::memory_order_acq_rel);
@@ -175,8 +214,10 @@ public:
     } else {
       in->fetch_add(1, std::memory_order_release);
     }
+    trace(TraceKind::LockAcquire, this);
   }
   void unlock(BORROW(QNode *in)) {
+    trace(TraceKind::LockRelease, this);
     QNode* in1 = in;
     if (tail.compare_exchange_strong(in1, nullptr, std::memory_order_acq_rel,
                               std::memory_order_acquire)) {
@@ -187,13 +228,13 @@ public:
     do {
       v = in->load(std::memory_order_acquire) ^ 1;
     } while (!v);
-    reinterpret_cast<std::atomic<uintptr_t> *>(v)->fetch_add(
+    reinterpret_cast<QNode *>(v)->fetch_add(
         1, std::memory_order_release);
     in->store(0, std::memory_order_release);
   }
 
 private:
-  std::atomic<QNode *> tail;
+  Atomic<QNode *> tail;
 };
 
 } // namespace taomp
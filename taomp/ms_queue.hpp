@@ -1,110 +1,253 @@
 #pragma once
 
+#include "taomp/atomic.hpp"
+#include "taomp/hazard_eras.hpp"
 #include "taomp/hazard_pointer.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/stats.hpp"
+#include "taomp/trace.hpp"
 #include "taomp/utils.hpp"
 #include <atomic>
 #include <memory>
+#include <new>
 #include <optional>
+#include <type_traits>
+#include <utility>
 
 namespace taomp {
 
 template <typename Ty> struct MSQueueNode {
-  std::atomic<MSQueueNode *> next;
+  Atomic<MSQueueNode *> next;
   Ty value;
   MSQueueNode() : next(nullptr) {}
 };
 
+/**Payload policies, i.e. how a node stores its value and how a dequeuer gets
+ * it out.
+ * CopyPayload: the value is stored in the node and copied out before the
+ * CAS on head, by every contender (Ty must be default constructible and
+ * copyable).
+ * MovePayload: the value is stored in the node as a std::optional, and only
+ * the dequeuer whose CAS succeeded moves it out, still protected by its
+ * hazard pointer, so move-only types work.
+ * OutOfLinePayload: the node holds a pointer to a separately allocated
+ * value, taken by the CAS winner. All nodes have the same small size,
+ * whatever Ty is.
+ */
+struct CopyPayload {
+  template <typename Ty> using Node = MSQueueNode<Ty>;
+  static constexpr bool ReadBeforeCas = true;
+  template <typename Ty> static void put(Node<Ty> &node, Ty &&value) {
+    node.value = std::move(value);
+  }
+  template <typename Ty> static Ty get(Node<Ty> &node) { return node.value; }
+};
+
+template <typename Ty> struct MSQueueOptionalNode {
+  Atomic<MSQueueOptionalNode *> next;
+  std::optional<Ty> value;
+  MSQueueOptionalNode() : next(nullptr) {}
+};
+
+struct MovePayload {
+  template <typename Ty> using Node = MSQueueOptionalNode<Ty>;
+  static constexpr bool ReadBeforeCas = false;
+  template <typename Ty> static void put(Node<Ty> &node, Ty &&value) {
+    node.value.emplace(std::move(value));
+  }
+  template <typename Ty> static Ty get(Node<Ty> &node) {
+    Ty ret = std::move(*node.value);
+    node.value.reset();
+    return ret;
+  }
+};
+
+template <typename Ty> struct MSQueuePtrNode {
+  Atomic<MSQueuePtrNode *> next;
+  Ty *value;
+  MSQueuePtrNode() : next(nullptr), value(nullptr) {}
+  // the values no dequeuer took
+  ~MSQueuePtrNode() { delete value; }
+};
+
+struct OutOfLinePayload {
+  template <typename Ty> using Node = MSQueuePtrNode<Ty>;
+  static constexpr bool ReadBeforeCas = false;
+  template <typename Ty> static void put(Node<Ty> &node, Ty &&value) {
+    node.value = new Ty(std::move(value));
+  }
+  template <typename Ty> static Ty get(Node<Ty> &node) {
+    std::unique_ptr<Ty> p(node.value);
+    node.value = nullptr;
+    return std::move(*p);
+  }
+};
+
+namespace internal {
+/**The GC of a queue allocates its nodes, so its allocator is rebound to the
+ * node type of the payload policy.
+ */
+template <typename GC, typename Node> struct RebindGC { using type = GC; };
+
+template <typename AllocatorTy, bool CollectStats, typename Node>
+struct RebindGC<HazardPointer<AllocatorTy, CollectStats>, Node> {
+  using type = HazardPointer<
+      typename std::allocator_traits<AllocatorTy>::template rebind_alloc<Node>,
+      CollectStats>;
+};
+
+template <typename AllocatorTy, bool CollectStats, typename Node>
+struct RebindGC<HazardEras<AllocatorTy, CollectStats>, Node> {
+  using type = HazardEras<
+      typename std::allocator_traits<AllocatorTy>::template rebind_alloc<Node>,
+      CollectStats>;
+};
+} // namespace internal
+
+/**With CollectStats, the queue counts CAS retries and tail-lagging help
+ * steps; snapshot() adds the scans and reclaimed nodes counted by the GC,
+ * e.g. HazardPointer<std::allocator<MSQueueNode<Ty>>, true>. GC is
+ * HazardPointer or HazardEras, the queue only uses protect(), clear() and
+ * retire() with two slots per thread.
+ * Order (SeqCstOrder or AcqRelOrder) gives the memory orderings, Backoff
+ * (NoBackoff, ExpBackoff, ...) is run after every failed CAS, starting from
+ * a copy of the prototype passed to the constructor in every operation, and
+ * Payload is one of the payload policies above. The defaults are the
+ * original seq_cst, no backoff, inline copy queue.
+ * The GC destroys a node with the value left in it (a CopyPayload sentinel
+ * keeps a copy of the last value dequeued) when it frees the node; the
+ * destructor destroys the nodes still linked.
+ */
 template <typename Ty,
           bool GetLinearizationPoint = false,
-          typename GC = HazardPointer<std::allocator<MSQueueNode<Ty>>>>
-class MSQueue : public LinearizationPoint<GetLinearizationPoint> {
-  using Node = MSQueueNode<Ty>;
-  GC gc;
+          typename GC = HazardPointer<std::allocator<MSQueueNode<Ty>>>,
+          bool CollectStats = false, typename Order = SeqCstOrder,
+          typename Backoff = NoBackoff, typename Payload = CopyPayload>
+class MSQueue : public LinearizationPoint<GetLinearizationPoint>,
+                public Stats<CollectStats> {
+  using Node = typename Payload::template Node<Ty>;
+  using GCTy = typename internal::RebindGC<GC, Node>::type;
+  GCTy gc;
   Node *sentinel;
-  std::atomic<Node *> tail, head;
+  Atomic<Node *> tail, head;
+  Backoff backoff_prototype;
+
+  Node *newNode() { return new (gc.allocate(1)) Node(); }
 
 public:
-  MSQueue(unsigned thread_num)
+  MSQueue(unsigned thread_num, const Backoff &backoff = Backoff())
       : LinearizationPoint<GetLinearizationPoint>(thread_num),
-        gc(thread_num, 2 * thread_num), sentinel(gc.allocate(1)),
-        tail(sentinel), head(sentinel) {
-    sentinel->next = nullptr;
+        Stats<CollectStats>(thread_num), gc(thread_num, 2 * thread_num),
+        sentinel(newNode()), tail(sentinel), head(sentinel),
+        backoff_prototype(backoff) {}
+
+  ~MSQueue() {
+    Node *node = head.load(std::memory_order_relaxed);
+    while (node) {
+      Node *next = node->next.load(std::memory_order_relaxed);
+      node->~Node();
+      gc.deallocate(node, 1);
+      node = next;
+    }
   }
 
   void enqueue(Ty value) {
+    trace(TraceKind::EnqueueBegin, this);
     unsigned tid = get_thread_id();
-    std::atomic<Node *> &hp = gc.template get<Node>(tid << 1);
-    Node *node = gc.allocate(1);
-    node->value = value;
-    node->next = nullptr;
+    unsigned slot = tid << 1;
+    Backoff backoff = backoff_prototype;
+    Node *node = newNode();
+    Payload::put(*node, std::move(value));
     Node *t;
     while (true) {
-      t = tail.load();
-      hp.store(t);
-      if (tail.load() != t) {
-        continue;
-      }
-      Node *next = t->next.load();
+      t = gc.protect(slot, tail, Order::protect);
+      Node *next = t->next.load(Order::load);
       if (next) {
-        tail.compare_exchange_strong(t, next);
+        this->count(StatKind::HelpStep);
+        tail.compare_exchange_strong(t, next, Order::cas, Order::cas_failure);
         continue;
       }
       Node *t1 = nullptr;
       this->linearizeBefore();
-      if (t->next.compare_exchange_strong(t1, node)) {
+      if (t->next.compare_exchange_strong(t1, node, Order::cas,
+                                          Order::cas_failure)) {
         this->linearizeAfter();
         break;
       }
+      this->count(StatKind::CasRetry);
+      trace(TraceKind::CasFail, this);
+      backoff.backoff();
     }
-    tail.compare_exchange_strong(t, node);
-    hp.store(nullptr);
+    tail.compare_exchange_strong(t, node, Order::cas, Order::cas_failure);
+    gc.clear(slot, Order::store);
+    trace(TraceKind::EnqueueEnd, this);
   }
 
   std::optional<Ty> dequeue() {
+    trace(TraceKind::DequeueBegin, this);
     unsigned tid = get_thread_id();
-    std::atomic<Node *> &hp1 = gc.template get<Node>(tid << 1);
-    std::atomic<Node *> &hp2 = gc.template get<Node>((tid << 1) + 1);
-    Ty value;
-    Node *h;
+    unsigned slot1 = tid << 1, slot2 = (tid << 1) + 1;
+    Backoff backoff = backoff_prototype;
+    std::optional<Ty> value;
+    Node *h, *next;
     while (true) {
-      h = head.load();
-      hp1.store(h);
-      if (head.load() != h) {
-        continue;
-      }
-      Node *t = tail.load();
+      h = gc.protect(slot1, head, Order::protect);
+      Node *t = tail.load(Order::load);
       this->linearizeBefore();
-      Node *next = h->next.load();
+      next = gc.protect(slot2, h->next, Order::protect);
       this->linearizeAfter();
-      hp2.store(next);
-      if (head.load() != h) {
+      if (head.load(Order::protect) != h) {
         continue;
       }
       if (h == t) {
         if (!next) {
+          trace(TraceKind::DequeueEnd, this);
           return {};
         } else {
-          tail.compare_exchange_strong(t, next);
+          this->count(StatKind::HelpStep);
+          tail.compare_exchange_strong(t, next, Order::cas,
+                                       Order::cas_failure);
           continue;
         }
       }
       if (!next) {
+        trace(TraceKind::DequeueEnd, this);
         return {};
       }
-      value = next->value;
+      if constexpr (Payload::ReadBeforeCas) {
+        value.emplace(Payload::get(*next));
+      }
       this->linearizeBefore();
-      if (head.compare_exchange_strong(h, next)) {
+      if (head.compare_exchange_strong(h, next, Order::cas,
+                                       Order::cas_failure)) {
         this->linearizeAfter();
         break;
       }
+      this->count(StatKind::CasRetry);
+      trace(TraceKind::CasFail, this);
+      backoff.backoff();
     }
-    hp1.store(nullptr);
-    hp2.store(nullptr);
+    if constexpr (!Payload::ReadBeforeCas) {
+      // next is the new sentinel, slot2 keeps it alive and nobody else
+      // touches its value
+      value.emplace(Payload::get(*next));
+    }
+    gc.clear(slot1, Order::store);
+    gc.clear(slot2, Order::store);
     gc.retire(h);
+    trace(TraceKind::DequeueEnd, this, 1);
     return value;
   }
 
   Node *end() { return sentinel; }
+
+  GCTy &getGC() { return gc; }
+
+  StatsSnapshot snapshot() {
+    StatsSnapshot ret = Stats<CollectStats>::snapshot();
+    ret += gc.stats().snapshot();
+    return ret;
+  }
 };
 
 } // namespace taomp
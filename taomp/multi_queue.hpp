@@ -0,0 +1,333 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/bounded_queue.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/ms_queue.hpp"
+#include "taomp/timing.hpp"
+#include "taomp/utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <new>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**Relaxed concurrent queues after the MultiQueue of Rihani, Sanders and
+ * Dementiev (SPAA 2015) and the k-FIFO queues of Kirsch, Lippautz and Payer:
+ * C * thread_num sub-queues, an element goes into a random one and a dequeue
+ * takes from the better of two random ones (power of two choices). Neither
+ * FIFO nor priority order holds across sub-queues, but the rank error, i.e.
+ * the number of elements dequeued out of order ahead of one, stays small on
+ * average while the operations spread over many cache lines.
+ * A thread keeps using the sub-queue it picked for Stickiness operations,
+ * which saves the random choices and keeps its cache lines warm, and picks
+ * again early when an attempt fails.
+ * The sub-queue policies:
+ * LockedSubQueue: a std::deque under a TTASLock taken with try_lock(), the
+ * element with the oldest enqueue time stamp wins the two choices.
+ * MSSubQueue, BoundedSubQueue<Capacity>: a lock-free MSQueue or BoundedQueue,
+ * which cannot peek at its head, so the longer sub-queue wins instead. A full
+ * BoundedQueue makes the enqueue try another one, and the enqueue fails once
+ * a sweep found all of them full.
+ * PrioritySubQueue: a binary heap under a TTASLock for
+ * RelaxedPriorityQueue, the smaller key wins.
+ */
+
+namespace taomp {
+
+namespace internal {
+/**A sub-queue has tryEnqueue(value), which only moves from value on
+ * success, tryDequeue() and key(): smaller is better for a dequeue, EmptyKey
+ * if it looks empty. key() is read without synchronization and may be stale.
+ * Bounded tells that a failed tryEnqueue() means full rather than busy.
+ */
+inline constexpr uint64_t EmptyKey = std::numeric_limits<uint64_t>::max();
+
+template <typename Ty>
+class alignas(CacheLineSize) LockedFifo {
+  TTASLock lock;
+  std::deque<std::pair<TimeStamp, Ty>> items;
+  Atomic<uint64_t> top{EmptyKey};
+
+public:
+  static constexpr bool Bounded = false;
+  LockedFifo(unsigned) {}
+
+  bool tryEnqueue(Ty &value) {
+    if (!lock.try_lock()) {
+      return false;
+    }
+    TimeStamp stamp = readCPUCycleCount();
+    items.emplace_back(stamp, std::move(value));
+    if (items.size() == 1) {
+      top.store(stamp, std::memory_order_relaxed);
+    }
+    lock.unlock();
+    return true;
+  }
+
+  std::optional<Ty> tryDequeue() {
+    if (top.load(std::memory_order_relaxed) == EmptyKey || !lock.try_lock()) {
+      return {};
+    }
+    std::optional<Ty> ret;
+    if (!items.empty()) {
+      ret.emplace(std::move(items.front().second));
+      items.pop_front();
+      top.store(items.empty() ? EmptyKey : items.front().first,
+                std::memory_order_relaxed);
+    }
+    lock.unlock();
+    return ret;
+  }
+
+  uint64_t key() const { return top.load(std::memory_order_relaxed); }
+};
+
+template <typename Ty>
+class alignas(CacheLineSize) LockedHeap {
+  struct Greater {
+    bool operator()(const Ty &a, const Ty &b) const {
+      return a.first > b.first;
+    }
+  };
+  TTASLock lock;
+  std::vector<Ty> heap;
+  Atomic<uint64_t> top{EmptyKey};
+
+public:
+  static constexpr bool Bounded = false;
+  LockedHeap(unsigned) {}
+
+  bool tryEnqueue(Ty &value) {
+    if (!lock.try_lock()) {
+      return false;
+    }
+    heap.push_back(std::move(value));
+    std::push_heap(heap.begin(), heap.end(), Greater());
+    top.store(heap.front().first, std::memory_order_relaxed);
+    lock.unlock();
+    return true;
+  }
+
+  std::optional<Ty> tryDequeue() {
+    if (top.load(std::memory_order_relaxed) == EmptyKey || !lock.try_lock()) {
+      return {};
+    }
+    std::optional<Ty> ret;
+    if (!heap.empty()) {
+      std::pop_heap(heap.begin(), heap.end(), Greater());
+      ret.emplace(std::move(heap.back()));
+      heap.pop_back();
+      top.store(heap.empty() ? EmptyKey : uint64_t(heap.front().first),
+                std::memory_order_relaxed);
+    }
+    lock.unlock();
+    return ret;
+  }
+
+  uint64_t key() const { return top.load(std::memory_order_relaxed); }
+};
+
+/**A lock-free queue with an approximate length, see MSSubQueue. A bounded
+ * queue's enqueue returns false when it is full.
+ */
+template <typename Queue, bool IsBounded = false>
+class alignas(CacheLineSize) CountedFifo {
+  Queue queue;
+  Atomic<int64_t> length{0};
+
+  static Queue makeQueue(unsigned thread_num) {
+    if constexpr (std::is_constructible<Queue, unsigned>::value) {
+      return Queue(thread_num);
+    } else {
+      return Queue();
+    }
+  }
+
+public:
+  static constexpr bool Bounded = IsBounded;
+  CountedFifo(unsigned thread_num) : queue(makeQueue(thread_num)) {}
+
+  template <typename Ty> bool tryEnqueue(Ty &value) {
+    if constexpr (Bounded) {
+      if (!queue.enqueue(value)) {
+        return false;
+      }
+    } else {
+      queue.enqueue(std::move(value));
+    }
+    length.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+
+  auto tryDequeue() {
+    auto ret = queue.dequeue();
+    if (ret) {
+      length.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return ret;
+  }
+
+  uint64_t key() const {
+    int64_t n = length.load(std::memory_order_relaxed);
+    return n <= 0 ? EmptyKey : EmptyKey - uint64_t(n);
+  }
+};
+} // namespace internal
+
+struct LockedSubQueue {
+  template <typename Ty> using Queue = internal::LockedFifo<Ty>;
+};
+
+struct MSSubQueue {
+  template <typename Ty> using Queue = internal::CountedFifo<MSQueue<Ty>>;
+};
+
+template <std::size_t Capacity> struct BoundedSubQueue {
+  template <typename Ty>
+  using Queue = internal::CountedFifo<BoundedQueue<Ty, Capacity>, true>;
+};
+
+struct PrioritySubQueue {
+  template <typename Ty> using Queue = internal::LockedHeap<Ty>;
+};
+
+template <typename Ty, typename SubQueue = LockedSubQueue, unsigned C = 2,
+          unsigned Stickiness = 8>
+class MultiQueue {
+  using Queue = typename SubQueue::template Queue<Ty>;
+  struct Local {
+    uint64_t rng;
+    unsigned enqueue_index, enqueue_left;
+    unsigned dequeue_index, dequeue_left;
+  };
+  unsigned queue_num;
+  Queue *queues;
+  ThreadLocal<Local> locals;
+
+  // xorshift64
+  static unsigned random(Local &local, unsigned bound) {
+    uint64_t x = local.rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    local.rng = x;
+    return unsigned((x >> 32) * bound >> 32);
+  }
+
+  Queue &pickForDequeue(Local &local) {
+    if (local.dequeue_left) {
+      --local.dequeue_left;
+      return queues[local.dequeue_index];
+    }
+    unsigned i = random(local, queue_num), j = random(local, queue_num);
+    local.dequeue_index = queues[j].key() < queues[i].key() ? j : i;
+    local.dequeue_left = Stickiness - 1;
+    return queues[local.dequeue_index];
+  }
+
+public:
+  MultiQueue(unsigned thread_num, uint64_t seed = 0x9e3779b97f4a7c15ull)
+      : queue_num(C * thread_num), locals(thread_num) {
+    static_assert(C >= 1 && Stickiness >= 1);
+    queues = taomp::aligned_alloc<Queue, alignof(Queue)>(queue_num);
+    for (unsigned i = 0; i < queue_num; ++i) {
+      new (queues + i) Queue(thread_num);
+    }
+    for (unsigned tid = 0; tid < thread_num; ++tid) {
+      Local &local = locals[tid];
+      local.rng = (seed ^ (uint64_t(tid + 1) * 0xbf58476d1ce4e5b9ull)) | 1;
+      local.enqueue_left = local.dequeue_left = 0;
+      local.enqueue_index = local.dequeue_index = 0;
+    }
+  }
+  MultiQueue(const MultiQueue &) = delete;
+  MultiQueue &operator=(const MultiQueue &) = delete;
+
+  ~MultiQueue() {
+    for (unsigned i = 0; i < queue_num; ++i) {
+      queues[i].~Queue();
+    }
+    free(queues);
+  }
+
+  unsigned subQueueNum() const { return queue_num; }
+
+  /**Returns false only with bounded sub-queues, after a sweep found every
+   * sub-queue full; as with dequeue(), concurrent dequeues may have made room
+   * behind the sweep.
+   */
+  bool enqueue(Ty value) {
+    Local &local = locals.get();
+    if (local.enqueue_left) {
+      --local.enqueue_left;
+      if (queues[local.enqueue_index].tryEnqueue(value)) {
+        return true;
+      }
+    }
+    // an unbounded sub-queue only fails while locked, so keep trying
+    for (unsigned attempt = 0; !Queue::Bounded || attempt < 2 * queue_num;
+         ++attempt) {
+      unsigned i = random(local, queue_num);
+      if (queues[i].tryEnqueue(value)) {
+        local.enqueue_index = i;
+        local.enqueue_left = Stickiness - 1;
+        return true;
+      }
+    }
+    local.enqueue_left = 0;
+    unsigned start = random(local, queue_num);
+    for (unsigned k = 0; k < queue_num; ++k) {
+      if (queues[(start + k) % queue_num].tryEnqueue(value)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**Returns nothing only after a sweep found every sub-queue empty, which
+   * under concurrent enqueues does not mean the whole queue was empty at any
+   * point.
+   */
+  std::optional<Ty> dequeue() {
+    Local &local = locals.get();
+    for (unsigned attempt = 0; attempt < 2 * queue_num; ++attempt) {
+      if (auto ret = pickForDequeue(local).tryDequeue()) {
+        return ret;
+      }
+      local.dequeue_left = 0;
+    }
+    unsigned start = random(local, queue_num);
+    for (unsigned k = 0; k < queue_num; ++k) {
+      Queue &queue = queues[(start + k) % queue_num];
+      // the key may lag behind a dequeue in progress or the sub-queue be
+      // locked, so wait for it to settle
+      while (queue.key() != internal::EmptyKey) {
+        if (auto ret = queue.tryDequeue()) {
+          return ret;
+        }
+        std::this_thread::yield();
+      }
+    }
+    return {};
+  }
+};
+
+/**Relaxed priority queue: dequeue() returns an element with a small but
+ * not necessarily the smallest key.
+ */
+template <typename Value, unsigned C = 2, unsigned Stickiness = 8>
+using RelaxedPriorityQueue =
+    MultiQueue<std::pair<uint64_t, Value>, PrioritySubQueue, C, Stickiness>;
+
+} // namespace taomp
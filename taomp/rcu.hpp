@@ -0,0 +1,285 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**User space read-copy-update for thread_num threads numbered by
+ * get_thread_id(), after the liburcu flavors (Desnoyers et al., "User-Level
+ * Implementations of Read-Copy Update").
+ * An updater unpublishes an object, waits for a grace period with
+ * synchronize(), after which no reader can still hold a reference, and then
+ * frees it; callRcu() defers the free instead and runs the callbacks of a
+ * thread in batches, one grace period per batch.
+ * Both flavors keep one counter per thread in a ThreadLocal, which holds a
+ * snapshot of the global grace period counter gp_ctr. The counter advances
+ * by one period per synchronize(), and a grace period has elapsed once no
+ * thread announces an older snapshot. gp_ctr is 64 bits wide, so the single
+ * phase check cannot wrap around.
+ */
+
+namespace taomp {
+
+namespace internal {
+/**Grace period bookkeeping and batched callbacks shared by the flavors.
+ * Derived provides isActive(ctr, gp), which tells whether a reader with
+ * counter ctr may still be in a read-side critical section begun before
+ * grace period gp.
+ */
+template <typename Derived> class RcuBase {
+protected:
+  struct Reader {
+    Atomic<uint64_t> ctr{0};
+  };
+  // only the owning thread writes its counter and callbacks, synchronize()
+  // reads every counter
+  ThreadLocal<Reader> readers;
+  ThreadLocal<std::vector<std::function<void()>>> callbacks;
+  alignas(CacheLineSize) Atomic<uint64_t> gp_ctr;
+  std::mutex gp_lock;
+  unsigned batch_size;
+
+  RcuBase(unsigned thread_num, uint64_t gp_init, unsigned batch_size)
+      : readers(thread_num), callbacks(thread_num), gp_ctr(gp_init),
+        batch_size(batch_size) {}
+
+  void waitForReaders(uint64_t gp, unsigned self) {
+    for (unsigned tid = 0; tid < readers.size(); ++tid) {
+      if (tid == self) {
+        continue;
+      }
+      Atomic<uint64_t> &ctr = readers[tid].ctr;
+      unsigned spins = 0;
+      while (Derived::isActive(ctr.load(std::memory_order_acquire), gp)) {
+        if (++spins >= 128) {
+          std::this_thread::yield();
+        }
+      }
+    }
+  }
+
+public:
+  ~RcuBase() {
+    // no reader is left, so everything pending may go
+    for (unsigned tid = 0; tid < callbacks.size(); ++tid) {
+      for (auto &f : callbacks[tid]) {
+        f();
+      }
+    }
+  }
+
+  /**Wait until every read-side critical section in progress has ended.
+   * Concurrent calls share nothing but the lock; call it outside of any
+   * read-side critical section.
+   */
+  void synchronize(unsigned tid = get_thread_id()) {
+    std::lock_guard<std::mutex> guard(gp_lock);
+    // the unpublishing stores are ordered before reading any reader
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t gp =
+        gp_ctr.load(std::memory_order_relaxed) + Derived::GpIncrement;
+    gp_ctr.store(gp, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    waitForReaders(gp, tid);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  /**Run f after a grace period. The callbacks of a thread are queued and run
+   * batch_size at a time after one synchronize(), so this call may block
+   * like synchronize().
+   */
+  void callRcu(std::function<void()> f, unsigned tid = get_thread_id()) {
+    auto &pending = callbacks[tid];
+    pending.push_back(std::move(f));
+    if (pending.size() >= batch_size) {
+      flush(tid);
+    }
+  }
+
+  /**Wait for a grace period and run the pending callbacks of this thread.
+   */
+  void flush(unsigned tid = get_thread_id()) {
+    auto &pending = callbacks[tid];
+    if (pending.empty()) {
+      return;
+    }
+    std::vector<std::function<void()>> batch;
+    batch.swap(pending);
+    static_cast<Derived *>(this)->synchronize(tid);
+    for (auto &f : batch) {
+      f();
+    }
+  }
+};
+} // namespace internal
+
+/**Quiescent state based RCU: read-side critical sections cost nothing, but
+ * every reader thread must go online before its first read and then
+ * regularly announce a quiescent state, i.e. a point where it holds no
+ * reference, e.g. between two requests. A thread which blocks for long goes
+ * offline. The counter of a thread is 0 while offline, otherwise the last
+ * gp_ctr it has seen. synchronize() and callRcu() are quiescent states of
+ * the calling thread.
+ */
+class RcuQsbr : public internal::RcuBase<RcuQsbr> {
+  friend class internal::RcuBase<RcuQsbr>;
+  static constexpr uint64_t GpIncrement = 1;
+
+  static bool isActive(uint64_t ctr, uint64_t gp) { return ctr && ctr < gp; }
+
+public:
+  RcuQsbr(unsigned thread_num, unsigned batch_size = 64)
+      : RcuBase(thread_num, 1, batch_size) {}
+
+  void readLock() {}
+  void readUnlock() {}
+
+  void quiescentState(unsigned tid = get_thread_id()) {
+    readers[tid].ctr.store(gp_ctr.load(std::memory_order_relaxed),
+                           std::memory_order_release);
+    // no read after this point may be ordered before the announcement
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  void threadOnline(unsigned tid = get_thread_id()) { quiescentState(tid); }
+
+  void threadOffline(unsigned tid = get_thread_id()) {
+    readers[tid].ctr.store(0, std::memory_order_release);
+  }
+
+  /**The caller is offline meanwhile, as another thread waiting for the
+   * grace period lock would otherwise block this grace period.
+   */
+  void synchronize(unsigned tid = get_thread_id()) {
+    bool online = readers[tid].ctr.load(std::memory_order_relaxed);
+    if (online) {
+      threadOffline(tid);
+    }
+    RcuBase::synchronize(tid);
+    if (online) {
+      threadOnline(tid);
+    }
+  }
+};
+
+/**RCU with memory barriers: no registration or quiescent states, read-side
+ * critical sections nest and cost a load, a store and a fence on entry and a
+ * release store on exit. The counter of a thread holds the nesting depth in
+ * its low NestBits bits and the grace period snapshot above them.
+ */
+class RcuMb : public internal::RcuBase<RcuMb> {
+  friend class internal::RcuBase<RcuMb>;
+  static constexpr unsigned NestBits = 16;
+  static constexpr uint64_t NestMask = (uint64_t(1) << NestBits) - 1;
+  static constexpr uint64_t GpIncrement = uint64_t(1) << NestBits;
+
+  static bool isActive(uint64_t ctr, uint64_t gp) {
+    return (ctr & NestMask) && (ctr >> NestBits) < (gp >> NestBits);
+  }
+
+public:
+  // gp_ctr always carries a nesting depth of 1, so the outermost readLock()
+  // copies it as it is
+  RcuMb(unsigned thread_num, unsigned batch_size = 64)
+      : RcuBase(thread_num, GpIncrement | 1, batch_size) {}
+
+  void readLock(unsigned tid = get_thread_id()) {
+    Atomic<uint64_t> &ctr = readers[tid].ctr;
+    uint64_t v = ctr.load(std::memory_order_relaxed);
+    if (!(v & NestMask)) {
+      ctr.store(gp_ctr.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    } else {
+      assert((v & NestMask) != NestMask);
+      ctr.store(v + 1, std::memory_order_relaxed);
+    }
+  }
+
+  void readUnlock(unsigned tid = get_thread_id()) {
+    Atomic<uint64_t> &ctr = readers[tid].ctr;
+    uint64_t v = ctr.load(std::memory_order_relaxed);
+    assert(v & NestMask);
+    ctr.store(v - 1, std::memory_order_release);
+  }
+
+  void quiescentState(unsigned = 0) {}
+  void threadOnline(unsigned = 0) {}
+  void threadOffline(unsigned = 0) {}
+};
+
+template <typename Rcu> class RcuReadGuard {
+  Rcu &rcu;
+
+public:
+  RcuReadGuard(Rcu &rcu) : rcu(rcu) { rcu.readLock(); }
+  ~RcuReadGuard() { rcu.readUnlock(); }
+  RcuReadGuard(const RcuReadGuard &) = delete;
+  RcuReadGuard &operator=(const RcuReadGuard &) = delete;
+};
+
+/**Holder of the current snapshot of a read-mostly object, e.g. a routing
+ * table. Readers dereference it inside a read-side critical section (for
+ * RcuQsbr: between quiescent states) without writing shared memory; an
+ * update publishes a new object and frees the old one after a grace period.
+ * Updates must be serialized by the caller.
+ */
+template <typename T, typename Rcu> class RcuPtr {
+  Rcu &rcu;
+  Atomic<T *> ptr;
+
+public:
+  /**A read-side critical section together with the snapshot it reads.
+   */
+  class Snapshot {
+    RcuReadGuard<Rcu> guard;
+    const T *value;
+
+  public:
+    Snapshot(Rcu &rcu, const Atomic<T *> &ptr)
+        : guard(rcu), value(ptr.load(std::memory_order_acquire)) {}
+    const T *get() const { return value; }
+    const T *operator->() const { return value; }
+    const T &operator*() const { return *value; }
+  };
+
+  RcuPtr(Rcu &rcu, std::unique_ptr<T> init = nullptr)
+      : rcu(rcu), ptr(init.release()) {}
+  RcuPtr(const RcuPtr &) = delete;
+  RcuPtr &operator=(const RcuPtr &) = delete;
+  // nobody may read any more
+  ~RcuPtr() { delete ptr.load(std::memory_order_relaxed); }
+
+  /**Only valid inside a read-side critical section.
+   */
+  const T *get() const { return ptr.load(std::memory_order_acquire); }
+
+  Snapshot snapshot() const { return Snapshot(rcu, ptr); }
+
+  /**Publish fresh and free the old object with callRcu().
+   */
+  void update(std::unique_ptr<T> fresh) {
+    T *old = ptr.exchange(fresh.release(), std::memory_order_acq_rel);
+    if (old) {
+      rcu.callRcu([old] { delete old; });
+    }
+  }
+
+  /**Publish fresh and free the old object after synchronize().
+   */
+  void updateSync(std::unique_ptr<T> fresh) {
+    T *old = ptr.exchange(fresh.release(), std::memory_order_acq_rel);
+    rcu.synchronize();
+    delete old;
+  }
+};
+
+} // namespace taomp
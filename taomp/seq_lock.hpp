@@ -0,0 +1,136 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/lock.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+/**Sequence lock for a small trivially copyable T, read by many threads and
+ * written rarely. The sequence number is odd while a write is in progress;
+ * a reader copies the value between two reads of the sequence and retries if
+ * they differ or are odd, so readers never store to shared memory and never
+ * delay the writer.
+ * A copy racing with a write would be a data race on T, hence the value is
+ * kept as an array of relaxed atomic words, copied in and out with memcpy.
+ * The reader's second sequence load is ordered after the copy by an acquire
+ * fence, and the writer's word stores after its first sequence store by a
+ * release fence (Boehm, "Can Seqlocks Get Along With Programming Language
+ * Memory Models?", MSPC 2012).
+ * With MultiWriter, writers are serialized by a TTASLock; otherwise there
+ * must be a single writer thread.
+ */
+
+namespace taomp {
+
+namespace internal {
+template <bool MultiWriter> class SeqLockWriters {
+public:
+  void lock() {}
+  void unlock() {}
+};
+
+template <> class SeqLockWriters<true> {
+  TTASLock writer_lock;
+
+public:
+  void lock() { writer_lock.lock(); }
+  void unlock() { writer_lock.unlock(); }
+};
+} // namespace internal
+
+template <typename T, bool MultiWriter = false>
+class SeqLock : private internal::SeqLockWriters<MultiWriter> {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "SeqLock needs a trivially copyable T");
+  using Word = uint64_t;
+  static constexpr std::size_t WordNum =
+      (sizeof(T) + sizeof(Word) - 1) / sizeof(Word);
+
+  alignas(CacheLineSize) Atomic<uint64_t> seq{0};
+  Atomic<Word> words[WordNum];
+
+  void copyOut(T &value) const {
+    Word buffer[WordNum];
+    for (std::size_t i = 0; i < WordNum; ++i) {
+      buffer[i] = words[i].load(std::memory_order_relaxed);
+    }
+    std::memcpy(&value, buffer, sizeof(T));
+  }
+
+  void copyIn(const T &value) {
+    Word buffer[WordNum] = {};
+    std::memcpy(buffer, &value, sizeof(T));
+    for (std::size_t i = 0; i < WordNum; ++i) {
+      words[i].store(buffer[i], std::memory_order_relaxed);
+    }
+  }
+
+  void beginWrite() {
+    this->lock();
+    uint64_t s = seq.load(std::memory_order_relaxed);
+    seq.store(s + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void endWrite() {
+    seq.store(seq.load(std::memory_order_relaxed) + 1,
+              std::memory_order_release);
+    this->unlock();
+  }
+
+public:
+  SeqLock(const T &value = T()) { copyIn(value); }
+  SeqLock(const SeqLock &) = delete;
+  SeqLock &operator=(const SeqLock &) = delete;
+
+  /**One attempt, fails if a write was in progress.
+   */
+  bool tryLoad(T &value) const {
+    uint64_t s0 = seq.load(std::memory_order_acquire);
+    if (s0 & 1) {
+      return false;
+    }
+    copyOut(value);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return seq.load(std::memory_order_relaxed) == s0;
+  }
+
+  T load() const {
+    T value;
+    unsigned spins = 0;
+    while (!tryLoad(value)) {
+      // the writer may have been preempted halfway
+      if (++spins >= 128) {
+        std::this_thread::yield();
+      }
+    }
+    return value;
+  }
+
+  void store(const T &value) {
+    beginWrite();
+    copyIn(value);
+    endWrite();
+  }
+
+  /**Read, modify with f(T &) and write back as one write.
+   */
+  template <typename F> void update(F f) {
+    beginWrite();
+    T value;
+    copyOut(value);
+    f(value);
+    copyIn(value);
+    endWrite();
+  }
+
+  /**Advanced by two per write, odd while one is in progress.
+   */
+  uint64_t version() const { return seq.load(std::memory_order_acquire); }
+};
+
+} // namespace taomp
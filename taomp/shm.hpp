@@ -0,0 +1,601 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/bounded_queue.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/pointer_int_pair.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <new>
+#include <optional>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <type_traits>
+#include <unistd.h>
+
+/**Data structures in memory shared between processes.
+ * A shared mapping usually sits at a different address in every process, so
+ * nothing stored in it may hold a raw pointer. Links are offsets instead:
+ * OffsetPtr is relative to its own address, OffsetIntPair (the PointerIntPair
+ * of this world, a plain word which can be copied and CAS'd) is relative to a
+ * base the user passes in, e.g. the containing object or the arena.
+ * Atomics in the mapping must be lock free to be address free, which holds for
+ * everything below. Memory comes from a ShmArena over a memfd or a /dev/shm
+ * file; objects are never freed individually, a structure which recycles
+ * memory keeps its own free list.
+ */
+
+namespace taomp {
+
+/**Self relative pointer, 0 is null (an OffsetPtr never points to itself).
+ * Copies are rebased, so it may live anywhere in the mapping.
+ */
+template <typename T> class OffsetPtr {
+  intptr_t offset;
+
+  intptr_t offsetTo(const T *ptr) const {
+    return ptr ? reinterpret_cast<const char *>(ptr) -
+                     reinterpret_cast<const char *>(this)
+               : 0;
+  }
+
+public:
+  using element_type = T;
+  OffsetPtr(T *ptr = nullptr) : offset(offsetTo(ptr)) {}
+  OffsetPtr(const OffsetPtr &other) : offset(offsetTo(other.get())) {}
+  OffsetPtr &operator=(const OffsetPtr &other) {
+    offset = offsetTo(other.get());
+    return *this;
+  }
+  OffsetPtr &operator=(T *ptr) {
+    offset = offsetTo(ptr);
+    return *this;
+  }
+
+  T *get() const {
+    return offset ? reinterpret_cast<T *>(
+                        const_cast<char *>(
+                            reinterpret_cast<const char *>(this)) +
+                        offset)
+                  : nullptr;
+  }
+  T *operator->() const { return get(); }
+  T &operator*() const { return *get(); }
+  explicit operator bool() const { return offset; }
+  bool operator==(const OffsetPtr &other) const {
+    return get() == other.get();
+  }
+  bool operator!=(const OffsetPtr &other) const {
+    return get() != other.get();
+  }
+};
+
+/**Same layout and accessors as PointerIntPair, but the pointer is stored as
+ * an offset from a base address, which is passed to every call converting
+ * from or to a pointer. The offset of a pointer equal to the base is
+ * reserved for null. The value is position independent, so it can be stored
+ * in an Atomic and updated with CAS from every process.
+ */
+template <typename T, unsigned IntBits, typename IntType = unsigned,
+          unsigned AlignBits = internal::ConstantLog2<alignof(T)>::value>
+class OffsetIntPair {
+  static_assert(AlignBits >= IntBits);
+  uintptr_t value;
+
+  static constexpr unsigned BlankBits = AlignBits - IntBits;
+  static constexpr auto AlignMask = Mask<uintptr_t>(AlignBits);
+  static constexpr auto BlankMask = Mask<uintptr_t>(BlankBits);
+  static constexpr uintptr_t IntMask = AlignMask >> BlankBits;
+  static constexpr uintptr_t ShiftedIntMask = AlignMask ^ BlankMask;
+  static constexpr uintptr_t OffsetMask = ~AlignMask;
+
+  static uintptr_t offsetOf(const T *ptr, const void *base) {
+    uintptr_t offset = ptr ? reinterpret_cast<uintptr_t>(ptr) -
+                                 reinterpret_cast<uintptr_t>(base)
+                           : 0;
+    assert(!(offset & AlignMask));
+    return offset;
+  }
+
+public:
+  using element_type = T;
+  OffsetIntPair() : value(0) {}
+  OffsetIntPair(T *ptr, IntType i, const void *base) {
+    value = offsetOf(ptr, base) | (uintptr_t(i) << BlankBits);
+  }
+
+  IntType getInt() const { return (value & ShiftedIntMask) >> BlankBits; }
+  void setInt(IntType i) {
+    assert(uintptr_t(i) <= IntMask);
+    value = (value & ~ShiftedIntMask) | (uintptr_t(i) << BlankBits);
+  }
+  uintptr_t getOffset() const { return value & OffsetMask; }
+  T *getPointer(const void *base) const {
+    uintptr_t offset = getOffset();
+    return offset ? reinterpret_cast<T *>(reinterpret_cast<uintptr_t>(base) +
+                                          offset)
+                  : nullptr;
+  }
+  void setPointer(T *ptr, const void *base) {
+    value = offsetOf(ptr, base) | (value & AlignMask);
+  }
+  void setPointerAndInt(T *ptr, IntType i, const void *base) {
+    value = offsetOf(ptr, base) | (value & BlankMask) |
+            (uintptr_t(i) << BlankBits);
+  }
+  void *getOpaqueValue() const { return reinterpret_cast<void *>(value); }
+  bool operator==(const OffsetIntPair &other) const {
+    return value == other.value;
+  }
+  bool operator!=(const OffsetIntPair &other) const {
+    return value != other.value;
+  }
+};
+
+/**A shared mapping with a bump allocator. The first page holds the header: a
+ * magic, the size, the allocation cursor and RootNum root offsets through
+ * which processes find the objects another process created.
+ * An anonymous arena lives in a memfd, handed to other processes by fork()
+ * or over a unix socket, and mapped there with ShmArena(fd); the fd is
+ * close-on-exec, so exec'd programs do not inherit it. A named arena is
+ * a /dev/shm file created or opened with shm_open.
+ */
+class ShmArena {
+public:
+  static constexpr unsigned RootNum = 8;
+  static constexpr uint64_t Magic = 0x4d48535043504d54;
+
+private:
+  struct Header {
+    uint64_t magic;
+    std::size_t size;
+    Atomic<std::size_t> used;
+    Atomic<std::size_t> roots[RootNum];
+  };
+  static_assert(sizeof(Header) <= 4096);
+  int fd = -1;
+  char *base = nullptr;
+  std::size_t size = 0;
+  std::string name;
+
+  Header *header() const { return reinterpret_cast<Header *>(base); }
+
+  static std::system_error error(const char *what) {
+    return std::system_error(errno, std::generic_category(), what);
+  }
+
+  void map(std::size_t map_size) {
+    void *p = mmap(nullptr, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                   0);
+    if (p == MAP_FAILED) {
+      throw error("mmap");
+    }
+    base = static_cast<char *>(p);
+    size = map_size;
+  }
+
+  void create(std::size_t arena_size) {
+    if (ftruncate(fd, arena_size)) {
+      throw error("ftruncate");
+    }
+    map(arena_size);
+    Header *h = header();
+    h->size = arena_size;
+    new (&h->used) Atomic<std::size_t>(4096);
+    for (auto &root : h->roots) {
+      new (&root) Atomic<std::size_t>(0);
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    h->magic = Magic;
+  }
+
+  void attach() {
+    struct stat st;
+    if (fstat(fd, &st)) {
+      throw error("fstat");
+    }
+    map(st.st_size);
+    if (header()->magic != Magic || header()->size != size) {
+      throw std::system_error(EINVAL, std::generic_category(),
+                              "not a taomp arena");
+    }
+  }
+
+  ShmArena() = default;
+
+public:
+  /**A fresh arena in a memfd.
+   */
+  static ShmArena anonymous(std::size_t arena_size) {
+    ShmArena arena;
+#ifdef MFD_CLOEXEC
+    arena.fd = memfd_create("taomp", MFD_CLOEXEC);
+#else
+    errno = ENOSYS;
+#endif
+    if (arena.fd < 0) {
+      throw error("memfd_create");
+    }
+    arena.create(arena_size);
+    return arena;
+  }
+
+  /**Create /dev/shm/<name> (which must not exist) or open an existing one.
+   * The creator unlinks the file in its destructor.
+   */
+  static ShmArena named(const std::string &name, std::size_t arena_size,
+                        bool create) {
+    ShmArena arena;
+    arena.fd = shm_open(name.c_str(), O_RDWR | (create ? O_CREAT | O_EXCL : 0),
+                        0600);
+    if (arena.fd < 0) {
+      throw error("shm_open");
+    }
+    if (create) {
+      arena.name = name;
+      arena.create(arena_size);
+    } else {
+      arena.attach();
+    }
+    return arena;
+  }
+
+  /**Map an arena another process created, e.g. from an inherited memfd. The
+   * fd is duplicated.
+   */
+  explicit ShmArena(int arena_fd) : fd(dup(arena_fd)) {
+    if (fd < 0) {
+      throw error("dup");
+    }
+    attach();
+  }
+
+  ShmArena(ShmArena &&other)
+      : fd(other.fd), base(other.base), size(other.size),
+        name(std::move(other.name)) {
+    other.fd = -1;
+    other.base = nullptr;
+    other.name.clear();
+  }
+  ShmArena(const ShmArena &) = delete;
+  ShmArena &operator=(const ShmArena &) = delete;
+
+  ~ShmArena() {
+    if (base) {
+      munmap(base, size);
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (!name.empty()) {
+      shm_unlink(name.c_str());
+    }
+  }
+
+  int getFd() const { return fd; }
+  char *getBase() const { return base; }
+  std::size_t getSize() const { return size; }
+
+  std::size_t offsetOf(const void *ptr) const {
+    return static_cast<const char *>(ptr) - base;
+  }
+  template <typename T> T *fromOffset(std::size_t offset) const {
+    return reinterpret_cast<T *>(base + offset);
+  }
+
+  /**Lock free bump allocation, throws std::bad_alloc when the arena is full.
+   */
+  void *allocate(std::size_t bytes, std::size_t align = alignof(max_align_t)) {
+    Atomic<std::size_t> &used = header()->used;
+    std::size_t old = used.load(std::memory_order_relaxed);
+    std::size_t start;
+    do {
+      start = (old + align - 1) & ~(align - 1);
+      if (start + bytes > size) {
+        throw std::bad_alloc();
+      }
+    } while (!used.compare_exchange_weak(old, start + bytes,
+                                         std::memory_order_relaxed));
+    return base + start;
+  }
+
+  template <typename T, typename... Args> T *construct(Args &&... args) {
+    return new (allocate(sizeof(T), alignof(T)))
+        T(std::forward<Args>(args)...);
+  }
+
+  void setRoot(unsigned idx, const void *ptr) {
+    assert(idx < RootNum);
+    header()->roots[idx].store(offsetOf(ptr), std::memory_order_release);
+  }
+
+  /**nullptr until some process calls setRoot(idx, ...).
+   */
+  template <typename T> T *getRoot(unsigned idx) const {
+    assert(idx < RootNum);
+    std::size_t offset = header()->roots[idx].load(std::memory_order_acquire);
+    return offset ? fromOffset<T>(offset) : nullptr;
+  }
+};
+
+/**TTASLock is a single lock free Atomic<bool>, hence address free and usable
+ * between processes when placed in shared memory.
+ */
+static_assert(std::atomic<bool>::is_always_lock_free);
+using ShmTTASLock = TTASLock;
+
+/**MCSLock with the queue linked by offsets relative to the lock, so the lock
+ * and the QNodes must be in the same mapping. Like CLHLock and MCSLock the
+ * caller owns the QNode, e.g. one per process in the arena.
+ */
+class ShmMCSLock {
+public:
+  struct QNode {
+    Atomic<intptr_t> next{0};
+    Atomic<bool> locked{false};
+  };
+
+private:
+  Atomic<intptr_t> tail{0};
+
+  intptr_t offsetOf(QNode *node) const {
+    return reinterpret_cast<char *>(node) -
+           reinterpret_cast<const char *>(this);
+  }
+  QNode *nodeAt(intptr_t offset) {
+    return reinterpret_cast<QNode *>(reinterpret_cast<char *>(this) + offset);
+  }
+
+public:
+  ShmMCSLock() = default;
+  ShmMCSLock(const ShmMCSLock &) = delete;
+  ShmMCSLock &operator=(const ShmMCSLock &) = delete;
+
+  void lock(QNode *node) {
+    node->next.store(0, std::memory_order_relaxed);
+    node->locked.store(true, std::memory_order_relaxed);
+    intptr_t pred = tail.exchange(offsetOf(node), std::memory_order_acq_rel);
+    if (pred) {
+      nodeAt(pred)->next.store(offsetOf(node), std::memory_order_release);
+      while (node->locked.load(std::memory_order_acquire)) {
+      }
+    }
+  }
+
+  void unlock(QNode *node) {
+    intptr_t next = node->next.load(std::memory_order_acquire);
+    if (!next) {
+      intptr_t self = offsetOf(node);
+      if (tail.compare_exchange_strong(self, 0, std::memory_order_acq_rel,
+                                       std::memory_order_relaxed)) {
+        return;
+      }
+      while (!(next = node->next.load(std::memory_order_acquire))) {
+      }
+    }
+    nodeAt(next)->locked.store(false, std::memory_order_release);
+  }
+};
+
+/**The Michael-Scott queue with the counted pointers of the original paper.
+ * A link is one 64-bit word: the offset of the node from the queue in the
+ * low half and a modification count in the high half. Every CAS on a link
+ * bumps its count, so a node recycled between a read and the CAS fails it
+ * unless 2^32 CASes on that link happened meanwhile. The nodes follow the
+ * queue in the arena, within 4GB of it.
+ * Hazard pointers do not work between processes, so the nodes, capacity + 1
+ * of them for the sentinel, are allocated from the arena up front and
+ * recycled through a Treiber stack of the same links.
+ * The queue must be constructed in the arena holding its nodes. Ty must be
+ * trivially copyable: a dequeuer copies the value before its CAS on head,
+ * possibly out of a node recycled meanwhile, and drops the copy when the CAS
+ * fails.
+ */
+template <typename Ty> class alignas(CacheLineSize) ShmMSQueue {
+  static_assert(std::is_trivially_copyable<Ty>::value,
+                "Ty must be trivially copyable");
+
+  class Link {
+    uint64_t value = 0;
+
+  public:
+    Link() = default;
+    Link(uint32_t offset, uint32_t count)
+        : value(uint64_t(count) << 32 | offset) {}
+    // 0 is null, the queue itself is never a node
+    uint32_t offset() const { return uint32_t(value); }
+    uint32_t count() const { return uint32_t(value >> 32); }
+    bool operator==(const Link &other) const { return value == other.value; }
+    bool operator!=(const Link &other) const { return value != other.value; }
+  };
+  static_assert(std::atomic<Link>::is_always_lock_free);
+
+  struct alignas(CacheLineSize) Node {
+    Atomic<Link> next;
+    Ty value;
+  };
+
+  Atomic<Link> head;
+  alignas(CacheLineSize) Atomic<Link> tail;
+  alignas(CacheLineSize) Atomic<Link> free_nodes;
+
+  Node *get(Link link) const {
+    char *self = reinterpret_cast<char *>(const_cast<ShmMSQueue *>(this));
+    return link.offset() ? reinterpret_cast<Node *>(self + link.offset())
+                         : nullptr;
+  }
+  uint32_t offsetOf(Node *node) const {
+    if (!node) {
+      return 0;
+    }
+    uintptr_t offset = reinterpret_cast<uintptr_t>(node) -
+                       reinterpret_cast<uintptr_t>(this);
+    assert(offset && offset <= UINT32_MAX);
+    return uint32_t(offset);
+  }
+  // node, with the count of the link it replaces plus one
+  Link link(Node *node, Link old) const {
+    return Link(offsetOf(node), old.count() + 1);
+  }
+
+  Node *allocNode() {
+    Link top = free_nodes.load(std::memory_order_acquire);
+    while (Node *node = get(top)) {
+      Link next = node->next.load(std::memory_order_relaxed);
+      if (free_nodes.compare_exchange_weak(top, link(get(next), top),
+                                           std::memory_order_acquire)) {
+        return node;
+      }
+    }
+    return nullptr;
+  }
+
+  void freeNode(Node *node) {
+    Link top = free_nodes.load(std::memory_order_relaxed);
+    Link old = node->next.load(std::memory_order_relaxed);
+    do {
+      node->next.store(link(get(top), old), std::memory_order_relaxed);
+    } while (!free_nodes.compare_exchange_weak(top, link(node, top),
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+  }
+
+public:
+  ShmMSQueue(ShmArena &arena, std::size_t capacity) {
+    Node *nodes = static_cast<Node *>(
+        arena.allocate(sizeof(Node) * (capacity + 1), alignof(Node)));
+    for (std::size_t i = 0; i <= capacity; ++i) {
+      new (&nodes[i]) Node{Link(), Ty()};
+    }
+    head.store(Link(offsetOf(nodes), 0), std::memory_order_relaxed);
+    tail.store(Link(offsetOf(nodes), 0), std::memory_order_relaxed);
+    free_nodes.store(Link(), std::memory_order_relaxed);
+    for (std::size_t i = 1; i <= capacity; ++i) {
+      freeNode(&nodes[i]);
+    }
+  }
+  ShmMSQueue(const ShmMSQueue &) = delete;
+  ShmMSQueue &operator=(const ShmMSQueue &) = delete;
+
+  /**Returns false if all capacity nodes are in the queue.
+   */
+  bool enqueue(const Ty &value) {
+    Node *node = allocNode();
+    if (!node) {
+      return false;
+    }
+    node->value = value;
+    Link old = node->next.load(std::memory_order_relaxed);
+    node->next.store(link(nullptr, old), std::memory_order_relaxed);
+    Link t;
+    while (true) {
+      t = tail.load(std::memory_order_acquire);
+      Link next = get(t)->next.load(std::memory_order_acquire);
+      if (t != tail.load(std::memory_order_acquire)) {
+        continue;
+      }
+      if (get(next)) {
+        tail.compare_exchange_strong(t, link(get(next), t),
+                                     std::memory_order_acq_rel);
+      } else if (get(t)->next.compare_exchange_strong(
+                     next, link(node, next), std::memory_order_acq_rel)) {
+        break;
+      }
+    }
+    tail.compare_exchange_strong(t, link(node, t), std::memory_order_acq_rel);
+    return true;
+  }
+
+  /**Returns an empty optional if the queue is empty.
+   */
+  std::optional<Ty> dequeue() {
+    Link h;
+    Ty value;
+    while (true) {
+      h = head.load(std::memory_order_acquire);
+      Link t = tail.load(std::memory_order_acquire);
+      Link next = get(h)->next.load(std::memory_order_acquire);
+      if (h != head.load(std::memory_order_acquire)) {
+        continue;
+      }
+      if (get(h) == get(t)) {
+        if (!get(next)) {
+          return {};
+        }
+        tail.compare_exchange_strong(t, link(get(next), t),
+                                     std::memory_order_acq_rel);
+        continue;
+      }
+      value = get(next)->value;
+      if (head.compare_exchange_strong(h, link(get(next), h),
+                                       std::memory_order_acq_rel)) {
+        break;
+      }
+    }
+    freeNode(get(h));
+    return value;
+  }
+};
+
+/**Zero-copy message passing: MessageSize byte buffers preallocated in the
+ * arena, and two BoundedQueues of buffer indices. A sender takes a free
+ * buffer, fills it in place and posts its index; the receiver reads it in
+ * place and releases it. Payloads are never copied, only indices move through
+ * the queues.
+ */
+template <std::size_t MessageSize, std::size_t Capacity> class ShmChannel {
+  struct alignas(CacheLineSize) Buffer {
+    char data[MessageSize];
+  };
+  BoundedQueue<uint32_t, Capacity> free_buffers;
+  BoundedQueue<uint32_t, Capacity> posted;
+  Buffer buffers[Capacity];
+
+public:
+  ShmChannel() {
+    for (uint32_t i = 0; i < Capacity; ++i) {
+      free_buffers.enqueue(i);
+    }
+  }
+  ShmChannel(const ShmChannel &) = delete;
+  ShmChannel &operator=(const ShmChannel &) = delete;
+
+  static constexpr std::size_t messageSize() { return MessageSize; }
+
+  /**nullptr if every buffer is in flight.
+   */
+  char *acquire() {
+    std::optional<uint32_t> idx = free_buffers.dequeue();
+    return idx ? buffers[*idx].data : nullptr;
+  }
+  void post(char *msg) {
+    bool ok = posted.enqueue(indexOf(msg));
+    assert(ok);
+    (void)ok;
+  }
+  /**nullptr if no message is posted.
+   */
+  char *receive() {
+    std::optional<uint32_t> idx = posted.dequeue();
+    return idx ? buffers[*idx].data : nullptr;
+  }
+  void release(char *msg) {
+    bool ok = free_buffers.enqueue(indexOf(msg));
+    assert(ok);
+    (void)ok;
+  }
+
+private:
+  uint32_t indexOf(char *msg) const {
+    return reinterpret_cast<Buffer *>(msg) - buffers;
+  }
+};
+
+} // namespace taomp
@@ -0,0 +1,297 @@
+#pragma once
+
+#include "taomp/thread_registry.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <sys/mman.h>
+
+/**Concurrent slab allocator for fixed-size objects, e.g. container nodes.
+ * Memory comes from large mmap'd regions (optionally backed by transparent
+ * huge pages), which are carved into SlabSize-aligned slabs with an atomic
+ * bump pointer. A slab belongs to the thread which carved it and holds blocks
+ * of one size class. Each thread allocates from its own free list and slab
+ * without any atomic RMW. A block freed by its owner goes back to the owner's
+ * free list; a block freed by another thread is pushed onto the owner's remote
+ * free list (a Treiber stack with many producers), which the owner takes as a
+ * whole with one exchange when its own list runs dry. Since the owner never
+ * pops single blocks off the remote list, there is no ABA.
+ * Slabs are never returned to the system before the heap is destroyed.
+ */
+
+namespace taomp {
+
+namespace internal {
+struct FreeBlock {
+  FreeBlock *next;
+};
+
+struct SlabHeader {
+  unsigned owner;
+};
+} // namespace internal
+
+/**Hands out SlabSize-aligned slabs carved from mmap'd regions.
+ */
+class SlabSource {
+public:
+  static constexpr std::size_t SlabSize = std::size_t(1) << 16;
+  static constexpr std::size_t RegionSize = std::size_t(1) << 25;
+  static constexpr std::size_t HugePageSize = std::size_t(1) << 21;
+
+private:
+  // lives in the first slab of its region
+  struct Region {
+    Region *next;
+    std::atomic<std::size_t> used;
+  };
+  bool huge_pages;
+  std::atomic<Region *> current{nullptr};
+
+  Region *mapRegion(Region *next) {
+    // over-map so the region can be aligned to a huge page
+    std::size_t size = RegionSize + HugePageSize;
+    void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) {
+      throw std::bad_alloc();
+    }
+    uintptr_t start = reinterpret_cast<uintptr_t>(p);
+    uintptr_t aligned = (start + HugePageSize - 1) & ~(HugePageSize - 1);
+    if (aligned != start) {
+      munmap(p, aligned - start);
+    }
+    munmap(reinterpret_cast<void *>(aligned + RegionSize),
+           start + size - aligned - RegionSize);
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) {
+      madvise(reinterpret_cast<void *>(aligned), RegionSize, MADV_HUGEPAGE);
+    }
+#endif
+    Region *region = reinterpret_cast<Region *>(aligned);
+    region->next = next;
+    new (&region->used) std::atomic<std::size_t>(SlabSize);
+    return region;
+  }
+
+public:
+  SlabSource(bool huge_pages = false) : huge_pages(huge_pages) {}
+  SlabSource(const SlabSource &) = delete;
+  SlabSource &operator=(const SlabSource &) = delete;
+
+  ~SlabSource() {
+    Region *region = current.load(std::memory_order_acquire);
+    while (region) {
+      Region *next = region->next;
+      munmap(region, RegionSize);
+      region = next;
+    }
+  }
+
+  void *allocateSlab() {
+    Region *region = current.load(std::memory_order_acquire);
+    while (true) {
+      if (region) {
+        std::size_t offset =
+            region->used.fetch_add(SlabSize, std::memory_order_relaxed);
+        if (offset + SlabSize <= RegionSize) {
+          return reinterpret_cast<char *>(region) + offset;
+        }
+      }
+      // the region is exhausted: race to install a fresh one
+      Region *fresh = mapRegion(region);
+      if (current.compare_exchange_strong(region, fresh,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire)) {
+        region = fresh;
+      } else {
+        munmap(fresh, RegionSize);
+      }
+    }
+  }
+};
+
+/**Blocks of one size class, with a cache per thread id.
+ */
+class SlabPool {
+  struct ThreadCache {
+    internal::FreeBlock *local = nullptr;
+    char *bump = nullptr;
+    char *bump_end = nullptr;
+    std::atomic<internal::FreeBlock *> remote{nullptr};
+  };
+  std::size_t block_size;
+  SlabSource &source;
+  DynamicThreadLocal<ThreadCache> caches;
+
+  static internal::SlabHeader *slabOf(void *p) {
+    return reinterpret_cast<internal::SlabHeader *>(
+        reinterpret_cast<uintptr_t>(p) & ~(SlabSource::SlabSize - 1));
+  }
+
+  void refill(ThreadCache &c, unsigned tid) {
+    char *slab = static_cast<char *>(source.allocateSlab());
+    reinterpret_cast<internal::SlabHeader *>(slab)->owner = tid;
+    // keep the first block for the header
+    std::size_t header = (sizeof(internal::SlabHeader) + block_size - 1) /
+                         block_size * block_size;
+    c.bump = slab + header;
+    c.bump_end = slab + SlabSource::SlabSize;
+  }
+
+public:
+  SlabPool(std::size_t block_size, SlabSource &source)
+      : block_size(block_size), source(source) {
+    assert(block_size >= sizeof(internal::FreeBlock));
+    assert(block_size <= SlabSource::SlabSize / 2);
+  }
+
+  std::size_t blockSize() const { return block_size; }
+
+  void *allocate(unsigned tid = get_thread_id()) {
+    ThreadCache &c = caches[tid];
+    if (!c.local &&
+        c.remote.load(std::memory_order_relaxed)) {
+      c.local = c.remote.exchange(nullptr, std::memory_order_acquire);
+    }
+    if (internal::FreeBlock *b = c.local) {
+      c.local = b->next;
+      return b;
+    }
+    if (std::size_t(c.bump_end - c.bump) < block_size) {
+      refill(c, tid);
+    }
+    void *ret = c.bump;
+    c.bump += block_size;
+    return ret;
+  }
+
+  void deallocate(void *p, unsigned tid = get_thread_id()) {
+    internal::FreeBlock *b = static_cast<internal::FreeBlock *>(p);
+    unsigned owner = slabOf(p)->owner;
+    if (owner == tid) {
+      ThreadCache &c = caches[tid];
+      b->next = c.local;
+      c.local = b;
+      return;
+    }
+    std::atomic<internal::FreeBlock *> &remote = caches[owner].remote;
+    internal::FreeBlock *head = remote.load(std::memory_order_relaxed);
+    do {
+      b->next = head;
+    } while (!remote.compare_exchange_weak(head, b, std::memory_order_release,
+                                           std::memory_order_relaxed));
+  }
+};
+
+/**Size classes: multiples of 16 bytes up to 256, then powers of two up to
+ * MaxSize. Larger or array allocations go to operator new.
+ */
+class SlabHeap {
+public:
+  static constexpr std::size_t MaxSize = 4096;
+
+private:
+  static constexpr unsigned SmallClasses = 16;
+  static constexpr unsigned ClassNum = SmallClasses + 4;
+  SlabSource source;
+  std::atomic<SlabPool *> pools[ClassNum]{};
+
+  static unsigned sizeClass(std::size_t size) {
+    if (size <= 256) {
+      return size ? (size - 1) / 16 : 0;
+    }
+    // 512 -> 16, 1024 -> 17, 2048 -> 18, 4096 -> 19
+    return SmallClasses + (63 - __builtin_clzll(size - 1)) - 8;
+  }
+
+  static std::size_t classSize(unsigned cls) {
+    return cls < SmallClasses ? (cls + 1) * 16
+                              : std::size_t(512) << (cls - SmallClasses);
+  }
+
+public:
+  SlabHeap(bool huge_pages = false) : source(huge_pages) {}
+  SlabHeap(const SlabHeap &) = delete;
+  SlabHeap &operator=(const SlabHeap &) = delete;
+
+  ~SlabHeap() {
+    for (auto &p : pools) {
+      delete p.load(std::memory_order_relaxed);
+    }
+  }
+
+  SlabPool &pool(std::size_t size) {
+    assert(size <= MaxSize);
+    unsigned cls = sizeClass(size);
+    SlabPool *p = pools[cls].load(std::memory_order_acquire);
+    if (p) {
+      return *p;
+    }
+    SlabPool *fresh = new SlabPool(classSize(cls), source);
+    if (pools[cls].compare_exchange_strong(p, fresh,
+                                           std::memory_order_acq_rel,
+                                           std::memory_order_acquire)) {
+      return *fresh;
+    }
+    delete fresh;
+    return *p;
+  }
+
+  /**The process-wide heap. It is never destroyed, so objects with static
+   * storage duration may still free blocks during exit.
+   */
+  static SlabHeap &global() {
+    static SlabHeap *heap = new SlabHeap(true);
+    return *heap;
+  }
+};
+
+/**std::allocator compatible front end of a SlabHeap, the global one by
+ * default, e.g. HazardPointer<SlabAllocator<MSQueueNode<int>>>.
+ */
+template <typename T> class SlabAllocator {
+  template <typename U> friend class SlabAllocator;
+  static constexpr bool Pooled = sizeof(T) <= SlabHeap::MaxSize &&
+                                 alignof(T) <= 16;
+  SlabHeap *heap;
+  SlabPool *pool;
+
+public:
+  using value_type = T;
+  template <typename U> struct rebind { using other = SlabAllocator<U>; };
+
+  SlabAllocator() : SlabAllocator(SlabHeap::global()) {}
+  explicit SlabAllocator(SlabHeap &heap)
+      : heap(&heap), pool(Pooled ? &heap.pool(sizeof(T)) : nullptr) {}
+  template <typename U>
+  SlabAllocator(const SlabAllocator<U> &other)
+      : SlabAllocator(*other.heap) {}
+
+  T *allocate(std::size_t n) {
+    if (Pooled && n == 1) {
+      return static_cast<T *>(pool->allocate());
+    }
+    return static_cast<T *>(::operator new(n * sizeof(T)));
+  }
+
+  void deallocate(T *p, std::size_t n) {
+    if (Pooled && n == 1) {
+      pool->deallocate(p);
+      return;
+    }
+    ::operator delete(p);
+  }
+
+  template <typename U> bool operator==(const SlabAllocator<U> &other) const {
+    return heap == other.heap;
+  }
+  template <typename U> bool operator!=(const SlabAllocator<U> &other) const {
+    return heap != other.heap;
+  }
+};
+
+} // namespace taomp
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "taomp/utils.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+/**Contention instrumentation. Like LinearizationPoint, Stats<true> keeps
+ * per-thread counters and Stats<false> is an empty class whose members
+ * compile to nothing, so containers can inherit from Stats<CollectStats>
+ * and call this->count(...) unconditionally.
+ */
+
+namespace taomp {
+
+enum class StatKind : unsigned {
+  CasRetry,
+  HelpStep,
+  BackoffIteration,
+  SpinCycles,
+  HandoffCycles,
+  ContendedAcquire,
+  Scan,
+  Reclaimed,
+  ElisionCommit,
+  ElisionConflict,
+  ElisionCapacity,
+  ElisionLockBusy,
+  ElisionOtherAbort,
+  ElisionFallback,
+  ReclaimHandOff,
+  ReclaimBackpressure,
+  NumKinds
+};
+
+inline constexpr unsigned StatKindNum = unsigned(StatKind::NumKinds);
+
+inline const char *getStatName(StatKind kind) {
+  static const char *names[StatKindNum] = {
+      "cas_retries",       "help_steps",        "backoff_iterations",
+      "spin_cycles",       "handoff_cycles",    "contended_acquires",
+      "hp_scans",          "reclaimed_nodes",   "elision_commits",
+      "elision_conflict_aborts", "elision_capacity_aborts",
+      "elision_lock_busy_aborts", "elision_other_aborts",
+      "elision_fallbacks", "reclaim_handoffs",  "reclaim_backpressure"};
+  return names[unsigned(kind)];
+}
+
+struct StatsSnapshot {
+  std::array<uint64_t, StatKindNum> counts{};
+
+  uint64_t &operator[](StatKind kind) { return counts[unsigned(kind)]; }
+  uint64_t operator[](StatKind kind) const { return counts[unsigned(kind)]; }
+  StatsSnapshot &operator+=(const StatsSnapshot &other) {
+    for (unsigned i = 0; i < StatKindNum; ++i) {
+      counts[i] += other.counts[i];
+    }
+    return *this;
+  }
+
+  /**Prometheus text exposition format, one counter family per StatKind,
+   * labelled with name.
+   */
+  void dumpPrometheus(std::ostream &os, const std::string &name) const {
+    for (unsigned i = 0; i < StatKindNum; ++i) {
+      std::string metric =
+          std::string("taomp_") + getStatName(StatKind(i)) + "_total";
+      os << "# TYPE " << metric << " counter\n";
+      os << metric << "{name=\"" << name << "\"} " << counts[i] << '\n';
+    }
+  }
+
+  bool dumpPrometheus(const std::string &path, const std::string &name) const {
+    std::ofstream os(path);
+    if (!os) {
+      return false;
+    }
+    dumpPrometheus(os, name);
+    return bool(os);
+  }
+};
+
+template <bool Enable> class Stats;
+
+template <> class Stats<true> {
+  // single writer per thread, so relaxed load + store instead of an RMW
+  ThreadLocal<std::array<std::atomic<uint64_t>, StatKindNum>> counters;
+
+public:
+  Stats(unsigned thread_num) : counters(thread_num) {
+    for (unsigned i = 0; i < thread_num; ++i) {
+      for (auto &c : counters[i]) {
+        c.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void count(StatKind kind, uint64_t n = 1, unsigned tid = get_thread_id()) {
+    std::atomic<uint64_t> &c = counters[tid][unsigned(kind)];
+    c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+  }
+
+  TimeStamp startCycles() { return readCPUCycleCount(); }
+  void countCycles(StatKind kind, TimeStamp start,
+                   unsigned tid = get_thread_id()) {
+    count(kind, readCPUCycleCount() - start, tid);
+  }
+
+  StatsSnapshot snapshot(unsigned tid) {
+    StatsSnapshot ret;
+    for (unsigned i = 0; i < StatKindNum; ++i) {
+      ret.counts[i] = counters[tid][i].load(std::memory_order_relaxed);
+    }
+    return ret;
+  }
+
+  StatsSnapshot snapshot() {
+    StatsSnapshot ret;
+    for (unsigned tid = 0; tid < counters.size(); ++tid) {
+      ret += snapshot(tid);
+    }
+    return ret;
+  }
+};
+
+template <> class Stats<false> {
+public:
+  Stats(unsigned) {}
+  void count(StatKind, uint64_t = 1, unsigned = 0) {}
+  TimeStamp startCycles() { return 0; }
+  void countCycles(StatKind, TimeStamp, unsigned = 0) {}
+  StatsSnapshot snapshot(unsigned) { return {}; }
+  StatsSnapshot snapshot() { return {}; }
+};
+
+/**Wraps a backoff policy (NoBackoff, ExpBackoff, ...) and counts how often
+ * and for how many cycles a lock backed off, e.g.
+ *   StatsBackoff<ExpBackoff, true> b(stats, ExpBackoff(100ns, 10us));
+ *   ttas_lock.lock(b);
+ */
+template <typename Backoff, bool Enable> class StatsBackoff {
+  Stats<Enable> &stats;
+  Backoff backoffer;
+
+public:
+  StatsBackoff(Stats<Enable> &stats, const Backoff &backoffer = Backoff())
+      : stats(stats), backoffer(backoffer) {}
+  void backoff() const {
+    TimeStamp start = stats.startCycles();
+    backoffer.backoff();
+    stats.count(StatKind::BackoffIteration);
+    stats.countCycles(StatKind::SpinCycles, start);
+  }
+};
+
+/**Instruments any Lockable: an acquisition that fails try_lock() is counted
+ * as contended, the cycles it then spends in lock() as spin cycles, and the
+ * cycles between the previous owner's unlock() and the acquisition as the
+ * hand-off latency.
+ */
+template <typename Lock, bool Enable = true>
+class StatsLock : public Stats<Enable> {
+  Lock lock_;
+  TimeStamp released = 0;
+
+public:
+  StatsLock(unsigned thread_num) : Stats<Enable>(thread_num) {}
+
+  void lock() {
+    if constexpr (Enable) {
+      if (lock_.try_lock()) {
+        return;
+      }
+      TimeStamp start = readCPUCycleCount();
+      lock_.lock();
+      TimeStamp now = readCPUCycleCount();
+      this->count(StatKind::ContendedAcquire);
+      this->count(StatKind::SpinCycles, now - start);
+      // released is written under the lock, so reading it here is ordered
+      if (released > start) {
+        this->count(StatKind::HandoffCycles, now - released);
+      }
+    } else {
+      lock_.lock();
+    }
+  }
+
+  bool try_lock() { return lock_.try_lock(); }
+
+  void unlock() {
+    if constexpr (Enable) {
+      released = readCPUCycleCount();
+    }
+    lock_.unlock();
+  }
+};
+
+} // namespace taomp
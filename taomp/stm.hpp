@@ -0,0 +1,299 @@
+#pragma once
+
+#include "taomp/atomic.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**Word-based software transactional memory after Dice, Shalev, Shavit.
+ * Transactional Locking II. DISC 2006.
+ * A TVar<T> is one word. Every word hashes to a stripe of a global table of
+ * versioned locks: an even lock word is the version (global clock value) of
+ * the last commit to the stripe, a locked one is the committer's descriptor
+ * with the low bit set.
+ * A transaction samples the clock as its read version rv. A read checks the
+ * stripe before and after loading the word and aborts if it was locked or
+ * newer than rv, so every transaction, even one which will abort, sees a
+ * consistent snapshot. Writes are buffered. Commit locks the stripes of the
+ * write set, aborting if one is taken, takes a write version from the clock,
+ * revalidates the read set unless no other commit happened since rv, writes
+ * back and releases the stripes with the write version. Read-only
+ * transactions commit without any store.
+ * atomically(f) runs f until it commits, calling a backoff policy from
+ * lock.hpp between attempts; an abort unwinds f with an exception, so f must
+ * not catch everything. Nested calls join the outer transaction.
+ * Memory reachable by a running transaction must stay type-stable: a node
+ * removed in a transaction can be reused as another node, but not freed.
+ */
+
+namespace taomp {
+
+struct TxStats {
+  uint64_t commits = 0;
+  uint64_t aborts = 0;
+};
+
+namespace internal {
+struct TxAbort {};
+
+class TxLockTable {
+  static constexpr unsigned StripeBits = 20;
+
+  alignas(CacheLineSize) Atomic<uint64_t> clock{0};
+  alignas(CacheLineSize) Atomic<uint64_t> stripes[1u << StripeBits]{};
+
+public:
+  static TxLockTable &global() {
+    static TxLockTable table;
+    return table;
+  }
+
+  Atomic<uint64_t> &stripe(const void *word) {
+    return stripes[(uintptr_t(word) >> 3) & Mask<uintptr_t>(StripeBits)];
+  }
+
+  uint64_t now() { return clock.load(std::memory_order_acquire); }
+  // even versions, the low bit of a lock word means locked
+  uint64_t tick() {
+    return clock.fetch_add(2, std::memory_order_acq_rel) + 2;
+  }
+};
+
+class TxDescriptor {
+  struct ReadEntry {
+    Atomic<uint64_t> *lock;
+  };
+  struct WriteEntry {
+    Atomic<uint64_t> *word;
+    uint64_t value;
+    Atomic<uint64_t> *lock;
+  };
+  struct LockEntry {
+    Atomic<uint64_t> *lock;
+    uint64_t version;
+  };
+
+  TxLockTable &table = TxLockTable::global();
+  uint64_t rv = 0;
+  std::vector<ReadEntry> reads;
+  std::vector<WriteEntry> writes;
+  std::vector<LockEntry> locked;
+  // one bit per word address hash, to skip the write set search
+  uint64_t write_filter = 0;
+
+  uint64_t tag() const { return uintptr_t(this) | 1; }
+
+  static uint64_t filterBit(const void *word) {
+    return uint64_t(1) << ((uintptr_t(word) >> 3) & 63);
+  }
+
+  void releaseLocks(bool committed, uint64_t wv) {
+    for (const LockEntry &l : locked) {
+      l.lock->store(committed ? wv : l.version, std::memory_order_release);
+    }
+    locked.clear();
+  }
+
+  bool validate() {
+    for (const ReadEntry &r : reads) {
+      uint64_t l = r.lock->load(std::memory_order_acquire);
+      if (l == tag()) {
+        // the version before this commit locked the stripe
+        for (const LockEntry &e : locked) {
+          if (e.lock == r.lock) {
+            l = e.version;
+            break;
+          }
+        }
+      }
+      if ((l & 1) || l > rv) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+public:
+  bool active = false;
+  TxStats stats;
+
+  static TxDescriptor &current() {
+    static thread_local TxDescriptor descriptor;
+    return descriptor;
+  }
+
+  void begin() {
+    active = true;
+    rv = table.now();
+  }
+
+  void end() {
+    active = false;
+    reads.clear();
+    writes.clear();
+    write_filter = 0;
+  }
+
+  uint64_t read(Atomic<uint64_t> &word) {
+    if (write_filter & filterBit(&word)) {
+      for (auto it = writes.rbegin(); it != writes.rend(); ++it) {
+        if (it->word == &word) {
+          return it->value;
+        }
+      }
+    }
+    Atomic<uint64_t> &lock = table.stripe(&word);
+    uint64_t pre = lock.load(std::memory_order_acquire);
+    uint64_t value = word.load(std::memory_order_acquire);
+    uint64_t post = lock.load(std::memory_order_relaxed);
+    if ((pre & 1) || pre != post || pre > rv) {
+      throw TxAbort();
+    }
+    reads.push_back({&lock});
+    return value;
+  }
+
+  void write(Atomic<uint64_t> &word, uint64_t value) {
+    uint64_t bit = filterBit(&word);
+    if (write_filter & bit) {
+      for (WriteEntry &w : writes) {
+        if (w.word == &word) {
+          w.value = value;
+          return;
+        }
+      }
+    }
+    write_filter |= bit;
+    writes.push_back({&word, value, &table.stripe(&word)});
+  }
+
+  bool commit() {
+    if (writes.empty()) {
+      return true;
+    }
+    for (const WriteEntry &w : writes) {
+      uint64_t l = w.lock->load(std::memory_order_relaxed);
+      if (l == tag()) {
+        continue;
+      }
+      if ((l & 1) || !w.lock->compare_exchange_strong(
+                         l, tag(), std::memory_order_acquire)) {
+        releaseLocks(false, 0);
+        return false;
+      }
+      locked.push_back({w.lock, l});
+    }
+    uint64_t wv = table.tick();
+    if (wv != rv + 2 && !validate()) {
+      releaseLocks(false, 0);
+      return false;
+    }
+    for (const WriteEntry &w : writes) {
+      // release pairs with the word load of read(), which then sees the lock
+      w.word->store(w.value, std::memory_order_release);
+    }
+    releaseLocks(true, wv);
+    return true;
+  }
+};
+
+template <typename T> uint64_t toWord(const T &v) {
+  uint64_t w = 0;
+  std::memcpy(&w, &v, sizeof(T));
+  return w;
+}
+
+template <typename T> T fromWord(uint64_t w) {
+  T v;
+  std::memcpy(&v, &w, sizeof(T));
+  return v;
+}
+} // namespace internal
+
+inline const ExpBackoff &defaultTxBackoff() {
+  static const ExpBackoff backoff(std::chrono::nanoseconds(100),
+                                  std::chrono::microseconds(100));
+  return backoff;
+}
+
+/**Runs f() as a transaction until it commits, returns what f returned.
+ */
+template <typename F, typename Backoff>
+auto atomically(F &&f, const Backoff &backoff) -> decltype(f()) {
+  internal::TxDescriptor &tx = internal::TxDescriptor::current();
+  if (tx.active) {
+    return f();
+  }
+  Backoff local = backoff;
+  while (true) {
+    tx.begin();
+    try {
+      if constexpr (std::is_void<decltype(f())>::value) {
+        f();
+        if (tx.commit()) {
+          tx.end();
+          ++tx.stats.commits;
+          return;
+        }
+      } else {
+        auto ret = f();
+        if (tx.commit()) {
+          tx.end();
+          ++tx.stats.commits;
+          return ret;
+        }
+      }
+    } catch (const internal::TxAbort &) {
+    } catch (...) {
+      // f saw a consistent snapshot, so the exception is its own
+      tx.end();
+      throw;
+    }
+    tx.end();
+    ++tx.stats.aborts;
+    local.backoff();
+  }
+}
+
+template <typename F> auto atomically(F &&f) -> decltype(f()) {
+  return atomically(std::forward<F>(f), defaultTxBackoff());
+}
+
+/**Commits and aborts of the calling thread so far.
+ */
+inline TxStats txStats() { return internal::TxDescriptor::current().stats; }
+
+/**A transactional variable of a trivially copyable T of at most 8 bytes.
+ * load() and store() outside of atomically() are transactions of their own.
+ */
+template <typename T> class TVar {
+  static_assert(std::is_trivially_copyable<T>::value && sizeof(T) <= 8,
+                "TVar holds a trivially copyable word");
+  Atomic<uint64_t> word;
+
+public:
+  TVar(const T &v = T()) : word(internal::toWord(v)) {}
+  TVar(const TVar &) = delete;
+  TVar &operator=(const TVar &) = delete;
+
+  T load() {
+    return atomically([this] {
+      return internal::fromWord<T>(
+          internal::TxDescriptor::current().read(word));
+    });
+  }
+
+  void store(const T &v) {
+    atomically([&] {
+      internal::TxDescriptor::current().write(word, internal::toWord(v));
+    });
+  }
+};
+
+} // namespace taomp
@@ -0,0 +1,203 @@
+#pragma once
+
+#include "taomp/topology.hpp"
+#include "taomp/utils.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
+
+/**Dynamic thread registration. Unlike init_thread(), which hands out ids with
+ * an ever increasing counter, ThreadRegistry recycles the ids of threads which
+ * have left, so an id is always smaller than the peak number of *live*
+ * threads. Structures sized by thread_num (HazardPointer, MSQueue,
+ * ThreadLocal) can then be sized by live threads even in thread pools whose
+ * threads come and go.
+ */
+
+namespace taomp {
+
+/**Per-thread storage which grows on demand in geometrically sized chunks.
+ * Looking up a slot whose chunk already exists is two loads and no lock;
+ * the first access to a new chunk allocates and publishes it with a CAS.
+ */
+template <typename T, std::size_t Alignment = CacheLineSize>
+class DynamicThreadLocal {
+  struct alignas(Alignment) ContainerT {
+    T value;
+  };
+  using Index = internal::SegmentIndex<3>;
+  std::function<void(T *)> init;
+  std::atomic<ContainerT *> chunks[Index::MaxSegments]{};
+
+  ContainerT *chunk(unsigned seg) {
+    ContainerT *c = chunks[seg].load(std::memory_order_acquire);
+    if (c) {
+      return c;
+    }
+    std::size_t n = Index::segmentSize(seg);
+    ContainerT *fresh = taomp::aligned_alloc<ContainerT, Alignment>(n);
+    for (std::size_t i = 0; i < n; ++i) {
+      init(&fresh[i].value);
+    }
+    if (chunks[seg].compare_exchange_strong(c, fresh,
+                                            std::memory_order_acq_rel,
+                                            std::memory_order_acquire)) {
+      return fresh;
+    }
+    destroy(fresh, n);
+    return c;
+  }
+
+  static void destroy(ContainerT *c, std::size_t n) {
+    for (std::size_t i = 0; i < n; ++i) {
+      c[i].value.~T();
+    }
+    free(c);
+  }
+
+public:
+  DynamicThreadLocal() : init([](T *p) { new (p) T(); }) {}
+  template <typename... Args>
+  explicit DynamicThreadLocal(const Args &... args)
+      : init([=](T *p) { new (p) T(args...); }) {}
+  DynamicThreadLocal(const DynamicThreadLocal &) = delete;
+  DynamicThreadLocal &operator=(const DynamicThreadLocal &) = delete;
+
+  ~DynamicThreadLocal() {
+    for (unsigned seg = 0; seg < Index::MaxSegments; ++seg) {
+      if (ContainerT *c = chunks[seg].load(std::memory_order_relaxed)) {
+        destroy(c, Index::segmentSize(seg));
+      }
+    }
+  }
+
+  T &get(unsigned tid = get_thread_id()) {
+    unsigned seg = Index::segment(tid);
+    return chunk(seg)[Index::offset(tid, seg)].value;
+  }
+  T &operator[](unsigned tid) { return get(tid); }
+
+  /**Visit every slot allocated so far, including slots of threads which never
+   * touched their value.
+   */
+  template <typename F> void forEach(F &&f) {
+    for (unsigned seg = 0; seg < Index::MaxSegments; ++seg) {
+      ContainerT *c = chunks[seg].load(std::memory_order_acquire);
+      if (!c) {
+        continue;
+      }
+      std::size_t n = Index::segmentSize(seg);
+      for (std::size_t i = 0; i < n; ++i) {
+        f(c[i].value);
+      }
+    }
+  }
+};
+
+/**Allocates dense thread ids. Released ids go to a lock-free LIFO free list
+ * (a Treiber stack threaded through an id-indexed array), whose head carries
+ * a 32-bit tag against ABA.
+ */
+class ThreadRegistry {
+  static constexpr unsigned NoId = ~0u;
+  // low 32 bits: id + 1 of the top of the free list (0 = empty), high: tag
+  std::atomic<uint64_t> free_head{0};
+  std::atomic<unsigned> high_water{0};
+  std::atomic<unsigned> live{0};
+  DynamicThreadLocal<std::atomic<unsigned>, alignof(std::atomic<unsigned>)>
+      free_next;
+
+  static uint64_t pack(uint64_t tag, unsigned id) {
+    return (tag << 32) | (uint64_t(id) + 1);
+  }
+
+  unsigned popFree() {
+    uint64_t head = free_head.load(std::memory_order_acquire);
+    while (true) {
+      unsigned top = unsigned(head);
+      if (!top) {
+        return NoId;
+      }
+      unsigned id = top - 1;
+      unsigned next = free_next[id].load(std::memory_order_relaxed);
+      uint64_t new_head = ((head >> 32) + 1) << 32 | next;
+      if (free_head.compare_exchange_weak(head, new_head,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire)) {
+        return id;
+      }
+    }
+  }
+
+  void pushFree(unsigned id) {
+    uint64_t head = free_head.load(std::memory_order_relaxed);
+    while (true) {
+      free_next[id].store(unsigned(head), std::memory_order_relaxed);
+      if (free_head.compare_exchange_weak(head, pack((head >> 32) + 1, id),
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_relaxed)) {
+        return;
+      }
+    }
+  }
+
+public:
+  ThreadRegistry() : free_next(0u) {}
+  ThreadRegistry(const ThreadRegistry &) = delete;
+  ThreadRegistry &operator=(const ThreadRegistry &) = delete;
+
+  static ThreadRegistry &global() {
+    static ThreadRegistry registry;
+    return registry;
+  }
+
+  unsigned acquire() {
+    live.fetch_add(1, std::memory_order_relaxed);
+    unsigned id = popFree();
+    if (id == NoId) {
+      id = high_water.fetch_add(1, std::memory_order_relaxed);
+    }
+    return id;
+  }
+
+  void release(unsigned id) {
+    pushFree(id);
+    live.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  // every id handed out so far is smaller than capacity()
+  unsigned capacity() const {
+    return high_water.load(std::memory_order_relaxed);
+  }
+
+  unsigned liveThreads() const { return live.load(std::memory_order_relaxed); }
+};
+
+/**RAII registration of the calling thread: takes an id from the registry,
+ * makes it the thread's get_thread_id(), and gives it back on destruction.
+ * With pin, the thread is also pinned to the cpu of its id under
+ * ThreadPlacement::global(), so a recycled id keeps its cpu and node.
+ */
+class ThreadRegistration {
+  ThreadRegistry &registry;
+  unsigned tid;
+
+public:
+  explicit ThreadRegistration(
+      ThreadRegistry &registry = ThreadRegistry::global(), bool pin = false)
+      : registry(registry), tid(registry.acquire()) {
+    if (pin) {
+      init_pinned_thread(tid);
+    } else {
+      init_thread(tid);
+    }
+  }
+  ~ThreadRegistration() { registry.release(tid); }
+  ThreadRegistration(const ThreadRegistration &) = delete;
+  ThreadRegistration &operator=(const ThreadRegistration &) = delete;
+
+  unsigned id() const { return tid; }
+};
+
+} // namespace taomp
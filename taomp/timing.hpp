@@ -0,0 +1,160 @@
+#pragma once
+
+#include "taomp/utils.hpp"
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#if defined(__x86_64__) || defined(__amd64__)
+#include <cpuid.h>
+#endif
+
+/**Cycle counter calibration. readCPUCycleCount() ticks are converted to
+ * nanoseconds with a ticks/ns ratio measured once against steady_clock, the
+ * first time it is needed (about 5ms). now_ns() then costs one tick read and
+ * a multiply, and stays within the calibration error of steady_clock.
+ * The conversion is only sound with an invariant TSC, i.e. one ticking at a
+ * constant rate in every P-/C-state; without it, now_ns() falls back to
+ * steady_clock, see reportTiming(). The aarch64 generic timer always runs at
+ * the fixed rate in CNTFRQ_EL0, so it needs no calibration.
+ */
+
+namespace taomp {
+
+/**readCPUCycleCount() is not ordered against the surrounding instructions.
+ * For measuring a region, read with readCPUCycleCountBegin() before it, which
+ * waits for earlier instructions to finish, and readCPUCycleCountEnd() after
+ * it, which waits for the region to finish and keeps later instructions out.
+ */
+inline TimeStamp readCPUCycleCountBegin() {
+#if defined(__aarch64__)
+  TimeStamp virtual_timer_value;
+  asm volatile("isb; mrs %0, cntvct_el0" : "=r"(virtual_timer_value)::"memory");
+  return virtual_timer_value;
+#elif defined(__x86_64__) || defined(__amd64__)
+  TimeStamp low, high;
+  __asm__ volatile("lfence; rdtsc" : "=a"(low), "=d"(high)::"memory");
+  return (high << 32) | low;
+#else
+  return readCPUCycleCount();
+#endif
+}
+
+inline TimeStamp readCPUCycleCountEnd() {
+#if defined(__aarch64__)
+  TimeStamp virtual_timer_value;
+  asm volatile("isb; mrs %0, cntvct_el0; isb"
+               : "=r"(virtual_timer_value)::"memory");
+  return virtual_timer_value;
+#elif defined(__x86_64__) || defined(__amd64__)
+  TimeStamp low, high;
+  __asm__ volatile("rdtscp; lfence" : "=a"(low), "=d"(high)::"ecx", "memory");
+  return (high << 32) | low;
+#else
+  return readCPUCycleCount();
+#endif
+}
+
+inline bool invariantTSC() {
+#if defined(__aarch64__)
+  return true;
+#elif defined(__x86_64__) || defined(__amd64__)
+  // CPUID.80000007H:EDX[8]
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) {
+    return false;
+  }
+  return edx & (1u << 8);
+#else
+  return false;
+#endif
+}
+
+struct TickCalibration {
+  bool invariant;
+  double ticks_per_ns;
+  // ns = base_ns + ((ticks - base_ticks) * mult) >> Shift
+  static constexpr unsigned Shift = 32;
+  uint64_t mult;
+  TimeStamp base_ticks;
+  int64_t base_ns;
+};
+
+namespace internal {
+inline int64_t steadyNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+// a steady_clock reading and the tick count at (about) the same instant
+inline void sampleClocks(TimeStamp &ticks, int64_t &ns) {
+  TimeStamp t0 = readCPUCycleCountBegin();
+  ns = steadyNs();
+  TimeStamp t1 = readCPUCycleCountEnd();
+  ticks = t0 + (t1 - t0) / 2;
+}
+
+inline TickCalibration calibrate() {
+  TickCalibration c;
+  c.invariant = invariantTSC();
+  sampleClocks(c.base_ticks, c.base_ns);
+#if defined(__aarch64__)
+  uint64_t frequency;
+  asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+  c.ticks_per_ns = double(frequency) / 1e9;
+#else
+  TimeStamp ticks;
+  int64_t ns;
+  do {
+    sampleClocks(ticks, ns);
+  } while (ns - c.base_ns < 5000000);
+  c.ticks_per_ns = double(ticks - c.base_ticks) / double(ns - c.base_ns);
+  if (!(c.ticks_per_ns > 0)) {
+    c.invariant = false;
+    c.ticks_per_ns = 1;
+  }
+#endif
+  c.mult = uint64_t(double(uint64_t(1) << TickCalibration::Shift) /
+                    c.ticks_per_ns);
+  return c;
+}
+} // namespace internal
+
+inline const TickCalibration &tickCalibration() {
+  static const TickCalibration calibration = internal::calibrate();
+  return calibration;
+}
+
+inline uint64_t ticksToNs(TimeStamp ticks) {
+  return uint64_t((unsigned __int128)ticks * tickCalibration().mult >>
+                  TickCalibration::Shift);
+}
+
+inline TimeStamp nsToTicks(uint64_t ns) {
+  return TimeStamp(double(ns) * tickCalibration().ticks_per_ns);
+}
+
+/**Nanoseconds on the steady_clock time line.
+ */
+inline int64_t now_ns() {
+  const TickCalibration &c = tickCalibration();
+  if (!c.invariant) {
+    return internal::steadyNs();
+  }
+  // the counter of this cpu may be slightly behind the calibrating one's
+  int64_t delta = int64_t(readCPUCycleCount() - c.base_ticks);
+  return delta >= 0 ? c.base_ns + int64_t(ticksToNs(delta))
+                    : c.base_ns - int64_t(ticksToNs(-delta));
+}
+
+inline void reportTiming(std::ostream &os) {
+  const TickCalibration &c = tickCalibration();
+  os << "tsc: " << (c.invariant ? "invariant" : "NOT invariant")
+     << ", ticks/ns: " << c.ticks_per_ns;
+  if (!c.invariant) {
+    os << ", now_ns() uses steady_clock";
+  }
+  os << '\n';
+}
+
+} // namespace taomp
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "taomp/utils.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <fstream>
+#include <map>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <tuple>
+#include <unistd.h>
+#include <utility>
+#include <vector>
+
+/**CPU topology from sysfs (/sys/devices/system/cpu), for placing threads:
+ * the SMT siblings, cores, packages and NUMA nodes of the online cpus, the
+ * cpus sharing each L2 and L3, and the coherency line size.
+ * ThreadPlacement maps the ids of get_thread_id() to cpus, so that a
+ * benchmark pinning its threads and a NUMA-aware structure asking for the
+ * node of a thread agree on where thread tid runs. The benchmarks pin with
+ * init_pinned_thread(), and ThreadRegistration can pin the ids it hands out,
+ * both under ThreadPlacement::global().
+ * CacheLineSize in utils.hpp is a compile time guess; cacheLineSize() is
+ * what the machine reports.
+ */
+
+namespace taomp {
+
+struct CpuInfo {
+  unsigned cpu;
+  // dense indices, numbered in the order of their first cpu
+  unsigned core;
+  unsigned package;
+  unsigned node;
+  unsigned l2;
+  unsigned l3;
+  // position among the SMT siblings of its core
+  unsigned smt;
+};
+
+namespace internal {
+inline bool readLine(const std::string &path, std::string &line) {
+  std::ifstream is(path);
+  return bool(std::getline(is, line));
+}
+
+inline long readLong(const std::string &path, long fallback) {
+  std::string line;
+  if (!readLine(path, line) || line.empty()) {
+    return fallback;
+  }
+  char *end;
+  long v = std::strtol(line.c_str(), &end, 10);
+  return end == line.c_str() ? fallback : v;
+}
+
+/**Parses a cpu list such as "0-3,8,10-11".
+ */
+inline std::vector<unsigned> parseCpuList(const std::string &list) {
+  std::vector<unsigned> ret;
+  std::size_t pos = 0;
+  while (pos < list.size()) {
+    std::size_t comma = list.find(',', pos);
+    if (comma == std::string::npos) {
+      comma = list.size();
+    }
+    std::string range = list.substr(pos, comma - pos);
+    std::size_t dash = range.find('-');
+    if (!range.empty() && range[0] >= '0' && range[0] <= '9') {
+      unsigned first = std::stoul(range);
+      unsigned last =
+          dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+      for (unsigned c = first; c <= last; ++c) {
+        ret.push_back(c);
+      }
+    }
+    pos = comma + 1;
+  }
+  return ret;
+}
+
+inline std::vector<unsigned> readCpuList(const std::string &path) {
+  std::string line;
+  if (!readLine(path, line)) {
+    return {};
+  }
+  return parseCpuList(line);
+}
+
+/**Hands out dense ids in order of first appearance.
+ */
+template <typename Key> class DenseIds {
+  std::map<Key, unsigned> ids;
+
+public:
+  unsigned get(const Key &key) {
+    return ids.emplace(key, unsigned(ids.size())).first->second;
+  }
+  unsigned size() const { return ids.size(); }
+};
+} // namespace internal
+
+class Topology {
+  std::vector<CpuInfo> cpus;
+  unsigned core_num = 0, package_num = 0, node_num = 0, l2_num = 0,
+           l3_num = 0;
+  std::size_t cache_line_size = 0;
+
+  static unsigned nodeOf(const std::string &cpu_dir) {
+    // cpuN/nodeK links exist with CONFIG_NUMA
+    unsigned node = 0;
+    if (DIR *dir = opendir(cpu_dir.c_str())) {
+      while (dirent *entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+            name.find_first_not_of("0123456789", 4) == std::string::npos) {
+          node = std::stoul(name.substr(4));
+          break;
+        }
+      }
+      closedir(dir);
+    }
+    return node;
+  }
+
+public:
+  /**Reads the tree under root, which is /sys/devices/system/cpu on a live
+   * system. Only the online cpus, filtered by allowed unless it is empty,
+   * are kept. Missing files count as a single core, package, node or cache.
+   */
+  static Topology parse(const std::string &root,
+                        const std::vector<unsigned> &allowed = {}) {
+    Topology ret;
+    std::vector<unsigned> online = internal::readCpuList(root + "/online");
+    if (online.empty()) {
+      online.push_back(0);
+    }
+    internal::DenseIds<std::pair<long, long>> cores;
+    internal::DenseIds<long> packages, nodes, l2s, l3s;
+    std::map<unsigned, unsigned> smt_count;
+    for (unsigned cpu : online) {
+      if (!allowed.empty() &&
+          std::find(allowed.begin(), allowed.end(), cpu) == allowed.end()) {
+        continue;
+      }
+      std::string dir = root + "/cpu" + std::to_string(cpu);
+      long package =
+          internal::readLong(dir + "/topology/physical_package_id", 0);
+      long core_id = internal::readLong(dir + "/topology/core_id", cpu);
+      CpuInfo info;
+      info.cpu = cpu;
+      info.package = packages.get(package);
+      info.core = cores.get({package, core_id});
+      info.node = nodes.get(nodeOf(dir));
+      info.smt = smt_count[info.core]++;
+      // a cache is named by the first cpu sharing it
+      long l2 = cpu, l3 = cpu;
+      for (unsigned index = 0;; ++index) {
+        std::string cache = dir + "/cache/index" + std::to_string(index);
+        long level = internal::readLong(cache + "/level", -1);
+        if (level < 0) {
+          break;
+        }
+        std::vector<unsigned> shared =
+            internal::readCpuList(cache + "/shared_cpu_list");
+        long first = shared.empty() ? long(cpu) : long(shared.front());
+        if (level == 1) {
+          long line = internal::readLong(cache + "/coherency_line_size", 0);
+          ret.cache_line_size =
+              std::max(ret.cache_line_size, std::size_t(std::max(line, 0l)));
+        } else if (level == 2) {
+          l2 = first;
+        } else if (level == 3) {
+          l3 = first;
+        }
+      }
+      info.l2 = l2s.get(l2);
+      info.l3 = l3s.get(l3);
+      ret.cpus.push_back(info);
+    }
+    ret.core_num = cores.size();
+    ret.package_num = packages.size();
+    ret.node_num = nodes.size();
+    ret.l2_num = l2s.size();
+    ret.l3_num = l3s.size();
+    return ret;
+  }
+
+  /**The topology of the cpus this process may run on.
+   */
+  static Topology detect() {
+    std::vector<unsigned> allowed;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (!sched_getaffinity(0, sizeof(set), &set)) {
+      for (unsigned c = 0; c < CPU_SETSIZE; ++c) {
+        if (CPU_ISSET(c, &set)) {
+          allowed.push_back(c);
+        }
+      }
+    }
+    Topology ret = parse("/sys/devices/system/cpu", allowed);
+    if (!ret.cache_line_size) {
+      long line = sysconf(_SC_LEVEL1_DCACHE_LINESIZE);
+      ret.cache_line_size = line > 0 ? line : 64;
+    }
+    return ret;
+  }
+
+  /**Parsed once per process. Warns on stderr if the cache line is larger
+   * than the CacheLineSize the containers are padded to.
+   */
+  static const Topology &get() {
+    static const Topology topology = [] {
+      Topology ret = detect();
+      if (ret.cache_line_size > CacheLineSize) {
+        fprintf(stderr,
+                "taomp: the cache line is %zu bytes, but CacheLineSize is "
+                "%zu; build with -DTAOMP_CACHE_LINE_SIZE=%zu\n",
+                ret.cache_line_size, CacheLineSize, ret.cache_line_size);
+      }
+      return ret;
+    }();
+    return topology;
+  }
+
+  const std::vector<CpuInfo> &getCpus() const { return cpus; }
+  unsigned cpuNum() const { return cpus.size(); }
+  unsigned coreNum() const { return core_num; }
+  unsigned packageNum() const { return package_num; }
+  unsigned nodeNum() const { return node_num; }
+  unsigned l2Num() const { return l2_num; }
+  unsigned l3Num() const { return l3_num; }
+  /**0 if the tree did not say.
+   */
+  std::size_t cacheLineSize() const { return cache_line_size; }
+};
+
+enum class Placement {
+  // fill the SMT siblings of a core, the cores of a node, then the next node
+  Compact,
+  // one thread per core round robin over the nodes, SMT siblings last
+  Scatter
+};
+
+/**Thread id to cpu mapping. Ids beyond the number of cpus wrap around.
+ */
+class ThreadPlacement {
+  std::vector<CpuInfo> order;
+
+public:
+  ThreadPlacement(const Topology &topology = Topology::get(),
+                  Placement placement = Placement::Scatter)
+      : order(topology.getCpus()) {
+    if (placement == Placement::Compact) {
+      std::stable_sort(order.begin(), order.end(),
+                       [](const CpuInfo &a, const CpuInfo &b) {
+                         return std::tie(a.node, a.core, a.smt) <
+                                std::tie(b.node, b.core, b.smt);
+                       });
+    } else {
+      // the rank of a core within its node
+      std::map<std::pair<unsigned, unsigned>, unsigned> core_rank;
+      std::map<unsigned, unsigned> cores_in_node;
+      for (const CpuInfo &info : order) {
+        if (!core_rank.count({info.node, info.core})) {
+          core_rank[{info.node, info.core}] = cores_in_node[info.node]++;
+        }
+      }
+      std::stable_sort(order.begin(), order.end(),
+                       [&](const CpuInfo &a, const CpuInfo &b) {
+                         unsigned ra = core_rank[{a.node, a.core}];
+                         unsigned rb = core_rank[{b.node, b.core}];
+                         return std::tie(a.smt, ra, a.node) <
+                                std::tie(b.smt, rb, b.node);
+                       });
+    }
+  }
+
+  const CpuInfo &of(unsigned tid = get_thread_id()) const {
+    return order[tid % order.size()];
+  }
+  unsigned cpuOf(unsigned tid = get_thread_id()) const { return of(tid).cpu; }
+  unsigned coreOf(unsigned tid = get_thread_id()) const {
+    return of(tid).core;
+  }
+  unsigned nodeOf(unsigned tid = get_thread_id()) const {
+    return of(tid).node;
+  }
+
+  /**Scatter over the cpus of this process, shared by init_pinned_thread()
+   * and ThreadRegistration.
+   */
+  static const ThreadPlacement &global() {
+    static const ThreadPlacement placement;
+    return placement;
+  }
+
+  /**Pins the calling thread to the cpu of tid, false if the kernel refused.
+   */
+  bool pin(unsigned tid = get_thread_id()) const {
+    return pinThread(cpuOf(tid));
+  }
+
+  static bool pinThread(unsigned cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+};
+
+/**init_thread(tid) and pin the calling thread to the cpu of tid, false if the
+ * kernel refused to pin.
+ */
+inline bool init_pinned_thread(unsigned tid) {
+  init_thread(tid);
+  return ThreadPlacement::global().pin(tid);
+}
+
+} // namespace taomp
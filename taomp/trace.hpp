@@ -0,0 +1,242 @@
+#pragma once
+
+#include "taomp/timing.hpp"
+#include "taomp/utils.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/**Event tracing into per-thread ring buffers, enabled by defining TAOMP_TRACE.
+ * Otherwise trace() is an empty inline function and the buffers do not exist.
+ * Each thread only writes its own ring (indexed by get_thread_id()), a fixed
+ * size array of TraceEvent in static storage: recording is a tick read, four
+ * plain stores and a release store of the head, without locks or allocation.
+ * When a ring is full the oldest events are overwritten.
+ * dumpTrace() writes the rings in a binary format and writeChromeTrace()
+ * converts them to Chrome trace / Perfetto JSON, in process or offline with
+ * tools/trace_to_json.cpp.
+ * TAOMP_TRACE_THREADS (128) and TAOMP_TRACE_CAPACITY (4096 events, a power of
+ * two) size the buffers.
+ * Everything here which depends on TAOMP_TRACE lives in the inline namespace
+ * trace_on or trace_off, so translation units built with and without it
+ * name distinct functions and the linker cannot merge a recording trace()
+ * with an empty one. The instrumented locks and queues are ordinary inline
+ * code, though: define TAOMP_TRACE for the whole program (and with the same
+ * buffer sizes) to trace them.
+ */
+
+#ifndef TAOMP_TRACE_THREADS
+#define TAOMP_TRACE_THREADS 128
+#endif
+#ifndef TAOMP_TRACE_CAPACITY
+#define TAOMP_TRACE_CAPACITY 4096
+#endif
+#ifdef TAOMP_TRACE
+#define TAOMP_TRACE_NAMESPACE trace_on
+#else
+#define TAOMP_TRACE_NAMESPACE trace_off
+#endif
+
+namespace taomp {
+
+enum class TraceKind : uint32_t {
+  LockAcquire,
+  LockRelease,
+  CasFail,
+  ScanBegin,
+  ScanEnd,
+  EnqueueBegin,
+  EnqueueEnd,
+  DequeueBegin,
+  DequeueEnd,
+  NumKinds
+};
+
+struct TraceEvent {
+  TimeStamp time;
+  uint64_t object;
+  uint64_t arg;
+  TraceKind kind;
+  uint32_t tid;
+};
+
+inline namespace TAOMP_TRACE_NAMESPACE {
+#ifdef TAOMP_TRACE
+inline constexpr bool TraceEnabled = true;
+#else
+inline constexpr bool TraceEnabled = false;
+#endif
+
+inline constexpr unsigned TraceThreadNum = TAOMP_TRACE_THREADS;
+inline constexpr unsigned TraceCapacity = TAOMP_TRACE_CAPACITY;
+static_assert(!(TraceCapacity & (TraceCapacity - 1)),
+              "TAOMP_TRACE_CAPACITY must be a power of two");
+} // namespace TAOMP_TRACE_NAMESPACE
+
+namespace internal {
+inline namespace TAOMP_TRACE_NAMESPACE {
+struct TraceRing {
+  alignas(CacheLineSize) std::atomic<uint64_t> head;
+  TraceEvent events[TraceCapacity];
+};
+
+#ifdef TAOMP_TRACE
+inline TraceRing trace_rings[TraceThreadNum];
+#endif
+} // namespace TAOMP_TRACE_NAMESPACE
+} // namespace internal
+
+inline namespace TAOMP_TRACE_NAMESPACE {
+inline void trace(TraceKind kind, const void *object, uint64_t arg = 0) {
+#ifdef TAOMP_TRACE
+  unsigned tid = get_thread_id();
+  assert(tid < TraceThreadNum);
+  internal::TraceRing &ring = internal::trace_rings[tid];
+  uint64_t head = ring.head.load(std::memory_order_relaxed);
+  TraceEvent &e = ring.events[head & (TraceCapacity - 1)];
+  e.time = readCPUCycleCount();
+  e.object = reinterpret_cast<uintptr_t>(object);
+  e.arg = arg;
+  e.kind = kind;
+  e.tid = tid;
+  ring.head.store(head + 1, std::memory_order_release);
+#else
+  (void)kind;
+  (void)object;
+  (void)arg;
+#endif
+}
+
+/**Copy out the events of every thread, oldest first. Meant to be called
+ * while the traced threads are quiescent; events overwritten during the copy
+ * are dropped.
+ */
+inline std::vector<TraceEvent> collectTrace() {
+  std::vector<TraceEvent> ret;
+#ifdef TAOMP_TRACE
+  for (internal::TraceRing &ring : internal::trace_rings) {
+    uint64_t head = ring.head.load(std::memory_order_acquire);
+    uint64_t first = head > TraceCapacity ? head - TraceCapacity : 0;
+    std::size_t start = ret.size();
+    for (uint64_t i = first; i < head; ++i) {
+      ret.push_back(ring.events[i & (TraceCapacity - 1)]);
+    }
+    // the writer may have lapped the copy
+    uint64_t head1 = ring.head.load(std::memory_order_acquire);
+    if (head1 > first + TraceCapacity) {
+      std::size_t lost = std::min<uint64_t>(head1 - first - TraceCapacity,
+                                            head - first);
+      ret.erase(ret.begin() + start, ret.begin() + start + lost);
+    }
+  }
+#endif
+  return ret;
+}
+
+inline void resetTrace() {
+#ifdef TAOMP_TRACE
+  for (internal::TraceRing &ring : internal::trace_rings) {
+    ring.head.store(0, std::memory_order_relaxed);
+  }
+#endif
+}
+} // namespace TAOMP_TRACE_NAMESPACE
+
+inline const char *getTraceName(TraceKind kind) {
+  static const char *names[unsigned(TraceKind::NumKinds)] = {
+      "lock",  "lock", "cas_fail", "scan",   "scan",
+      "enqueue", "enqueue", "dequeue", "dequeue"};
+  return names[unsigned(kind)];
+}
+
+/**Chrome trace event format: begin/end pairs become duration events, a
+ * failed CAS an instant event. Timestamps are in us from the first event.
+ */
+inline void writeChromeTrace(std::ostream &os,
+                             const std::vector<TraceEvent> &events,
+                             double ticks_per_ns) {
+  TimeStamp start = ~TimeStamp(0);
+  for (const TraceEvent &e : events) {
+    start = std::min(start, e.time);
+  }
+  os << "{\"traceEvents\":[";
+  const char *sep = "\n";
+  char object[32];
+  for (const TraceEvent &e : events) {
+    const char *phase = "i";
+    switch (e.kind) {
+    case TraceKind::LockAcquire:
+    case TraceKind::ScanBegin:
+    case TraceKind::EnqueueBegin:
+    case TraceKind::DequeueBegin:
+      phase = "B";
+      break;
+    case TraceKind::LockRelease:
+    case TraceKind::ScanEnd:
+    case TraceKind::EnqueueEnd:
+    case TraceKind::DequeueEnd:
+      phase = "E";
+      break;
+    default:
+      break;
+    }
+    snprintf(object, sizeof(object), "0x%llx",
+             static_cast<unsigned long long>(e.object));
+    double ts = double(e.time - start) / ticks_per_ns / 1000;
+    os << sep << "{\"name\":\"" << getTraceName(e.kind) << "\",\"ph\":\""
+       << phase << "\",\"ts\":" << std::to_string(ts)
+       << ",\"pid\":0,\"tid\":" << e.tid;
+    if (*phase == 'i') {
+      os << ",\"s\":\"t\"";
+    }
+    os << ",\"args\":{\"object\":\"" << object << "\",\"arg\":" << e.arg
+       << "}}";
+    sep = ",\n";
+  }
+  os << "\n]}\n";
+}
+
+inline namespace TAOMP_TRACE_NAMESPACE {
+/**Binary dump: "TAOMPTRC", the ticks/ns calibration (double), the event
+ * count (uint64_t) and the TraceEvent array, all in host byte order.
+ */
+inline bool dumpTrace(const std::string &path) {
+  std::vector<TraceEvent> events = collectTrace();
+  std::ofstream os(path, std::ios::binary);
+  if (!os) {
+    return false;
+  }
+  double ticks_per_ns = tickCalibration().ticks_per_ns;
+  uint64_t count = events.size();
+  os.write("TAOMPTRC", 8);
+  os.write(reinterpret_cast<const char *>(&ticks_per_ns), sizeof(double));
+  os.write(reinterpret_cast<const char *>(&count), sizeof(count));
+  os.write(reinterpret_cast<const char *>(events.data()),
+           count * sizeof(TraceEvent));
+  return bool(os);
+}
+} // namespace TAOMP_TRACE_NAMESPACE
+
+inline bool loadTrace(const std::string &path, std::vector<TraceEvent> &events,
+                      double &ticks_per_ns) {
+  std::ifstream is(path, std::ios::binary);
+  char magic[8];
+  uint64_t count;
+  if (!is.read(magic, 8) || memcmp(magic, "TAOMPTRC", 8) ||
+      !is.read(reinterpret_cast<char *>(&ticks_per_ns), sizeof(double)) ||
+      !is.read(reinterpret_cast<char *>(&count), sizeof(count))) {
+    return false;
+  }
+  events.resize(count);
+  return bool(is.read(reinterpret_cast<char *>(events.data()),
+                      count * sizeof(TraceEvent)));
+}
+
+} // namespace taomp
@@ -19,15 +19,28 @@
 // return value after calling the function
 #define GIVE(x) x
 
-namespace std {
-inline constexpr std::size_t hardware_destructive_interference_size = 64;
-inline constexpr std::size_t hardware_constructive_interference_size = 64;
-} // namespace std
+/**The padding of the containers, a guess for the target which can be
+ * overridden with -DTAOMP_CACHE_LINE_SIZE=...; Topology::cacheLineSize() in
+ * topology.hpp tells the size of the machine at run time, and Topology::get()
+ * warns when it is larger. 64-bit ARM and POWER get 128: Apple M-class and
+ * several ARM server cores have 128-byte lines, and padding a 64-byte line
+ * machine to 128 only costs memory. The std interference sizes of <new> are
+ * not used: GCC warns on every use, as their value may differ between
+ * compiler versions and tuning flags.
+ */
+#ifndef TAOMP_CACHE_LINE_SIZE
+#if defined(__aarch64__) || defined(__powerpc64__)
+#define TAOMP_CACHE_LINE_SIZE 128
+#else
+#define TAOMP_CACHE_LINE_SIZE 64
+#endif
+#endif
 
 namespace taomp {
 
-template <typename T,
-          std::size_t align = std::hardware_destructive_interference_size>
+inline constexpr std::size_t CacheLineSize = TAOMP_CACHE_LINE_SIZE;
+
+template <typename T, std::size_t align = CacheLineSize>
 T *aligned_alloc(std::size_t num = 1) {
   auto *ret = reinterpret_cast<T *>(::aligned_alloc(align, sizeof(T) * num));
   assert(ret);
@@ -44,13 +57,16 @@ inline void init_thread() {
       internal::thread_count.fetch_add(1, std::memory_order_acq_rel);
 }
 
+// for harnesses which already number their threads, e.g. google benchmark
+inline void init_thread(unsigned tid) { internal::thread_id = tid; }
+
 inline unsigned get_thread_id() { return internal::thread_id; }
 
 inline void reset() {
   internal::thread_count.store(0, std::memory_order_release);
 }
 
-template <typename T, std::size_t Alignment = std::hardware_destructive_interference_size> class ThreadLocal {
+template <typename T, std::size_t Alignment = CacheLineSize> class ThreadLocal {
   struct alignas(Alignment) ContainerT {
     T value;
     template <typename... Args>
@@ -68,7 +84,7 @@ public:
       new (tls + i) ContainerT{std::forward<Args>(args)...};
     }
   }
-  ThreadLocal(unsigned thread_num) {
+  ThreadLocal(unsigned thread_num) : thread_num(thread_num) {
     assert(thread_num);
     tls = taomp::aligned_alloc<ContainerT, Alignment>(thread_num);
     for (unsigned i = 0; i < thread_num; ++i) {
@@ -77,6 +93,7 @@ public:
   }
   T &get(unsigned tid = get_thread_id()) { return tls[tid].value; }
   T &operator[](unsigned tid) { return get(tid); }
+  unsigned size() const { return thread_num; }
   void set(unsigned tid, const T &v) { tls[tid] = v; }
   void set(const T & v) {
     set(get_thread_id(), v);
@@ -114,11 +131,32 @@ MaskLeadingZero(T n) {
   return internal::MaskLeadingZero_impl<T, sizeof(T) * CHAR_BIT>::calc(n);
 }
 
-template <typename T> T Mask(unsigned bits) { return (T(1) << bits) - T(1); }
+template <typename T> constexpr T Mask(unsigned bits) { return (T(1) << bits) - T(1); }
+
+namespace internal {
+/**Maps a dense 32-bit index onto geometrically growing segments: segment k
+ * holds (1 << (FirstSegmentBits + k)) slots. Segments never move once
+ * allocated, and the segment of an index is found with one clz.
+ */
+template <unsigned FirstSegmentBits> struct SegmentIndex {
+  static constexpr unsigned MaxSegments = 33 - FirstSegmentBits;
+  static unsigned segment(unsigned i) {
+    uint64_t j = uint64_t(i) + (uint64_t(1) << FirstSegmentBits);
+    return 63 - __builtin_clzll(j) - FirstSegmentBits;
+  }
+  static std::size_t offset(unsigned i, unsigned seg) {
+    return uint64_t(i) + (uint64_t(1) << FirstSegmentBits) -
+           (uint64_t(1) << (FirstSegmentBits + seg));
+  }
+  static std::size_t segmentSize(unsigned seg) {
+    return std::size_t(1) << (FirstSegmentBits + seg);
+  }
+};
+} // namespace internal
 
 
 using TimeStamp = uint64_t;
-TimeStamp readCPUCycleCount() {
+inline TimeStamp readCPUCycleCount() {
   /** shameless stolen from google/benchmark:src/cycleclock.h
    */
 #if defined(__aarch64__)
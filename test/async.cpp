@@ -0,0 +1,126 @@
+#include "taomp/async.hpp"
+
+#include <cassert>
+
+#if __has_include(<coroutine>) && __cplusplus > 201703L
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+const unsigned task_num = 16;
+const int N = 2000;
+
+struct Shared {
+  taomp::AsyncMutex mutex;
+  long count = 0;
+  bool inside = false;
+  std::atomic<unsigned> done{0};
+};
+
+// yields inside the critical section, so the other tasks queue up behind it
+taomp::DetachedTask increment(Shared &shared, taomp::Executor &executor) {
+  for (int i = 0; i < N; ++i) {
+    taomp::AsyncMutex::QNode node;
+    co_await shared.mutex.lock(node, executor);
+    assert(!shared.inside);
+    shared.inside = true;
+    ++shared.count;
+    if (i % 4 == 0) {
+      co_await executor.schedule();
+    }
+    shared.inside = false;
+    shared.mutex.unlock(node);
+  }
+  shared.done.fetch_add(1);
+}
+
+void waitFor(std::atomic<unsigned> &done, unsigned n) {
+  while (done.load() != n) {
+    std::this_thread::yield();
+  }
+}
+
+void testMutexSingleThread() {
+  taomp::ManualExecutor executor;
+  Shared shared;
+  for (unsigned t = 0; t < task_num; ++t) {
+    taomp::spawn(executor, increment(shared, executor));
+  }
+  executor.run();
+  assert(shared.done.load() == task_num);
+  assert(shared.count == long(task_num) * N);
+  taomp::AsyncMutex::QNode node;
+  assert(shared.mutex.try_lock(node));
+  shared.mutex.unlock(node);
+}
+
+void testMutexThreadPool() {
+  Shared shared;
+  {
+    taomp::ThreadPoolExecutor executor(4);
+    for (unsigned t = 0; t < task_num; ++t) {
+      taomp::spawn(executor, increment(shared, executor));
+    }
+    waitFor(shared.done, task_num);
+  }
+  assert(shared.count == long(task_num) * N);
+}
+
+struct Pipe {
+  taomp::AsyncQueue<int> queue;
+  std::atomic<long> sum{0};
+  std::atomic<unsigned> done{0};
+};
+
+taomp::DetachedTask produce(Pipe &pipe, taomp::Executor &executor) {
+  for (int i = 0; i < N; ++i) {
+    pipe.queue.push(i);
+    if (i % 16 == 0) {
+      co_await executor.schedule();
+    }
+  }
+  pipe.done.fetch_add(1);
+}
+
+taomp::DetachedTask consume(Pipe &pipe, taomp::Executor &executor) {
+  long sum = 0;
+  for (int i = 0; i < N; ++i) {
+    sum += co_await pipe.queue.pop(executor);
+  }
+  pipe.sum.fetch_add(sum);
+  pipe.done.fetch_add(1);
+}
+
+template <typename ExecutorTy> void testQueue(ExecutorTy &executor) {
+  Pipe pipe;
+  // consumers first, so that they suspend on the empty queue
+  for (unsigned t = 0; t < task_num; ++t) {
+    taomp::spawn(executor, consume(pipe, executor));
+  }
+  for (unsigned t = 0; t < task_num; ++t) {
+    taomp::spawn(executor, produce(pipe, executor));
+  }
+  if constexpr (std::is_same<ExecutorTy, taomp::ManualExecutor>::value) {
+    executor.run();
+  }
+  waitFor(pipe.done, 2 * task_num);
+  assert(pipe.sum.load() == long(task_num) * N * (N - 1) / 2);
+  assert(!pipe.queue.try_pop());
+}
+
+int main() {
+  testMutexSingleThread();
+  testMutexThreadPool();
+  taomp::ManualExecutor manual;
+  testQueue(manual);
+  taomp::ThreadPoolExecutor pool(4);
+  testQueue(pool);
+}
+
+#else
+
+// coroutines need C++20
+int main() {}
+
+#endif
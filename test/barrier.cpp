@@ -0,0 +1,43 @@
+#include "taomp/barrier.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+const int rounds = 2000;
+
+// no thread may leave episode r before every thread has entered it
+template <typename Barrier> void testBarrier(unsigned thread_num) {
+  Barrier barrier(thread_num);
+  std::vector<std::atomic<int>> phase(thread_num);
+  for (auto &p : phase) {
+    p.store(0);
+  }
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      for (int r = 1; r <= rounds; ++r) {
+        phase[t].store(r, std::memory_order_relaxed);
+        barrier.await();
+        for (unsigned i = 0; i < thread_num; ++i) {
+          int p = phase[i].load(std::memory_order_relaxed);
+          assert(p == r || p == r + 1);
+          (void)p;
+        }
+        barrier.await();
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+int main() {
+  for (unsigned n : {1u, 2u, 3u, 8u}) {
+    testBarrier<taomp::SenseBarrier>(n);
+    testBarrier<taomp::DisseminationBarrier>(n);
+  }
+}
@@ -0,0 +1,106 @@
+#include "taomp/broadcast_ring.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+const unsigned consumer_num = 4;
+const unsigned producer_num = 4;
+const int N = 10000;
+
+/**One producer, every consumer sees 0 .. n-1 in order, each event at its own
+ * sequence; every other batch is published with publishBatch().
+ */
+template <typename Ring, typename... Args>
+void testSingle(int n, Args... args) {
+  Ring ring(consumer_num, args...);
+  std::vector<std::thread> threads;
+  for (unsigned c = 0; c < consumer_num; ++c) {
+    threads.emplace_back([&, c] {
+      uint64_t expected = 0;
+      while (expected < uint64_t(n)) {
+        // odd consumers take small batches
+        ring.consume(
+            c,
+            [&](uint64_t seq, const uint64_t &v) {
+              assert(seq == expected && v == expected);
+              ++expected;
+            },
+            c % 2 ? 3 : Ring::capacity());
+      }
+      assert(ring.position(c) == uint64_t(n));
+    });
+  }
+  threads.emplace_back([&] {
+    uint64_t next = 0;
+    while (next < uint64_t(n)) {
+      if (next % 2) {
+        assert(ring.publish(next) == next);
+        ++next;
+      } else {
+        std::size_t batch = std::min<uint64_t>(5, n - next);
+        ring.publishBatch(batch, [&](uint64_t seq, uint64_t &v) {
+          assert(seq == next);
+          v = next++;
+        });
+      }
+    }
+  });
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+/**Several producers: every consumer sees every event once, and the events of
+ * one producer in the order published.
+ */
+template <typename Ring, typename... Args>
+void testMulti(int n, Args... args) {
+  Ring ring(consumer_num, args...);
+  std::vector<std::thread> threads;
+  for (unsigned c = 0; c < consumer_num; ++c) {
+    threads.emplace_back([&, c] {
+      std::vector<uint64_t> next(producer_num, 0);
+      uint64_t total = 0;
+      while (total < uint64_t(n)) {
+        total += ring.consume(c, [&](uint64_t, const uint64_t &v) {
+          unsigned p = v % producer_num;
+          assert(v / producer_num == next[p]);
+          ++next[p];
+        });
+      }
+      for (unsigned p = 0; p < producer_num; ++p) {
+        assert(next[p] == n / producer_num);
+      }
+      assert(!ring.tryConsume(c, [](uint64_t, const uint64_t &) {}));
+    });
+  }
+  for (unsigned p = 0; p < producer_num; ++p) {
+    threads.emplace_back([&, p] {
+      for (uint64_t i = 0; i < n / producer_num; ++i) {
+        ring.publish(i * producer_num + p);
+        if (i % 128 == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+int main() {
+  using namespace taomp;
+  // spinning waiters only make progress when the scheduler preempts them,
+  // keep their runs short on machines with few cpus
+  using BackoffRing =
+      BroadcastRing<uint64_t, 64, SingleProducer, BackoffWait<>>;
+  testSingle<BackoffRing>(N / 10);
+  testSingle<BroadcastRing<uint64_t, 1024, SingleProducer, SpinWait>>(N / 10);
+  testSingle<BroadcastRing<uint64_t, 64, SingleProducer, FutexWait>>(N, 16u);
+  testSingle<MultiProducerBroadcastRing<uint64_t, 64, FutexWait>>(N);
+  testMulti<MultiProducerBroadcastRing<uint64_t, 64, BackoffWait<>>>(N / 10);
+  testMulti<MultiProducerBroadcastRing<uint64_t, 64, FutexWait>>(N, 16u);
+}
@@ -0,0 +1,89 @@
+#include "taomp/concurrent_vector.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+const unsigned thread_num = 8;
+const int N = 10000;
+
+/**Writers push (tid, seq) pairs while a reader iterates: every element it
+ * sees is complete, and a writer's elements appear in the order pushed.
+ */
+void testConcurrentPush() {
+  struct Record {
+    unsigned tid;
+    int seq;
+  };
+  taomp::ConcurrentVector<Record> vec;
+  std::atomic<unsigned> writing{thread_num};
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < N; ++i) {
+        unsigned index = vec.push_back(Record{t, i});
+        assert(vec.ready(index) && vec[index].seq == i);
+        if (i % 256 == 0) {
+          std::this_thread::yield();
+        }
+      }
+      writing.fetch_sub(1);
+    });
+  }
+  threads.emplace_back([&] {
+    while (writing.load()) {
+      std::vector<int> last(thread_num, -1);
+      unsigned prev = 0;
+      bool first = true;
+      vec.forEach([&](unsigned index, const Record &r) {
+        assert(first || index > prev);
+        first = false;
+        prev = index;
+        assert(r.tid < thread_num && r.seq > last[r.tid]);
+        last[r.tid] = r.seq;
+      });
+      std::this_thread::yield();
+    }
+  });
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(vec.size() == thread_num * N);
+  std::vector<int> next(thread_num, 0);
+  unsigned seen = 0;
+  vec.forEach([&](unsigned index, const Record &r) {
+    assert(vec.tryGet(index) == &r);
+    assert(r.seq == next[r.tid]++);
+    ++seen;
+  });
+  assert(seen == thread_num * N);
+  assert(!vec.ready(thread_num * N) && !vec.tryGet(thread_num * N));
+}
+
+/**Elements stay where they were constructed, and the vector destroys them.
+ */
+void testStable() {
+  auto counter = std::make_shared<int>(0);
+  {
+    taomp::ConcurrentVector<std::shared_ptr<int>, 2> vec;
+    const std::shared_ptr<int> *first = nullptr;
+    for (int i = 0; i < 1000; ++i) {
+      unsigned index = vec.emplace_back(counter);
+      assert(index == unsigned(i));
+      if (!i) {
+        first = &vec[0];
+      }
+    }
+    assert(first == &vec[0]);
+    assert(counter.use_count() == 1001);
+  }
+  assert(counter.use_count() == 1);
+}
+
+int main() {
+  testConcurrentPush();
+  testStable();
+}
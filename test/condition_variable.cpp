@@ -0,0 +1,89 @@
+#include "taomp/condition_variable.hpp"
+#include "taomp/lock.hpp"
+
+#include <cassert>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const int N = 20000;
+const int thread_num = 4;
+
+// bounded buffer with two condition variables, every item is consumed once
+void testProducerConsumer() {
+  taomp::TTASLock lock;
+  taomp::ConditionVariable not_empty, not_full;
+  std::deque<int> buffer;
+  std::vector<int> seen(thread_num * N);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < N; ++i) {
+        std::unique_lock<taomp::TTASLock> guard(lock);
+        not_full.wait(guard, [&] { return buffer.size() < 16; });
+        buffer.push_back(t * N + i);
+        not_empty.notify_one();
+      }
+    });
+    threads.emplace_back([&] {
+      for (int i = 0; i < N; ++i) {
+        std::unique_lock<taomp::TTASLock> guard(lock);
+        not_empty.wait(guard, [&] { return !buffer.empty(); });
+        ++seen[buffer.front()];
+        buffer.pop_front();
+        not_full.notify_one();
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (int s : seen) {
+    assert(s == 1);
+    (void)s;
+  }
+}
+
+// notify_all wakes every waiter through the morphing chain
+void testBroadcast() {
+  taomp::TTASLock lock;
+  taomp::ConditionVariable cv;
+  int waiting = 0;
+  int generation = 0;
+  for (int r = 0; r < 100; ++r) {
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thread_num * 2; ++t) {
+      threads.emplace_back([&] {
+        lock.lock();
+        int my = generation;
+        ++waiting;
+        cv.wait(lock, [&] { return generation != my; });
+        --waiting;
+        lock.unlock();
+      });
+    }
+    while (true) {
+      {
+        std::lock_guard<taomp::TTASLock> guard(lock);
+        if (waiting == thread_num * 2) {
+          break;
+        }
+      }
+      std::this_thread::yield();
+    }
+    lock.lock();
+    ++generation;
+    cv.notify_all();
+    lock.unlock();
+    for (auto &t : threads) {
+      t.join();
+    }
+    assert(!waiting);
+  }
+}
+
+int main() {
+  testProducerConsumer();
+  testBroadcast();
+}
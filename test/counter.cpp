@@ -0,0 +1,116 @@
+#include "taomp/counter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <vector>
+
+const unsigned thread_num = 8;
+const int N = 10000;
+
+/**Thread t adds and records 0 .. N-1 and updates the extrema with
+ * t * N .. t * N + N-1; after joining, every aggregate is exact.
+ */
+void testSharded() {
+  taomp::ShardedCounter<> sum(thread_num);
+  taomp::ShardedMin<int64_t> min(thread_num);
+  taomp::ShardedMax<int64_t> max(thread_num);
+  taomp::ShardedHistogram<> hist(thread_num);
+  // 2^6 and above all go to the last bucket
+  taomp::ShardedHistogram<8> capped(thread_num);
+  assert(sum.read() == 0);
+  assert(min.read() == std::numeric_limits<int64_t>::max());
+  assert(max.read() == std::numeric_limits<int64_t>::lowest());
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      for (int i = 0; i < N; ++i) {
+        sum.add(i);
+        min.update(int64_t(t) * N + i);
+        max.update(int64_t(t) * N + i);
+        hist.record(i);
+        capped.record(i, t);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(sum.read() == uint64_t(thread_num) * N * (N - 1) / 2);
+  assert(min.read() == 0);
+  assert(max.read() == int64_t(thread_num) * N - 1);
+  auto h = hist.read();
+  auto c = capped.read();
+  assert(h[0] == thread_num && c[0] == thread_num);
+  uint64_t total = h[0];
+  for (unsigned b = 1; b < h.size(); ++b) {
+    // [2^(b-1), 2^b) clipped to [0, N)
+    uint64_t lo = uint64_t(1) << (b - 1);
+    uint64_t hi = b < 64 ? std::min(uint64_t(1) << b, uint64_t(N)) : N;
+    uint64_t expected = lo < hi ? (hi - lo) * thread_num : 0;
+    assert(h[b] == expected);
+    total += h[b];
+    if (b < c.size() - 1) {
+      assert(c[b] == expected);
+    }
+  }
+  assert(total == uint64_t(thread_num) * N);
+  assert(c.back() == uint64_t(N - 64) * thread_num);
+}
+
+/**Threads arrive and depart on fewer leaves than threads, so leaves go
+ * through 0, 1/2 and back concurrently. query() holds for every thread
+ * between its arrive and depart, and throughout while one thread stays
+ * arrived; it is false once everybody departed.
+ */
+void testSNZI() {
+  taomp::SNZI snzi(thread_num / 2);
+  assert(!snzi.query());
+  snzi.arrive(0);
+  assert(snzi.query());
+  snzi.depart(0);
+  assert(!snzi.query());
+
+  std::atomic<bool> pinned{false}, done{false};
+  std::atomic<unsigned> running{thread_num - 1};
+  std::vector<std::thread> threads;
+  threads.emplace_back([&] {
+    snzi.arrive(0);
+    pinned.store(true);
+    while (running.load()) {
+      assert(snzi.query());
+      std::this_thread::yield();
+    }
+    snzi.depart(0);
+    done.store(true);
+  });
+  while (!pinned.load()) {
+    std::this_thread::yield();
+  }
+  for (unsigned t = 1; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < N; ++i) {
+        snzi.arrive(t);
+        assert(snzi.query());
+        if (i % 64 == 0) {
+          std::this_thread::yield();
+        }
+        snzi.depart(t);
+      }
+      running.fetch_sub(1);
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(done.load() && !snzi.query());
+}
+
+int main() {
+  testSharded();
+  testSNZI();
+}
@@ -0,0 +1,102 @@
+#include "taomp/counting_network.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+const unsigned thread_num = 8;
+const int N = 10000;
+
+/**Output i has seen ceil((n - i) / W) of n tokens.
+ */
+static void checkStep(const std::vector<unsigned> &counts) {
+  unsigned width = counts.size();
+  unsigned n = 0;
+  for (unsigned c : counts) {
+    n += c;
+  }
+  for (unsigned i = 0; i < width; ++i) {
+    assert(counts[i] == (n + width - 1 - i) / width);
+  }
+}
+
+/**One thread entering on every input in turn: the step property must hold
+ * after every single token.
+ */
+template <typename Net> void testSequential(Net &net) {
+  std::vector<unsigned> counts(Net::Width);
+  for (int i = 0; i < N; ++i) {
+    ++counts[net.traverse(i * 7 % thread_num)];
+    checkStep(counts);
+  }
+}
+
+/**Concurrent tokens: the step property once they have all left, and the
+ * counter hands out every value exactly once.
+ */
+template <typename Net, typename... Args> void testConcurrent(Args... args) {
+  taomp::NetworkCounter<Net> counter(args...);
+  std::vector<std::vector<uint64_t>> values(thread_num);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      for (int i = 0; i < N; ++i) {
+        values[t].push_back(counter.getAndIncrement());
+        if (i % 64 == 0) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  std::vector<uint64_t> all;
+  std::vector<unsigned> counts(Net::Width);
+  for (auto &v : values) {
+    all.insert(all.end(), v.begin(), v.end());
+    for (uint64_t x : v) {
+      ++counts[x % Net::Width];
+    }
+  }
+  checkStep(counts);
+  std::sort(all.begin(), all.end());
+  for (uint64_t i = 0; i < all.size(); ++i) {
+    assert(all[i] == i);
+  }
+  taomp::reset();
+}
+
+template <unsigned W> void testWidth() {
+  const unsigned depth = __builtin_ctz(W);
+  taomp::BitonicNetwork<W> bitonic;
+  assert(bitonic.toggleNum() == W / 2 * (depth * (depth + 1) / 2));
+  testSequential(bitonic);
+  taomp::PeriodicNetwork<W> periodic;
+  assert(periodic.toggleNum() == W / 2 * depth * depth);
+  testSequential(periodic);
+  taomp::DiffractingTree<W> tree(thread_num);
+  testSequential(tree);
+
+  testConcurrent<taomp::BitonicNetwork<W>>();
+  testConcurrent<taomp::PeriodicNetwork<W>>();
+  testConcurrent<taomp::DiffractingTree<W>>(thread_num);
+  // no prism, every token toggles
+  testConcurrent<taomp::DiffractingTree<W>>(thread_num, 0, 0);
+}
+
+int main() {
+  testWidth<2>();
+  testWidth<4>();
+  testWidth<8>();
+  testWidth<16>();
+  taomp::ExpBackoff backoff(std::chrono::nanoseconds(10),
+                            std::chrono::nanoseconds(1000));
+  testConcurrent<taomp::BitonicNetwork<8, taomp::ExpBackoff>>(backoff);
+  testConcurrent<taomp::DiffractingTree<8, taomp::ExpBackoff>>(thread_num, 4,
+                                                               64, backoff);
+}
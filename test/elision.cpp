@@ -0,0 +1,56 @@
+#include "taomp/elision.hpp"
+#include "taomp/lock.hpp"
+
+#include <cassert>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const int N = 100000;
+const unsigned thread_num = 4;
+
+// half of the critical sections conflict on a shared counter, half only
+// touch the thread's own one
+int main() {
+  std::cerr << "rtm: " << taomp::rtmSupported() << std::endl;
+  taomp::ElidedLock<taomp::TTASLock, true> lock(thread_num);
+  uint64_t shared = 0;
+  taomp::ThreadLocal<uint64_t> own(thread_num);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      own.get() = 0;
+      for (int i = 0; i < N; ++i) {
+        std::lock_guard<decltype(lock)> guard(lock);
+        if (i & 1) {
+          ++shared;
+        } else {
+          ++own.get();
+        }
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(shared == uint64_t(thread_num) * N / 2);
+  for (unsigned t = 0; t < thread_num; ++t) {
+    assert(own[t] == N / 2);
+  }
+  assert(!lock.isLocked());
+  taomp::StatsSnapshot s = lock.snapshot();
+  std::cerr << "commits: " << s[taomp::StatKind::ElisionCommit]
+            << " fallbacks: " << s[taomp::StatKind::ElisionFallback]
+            << std::endl;
+  if (taomp::rtmSupported()) {
+    // every acquisition either committed or fell back to the lock
+    assert(s[taomp::StatKind::ElisionCommit] +
+               s[taomp::StatKind::ElisionFallback] ==
+           uint64_t(thread_num) * N);
+  } else {
+    assert(!s[taomp::StatKind::ElisionCommit]);
+    assert(!s[taomp::StatKind::ElisionFallback]);
+  }
+}
@@ -0,0 +1,97 @@
+#include "queue_test.hpp"
+#include "taomp/hazard_eras.hpp"
+#include "taomp/ms_queue.hpp"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+taomp::MSQueue<int, true, taomp::HazardEras<std::allocator<int>>> queue(
+    thread_num);
+
+std::atomic<long> live_nodes{0};
+
+template <typename T> struct CountingAllocator : std::allocator<T> {
+  template <typename U> struct rebind { using other = CountingAllocator<U>; };
+  CountingAllocator() = default;
+  template <typename U> CountingAllocator(const CountingAllocator<U> &) {}
+  T *allocate(std::size_t n) {
+    live_nodes.fetch_add(n, std::memory_order_relaxed);
+    return std::allocator<T>::allocate(n);
+  }
+  void deallocate(T *p, std::size_t n) {
+    live_nodes.fetch_sub(n, std::memory_order_relaxed);
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+struct Node {
+  int value;
+};
+
+/**One thread protects the shared node and then stalls, while the others keep
+ * replacing and retiring it. Only the nodes alive in the era the stalled
+ * thread published stay pinned, so the memory in use stays bounded, unlike
+ * with epoch based reclamation.
+ */
+void testStalledReader() {
+  const unsigned writer_num = thread_num - 1;
+  const int rounds = 20 * N;
+  const unsigned threshold = 64;
+  {
+    taomp::HazardEras<CountingAllocator<Node>> gc(thread_num, thread_num,
+                                                  threshold);
+    taomp::Atomic<Node *> shared(new (gc.allocate(1)) Node{0});
+    std::atomic<bool> stalled{false}, done{false};
+    std::atomic<long> peak{0};
+    std::vector<std::thread> threads;
+    threads.emplace_back([&] {
+      taomp::init_thread(0);
+      Node *p = gc.protect(0, shared);
+      stalled.store(true);
+      while (!done.load()) {
+        std::this_thread::yield();
+      }
+      // still protected, so it was not freed
+      assert(p->value >= 0);
+      gc.clear(0);
+    });
+    while (!stalled.load()) {
+      std::this_thread::yield();
+    }
+    for (unsigned t = 1; t <= writer_num; ++t) {
+      threads.emplace_back([&, t] {
+        taomp::init_thread(t);
+        for (int i = 1; i <= rounds; ++i) {
+          Node *fresh = new (gc.allocate(1)) Node{i};
+          Node *old = shared.exchange(fresh);
+          gc.retire(old);
+          long now = live_nodes.load(std::memory_order_relaxed);
+          long prev = peak.load(std::memory_order_relaxed);
+          while (now > prev && !peak.compare_exchange_weak(prev, now)) {
+          }
+        }
+      });
+    }
+    for (unsigned t = 1; t <= writer_num; ++t) {
+      threads[t].join();
+    }
+    done.store(true);
+    threads[0].join();
+    // every writer keeps at most a scan threshold of nodes, plus the ones
+    // pinned by the stalled thread, which were all born before it stalled
+    long bound = long(writer_num) * (threshold + 1) + writer_num + 1;
+    assert(peak.load() <= bound);
+    assert(long(writer_num) * rounds > 10 * bound);
+    taomp::init_thread(0);
+    gc.retire(shared.load());
+  }
+  assert(live_nodes.load() == 0);
+}
+
+int main() {
+  runQueueTest(queue);
+  taomp::reset();
+  testStalledReader();
+}
@@ -0,0 +1,51 @@
+#include "queue_test.hpp"
+#include "taomp/kp_queue.hpp"
+
+#include <atomic>
+#include <string>
+
+taomp::KPQueue<int, true>
+    queue(thread_num);
+
+// counts the live objects, to find values the queue never constructs or
+// never destroys
+struct Counted {
+  static inline std::atomic<long> live{0};
+  int value;
+  Counted(int value = 0) : value(value) { ++live; }
+  Counted(const Counted &other) : value(other.value) { ++live; }
+  Counted &operator=(const Counted &) = default;
+  ~Counted() { --live; }
+};
+
+// non-trivial values, copied into nodes and descriptors and left in the
+// queue at its destruction
+void testNonTrivial() {
+  {
+    taomp::KPQueue<Counted> q(thread_num);
+    taomp::KPQueue<std::string> strings(thread_num);
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < thread_num; ++t) {
+      threads.emplace_back([&, t] {
+        taomp::init_thread(t);
+        for (int i = 0; i < N / 10; ++i) {
+          q.enqueue(Counted(i));
+          q.enqueue(Counted(i));
+          assert(q.dequeue());
+          std::string s = std::to_string(i) + std::string(32, 'x');
+          strings.enqueue(s);
+          assert(strings.dequeue()->size() >= 33);
+        }
+      });
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+  assert(Counted::live == 0);
+}
+
+int main() {
+  runQueueTest(queue);
+  testNonTrivial();
+}
@@ -0,0 +1,163 @@
+#include "taomp/linearizability.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using taomp::Operation;
+using taomp::QueueModel;
+using taomp::SetModel;
+using taomp::StackModel;
+
+const unsigned thread_num = 8;
+const int N = 100000;
+
+void testQueue() {
+  // enq(1) and enq(2) overlap, so either dequeue order is fine
+  std::vector<Operation> h = {
+      {0, QueueModel::Enqueue, 1, {}, 0, 10},
+      {1, QueueModel::Enqueue, 2, {}, 5, 15},
+      {0, QueueModel::Dequeue, 0, 2, 20, 30},
+      {1, QueueModel::Dequeue, 0, 1, 31, 40},
+  };
+  assert(taomp::checkLinearizable<QueueModel>(h));
+  // enq(1) strictly precedes enq(2), so dequeuing 2 first is a violation
+  h[1].before = 11;
+  auto ret = taomp::checkLinearizable<QueueModel>(h);
+  assert(!ret && ret.failed == 2);
+  // a value dequeued twice
+  h[1].before = 5;
+  h[3].result = 2;
+  ret = taomp::checkLinearizable<QueueModel>(h);
+  assert(!ret && ret.failed == 3);
+  // an empty dequeue overlapping the only enqueue
+  std::vector<Operation> h1 = {
+      {0, QueueModel::Enqueue, 1, {}, 0, 10},
+      {1, QueueModel::Dequeue, 0, {}, 5, 15},
+      {1, QueueModel::Dequeue, 0, 1, 16, 20},
+  };
+  assert(taomp::checkLinearizable<QueueModel>(h1));
+  h1[1].before = 11;
+  assert(!taomp::checkLinearizable<QueueModel>(h1));
+  // a value enqueued twice may be dequeued twice, but not three times
+  std::vector<Operation> h2 = {
+      {0, QueueModel::Enqueue, 5, {}, 0, 10},
+      {1, QueueModel::Enqueue, 5, {}, 11, 20},
+      {0, QueueModel::Dequeue, 0, 5, 21, 30},
+      {1, QueueModel::Dequeue, 0, 5, 31, 40},
+  };
+  assert(taomp::checkLinearizable<QueueModel>(h2));
+  h2.push_back({0, QueueModel::Dequeue, 0, 5, 41, 50});
+  ret = taomp::checkLinearizable<QueueModel>(h2);
+  assert(!ret && ret.failed == 4);
+}
+
+void testStack() {
+  std::vector<Operation> h = {
+      {0, StackModel::Push, 1, {}, 0, 10},
+      {1, StackModel::Push, 2, {}, 11, 20},
+      {0, StackModel::Pop, 0, 2, 21, 30},
+      {1, StackModel::Pop, 0, 1, 25, 35},
+  };
+  assert(taomp::checkLinearizable<StackModel>(h));
+  h[2].result = 1;
+  h[3].result = 2;
+  h[3].before = 31;
+  assert(!taomp::checkLinearizable<StackModel>(h));
+}
+
+void testSet() {
+  std::vector<Operation> h = {
+      {0, SetModel::Insert, 1, 1, 0, 10},
+      {1, SetModel::Insert, 2, 1, 0, 10},
+      {2, SetModel::Contains, 1, 0, 5, 15},
+      {2, SetModel::Remove, 2, 1, 16, 20},
+      {0, SetModel::Insert, 1, 0, 16, 20},
+  };
+  assert(taomp::checkLinearizableByKey<SetModel>(h));
+  h[2].before = 11;
+  auto ret = taomp::checkLinearizableByKey<SetModel>(h);
+  assert(!ret && ret.failed == 2);
+}
+
+// a queue whose states all hash alike, and without the FIFO hints
+struct CollidingQueueModel : QueueModel {
+  using Hints = taomp::DefaultHints;
+  static uint64_t hash(const State &) { return 0; }
+};
+
+/**Three enqueues overlap and are dequeued in reverse; the search reaches
+ * the configuration "enq(2) and enq(3) linearized when enq(1) returns" as
+ * [2, 3] first, so [3, 2] must not be pruned as already explored.
+ */
+void testHashCollision() {
+  std::vector<Operation> h = {
+      {0, QueueModel::Enqueue, 1, {}, 0, 10},
+      {1, QueueModel::Enqueue, 2, {}, 0, 11},
+      {2, QueueModel::Enqueue, 3, {}, 0, 12},
+      {0, QueueModel::Dequeue, 0, 3, 20, 30},
+      {0, QueueModel::Dequeue, 0, 2, 31, 40},
+      {0, QueueModel::Dequeue, 0, 1, 41, 50},
+  };
+  assert(taomp::checkLinearizable<CollidingQueueModel>(h));
+}
+
+// a long history generated from a sequential queue, with every interval
+// widened around its linearization point so that up to thread_num overlap
+void testLargeQueueHistory() {
+  std::default_random_engine e1(42);
+  std::uniform_int_distribution<int> kind(0, 1);
+  std::uniform_int_distribution<int> width(0, 20);
+  std::deque<int64_t> queue;
+  std::vector<Operation> h;
+  std::vector<taomp::TimeStamp> thread_free(thread_num, 0);
+  taomp::TimeStamp now = 0;
+  for (int i = 0; i < N; ++i) {
+    now += 4;
+    unsigned tid = i % thread_num;
+    Operation op{tid, QueueModel::Enqueue, i, {}, now, now};
+    if (kind(e1)) {
+      queue.push_back(i);
+    } else {
+      op.kind = QueueModel::Dequeue;
+      if (!queue.empty()) {
+        op.result = queue.front();
+        queue.pop_front();
+      }
+    }
+    op.before = std::max(thread_free[tid], now - std::min<taomp::TimeStamp>(
+                                                     now, width(e1)));
+    op.after = now + width(e1);
+    thread_free[tid] = op.after + 1;
+    h.push_back(op);
+  }
+  auto start = std::chrono::steady_clock::now();
+  assert(taomp::checkLinearizable<QueueModel>(h));
+  // swap two dequeue results far enough apart to be ordered
+  std::size_t a = 0, b = 0;
+  for (std::size_t i = 0; i < h.size(); ++i) {
+    if (h[i].kind == QueueModel::Dequeue && h[i].result) {
+      if (!a && i > h.size() / 2) {
+        a = i;
+      } else if (a && h[i].before > h[a].after + 100) {
+        b = i;
+        break;
+      }
+    }
+  }
+  std::swap(h[a].result, h[b].result);
+  assert(!taomp::checkLinearizable<QueueModel>(h));
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  std::cerr << "checked 2 x " << N << " operations in " << d.count() << "s\n";
+}
+
+int main() {
+  testQueue();
+  testStack();
+  testSet();
+  testHashCollision();
+  testLargeQueueHistory();
+}
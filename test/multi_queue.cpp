@@ -0,0 +1,83 @@
+#include "taomp/multi_queue.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+const unsigned thread_num = 8;
+const int N = 10000;
+
+/**Every thread enqueues its own values and dequeues as many elements. The
+ * order is relaxed, but nothing may be lost or duplicated.
+ */
+template <typename QueueTy> void testConservation() {
+  QueueTy queue(thread_num);
+  std::vector<std::atomic<int>> seen(thread_num * N);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      for (int i = 0; i < N; ++i) {
+        queue.enqueue(t * N + i);
+        std::optional<int> v;
+        while (!(v = queue.dequeue())) {
+          std::this_thread::yield();
+        }
+        seen[*v].fetch_add(1);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  for (auto &s : seen) {
+    assert(s.load() == 1);
+  }
+  taomp::init_thread(0);
+  assert(!queue.dequeue());
+}
+
+// a single thread with a single sub-queue sees the exact order
+void testSequential() {
+  taomp::init_thread(0);
+  taomp::MultiQueue<int, taomp::LockedSubQueue, 1> fifo(1);
+  taomp::RelaxedPriorityQueue<int, 1> pq(1);
+  for (int i = 0; i < N; ++i) {
+    fifo.enqueue(i);
+    pq.enqueue({uint64_t((i * 7919) % N), i});
+  }
+  for (int i = 0; i < N; ++i) {
+    assert(*fifo.dequeue() == i);
+    assert(pq.dequeue()->first == uint64_t(i));
+  }
+  assert(!fifo.dequeue() && !pq.dequeue());
+}
+
+// with every bounded sub-queue full, enqueue fails instead of spinning
+void testFull() {
+  taomp::init_thread(0);
+  taomp::MultiQueue<int, taomp::BoundedSubQueue<4>, 2> queue(1);
+  for (int i = 0; i < 8; ++i) {
+    assert(queue.enqueue(i));
+  }
+  assert(!queue.enqueue(8));
+  std::vector<bool> seen(8);
+  for (int i = 0; i < 8; ++i) {
+    std::optional<int> v = queue.dequeue();
+    assert(v && !seen[*v]);
+    seen[*v] = true;
+  }
+  assert(!queue.dequeue());
+  assert(queue.enqueue(8) && *queue.dequeue() == 8);
+}
+
+int main() {
+  testSequential();
+  testFull();
+  testConservation<taomp::MultiQueue<int>>();
+  testConservation<taomp::MultiQueue<int, taomp::MSSubQueue>>();
+  testConservation<taomp::MultiQueue<int, taomp::BoundedSubQueue<64>>>();
+  testConservation<taomp::MultiQueue<int, taomp::LockedSubQueue, 4, 1>>();
+}
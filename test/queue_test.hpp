@@ -0,0 +1,155 @@
+#pragma once
+
+#include "taomp/linearizability.hpp"
+#include "taomp/utils.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+/**Randomized enqueue/dequeue race shared by the concurrent queue tests. Each
+ * thread records the linearization interval reported by the queue for every
+ * operation, then the history is checked for linearizability against a FIFO
+ * queue, and the multiset of enqueued values against the multiset of
+ * dequeued ones.
+ */
+
+const unsigned thread_num = 8;
+const int N = 10000;
+
+struct Event {
+  enum {
+    EK_Enqueue,
+    EK_Dequeue
+  } kind;
+  std::optional<int> result;
+  unsigned tid;
+  taomp::TimeStamp before, after;
+  void dump(std::ostream & os) {
+    os << before << ' ' << after << " : ";
+    if (kind == EK_Dequeue) {
+      os << "dequeue(";
+      if (result) {
+        os << result.value();
+      } else {
+        os << "null";
+      }
+      os << ')';
+    } else {
+      os << "enqueue(" << result.value() << ')';
+    }
+  }
+};
+
+template <typename QueueTy>
+void runTest(QueueTy &queue, taomp::ThreadLocal<std::vector<Event>> &tls) {
+  taomp::init_thread();
+  unsigned tid = taomp::get_thread_id();
+  std::vector<Event> & tl = tls[tid];
+  std::random_device r;
+  std::default_random_engine e1(r());
+  std::uniform_int_distribution<int> dist(0, 1);
+  for (int i = 0; i < N; ++i) {
+    if (dist(e1)) {
+      int v = (i << 8) + tid;
+      queue.enqueue(v);
+      tl[i].kind = Event::EK_Enqueue;
+      tl[i].result = v;
+      tl[i].tid = tid;
+      tl[i].before = queue.getLinearizationPointBefore(tid);
+      tl[i].after = queue.getLinearizationPointAfter(tid);
+    } else {
+      auto res = queue.dequeue();
+      tl[i].kind = Event::EK_Dequeue;
+      tl[i].result = res;
+      tl[i].tid = tid;
+      tl[i].before = queue.getLinearizationPointBefore(tid);
+      tl[i].after = queue.getLinearizationPointAfter(tid);
+    }
+  }
+}
+
+template <typename QueueTy> std::vector<Event> runQueueTest(QueueTy &queue) {
+  taomp::ThreadLocal<std::vector<Event>> tls(thread_num, N);
+  std::vector<std::thread *> threads(thread_num);
+  queue.enqueue(1);
+  queue.dequeue();
+  for (unsigned i = 1; i < thread_num; ++i) {
+    threads[i] = new std::thread(runTest<QueueTy>, std::ref(queue),
+                                 std::ref(tls));
+  }
+  runTest(queue, tls);
+  for (unsigned i = 1; i < thread_num; ++i) {
+    threads[i]->join();
+    delete threads[i];
+  }
+  std::vector<Event> events(thread_num * N);
+  for (unsigned i = 0; i < thread_num; ++i) {
+    std::vector<Event> & tl = tls[i];
+    std::copy(tl.begin(), tl.end(), events.begin() + i * N);
+  }
+  std::cerr << "dump finish\n";
+  std::cerr << events.size() << std::endl;
+  size_t s = events.size();
+  std::sort(events.begin(), events.end(), [](Event & e1, Event & e2) {return e1.before < e2.before ;});
+  int overlap_count = 0;
+  for (unsigned i = 1; i < s; ++i) {
+    if (events[i - 1].after > events[i].before) {
+      ++overlap_count;
+    }
+  }
+  std::cerr << "overlap: " << overlap_count << std::endl;
+  std::vector<taomp::Operation> history;
+  history.reserve(s);
+  for (auto & e : events) {
+    taomp::Operation op{e.tid, taomp::QueueModel::Enqueue, 0, {}, e.before,
+                        e.after};
+    if (e.kind == Event::EK_Enqueue) {
+      op.arg = e.result.value();
+    } else {
+      op.kind = taomp::QueueModel::Dequeue;
+      if (e.result) {
+        op.result = e.result.value();
+      }
+    }
+    history.push_back(op);
+  }
+  auto linearizable = taomp::checkLinearizable<taomp::QueueModel>(history);
+  if (!linearizable) {
+    std::cerr << "not linearizable at: ";
+    events[linearizable.failed].dump(std::cerr);
+    std::cerr << std::endl;
+  }
+  assert(linearizable);
+  std::vector<int> v1, v2;
+  for (auto & e : events) {
+    if (e.kind == Event::EK_Dequeue) {
+      if (e.result) {
+        v2.push_back(e.result.value());
+      }
+    } else {
+      v1.push_back(e.result.value());
+    }
+  }
+  while (true) {
+    auto res = queue.dequeue();
+    if (!res) {
+      break;
+    }
+    v2.push_back(res.value());
+  }
+  std::sort(v1.begin(), v1.end());
+  std::sort(v2.begin(), v2.end());
+  std::cout << v1.size() << ' ' << v2.size() << '\n';
+  assert(v1.size() == v2.size());
+  size_t s1 = v1.size();
+  for (size_t i = 0; i < s1; ++i) {
+    assert(v1[i] == v2[i]);
+  }
+  return events;
+}
@@ -0,0 +1,123 @@
+#include "taomp/rcu.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+const int N = 2000;
+const unsigned thread_num = 4;
+
+// freed objects are poisoned and kept until the end, a reader which still
+// sees one after its grace period fails
+struct Config {
+  static std::mutex graveyard_lock;
+  static std::vector<Config *> graveyard;
+  std::atomic<bool> dead{false};
+  int values[8];
+  explicit Config(int v) {
+    for (int &x : values) {
+      x = v;
+    }
+  }
+  static void retire(Config *c) {
+    c->dead.store(true, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> guard(graveyard_lock);
+    graveyard.push_back(c);
+  }
+};
+std::mutex Config::graveyard_lock;
+std::vector<Config *> Config::graveyard;
+
+template <typename Rcu> void testRcu() {
+  Rcu rcu(thread_num, 16);
+  std::atomic<Config *> current{new Config(0)};
+  std::atomic<bool> done{false};
+  std::atomic<unsigned> online{0};
+  std::vector<std::thread> threads;
+  // thread 0 updates, alternating between callRcu and synchronize
+  threads.emplace_back([&] {
+    taomp::init_thread(0);
+    while (online.load() != thread_num - 1) {
+      std::this_thread::yield();
+    }
+    for (int i = 1; i <= N; ++i) {
+      Config *old = current.exchange(new Config(i));
+      if (i & 1) {
+        rcu.callRcu([old] { Config::retire(old); });
+      } else {
+        rcu.synchronize();
+        Config::retire(old);
+      }
+    }
+    rcu.flush();
+    done.store(true);
+  });
+  for (unsigned t = 1; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      rcu.threadOnline();
+      online.fetch_add(1);
+      int last = 0, reads = 0;
+      while (!done.load()) {
+        ++reads;
+        {
+          taomp::RcuReadGuard<Rcu> guard(rcu);
+          Config *c = current.load(std::memory_order_acquire);
+          for (int k = 0; k < 4; ++k) {
+            std::this_thread::yield();
+            assert(!c->dead.load(std::memory_order_relaxed));
+            assert(c->values[k] == c->values[7]);
+          }
+          assert(c->values[0] >= last);
+          last = c->values[0];
+        }
+        rcu.quiescentState();
+      }
+      rcu.threadOffline();
+      assert(reads > 0);
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  delete current.load();
+  for (Config *c : Config::graveyard) {
+    delete c;
+  }
+  Config::graveyard.clear();
+}
+
+struct Table {
+  int version;
+};
+
+template <typename Rcu> void testRcuPtr() {
+  Rcu rcu(1);
+  taomp::init_thread(0);
+  rcu.threadOnline();
+  taomp::RcuPtr<Table, Rcu> table(rcu, std::make_unique<Table>(Table{0}));
+  for (int i = 1; i < 100; ++i) {
+    {
+      auto snapshot = table.snapshot();
+      assert(snapshot->version == i - 1);
+    }
+    if (i & 1) {
+      table.update(std::make_unique<Table>(Table{i}));
+    } else {
+      table.updateSync(std::make_unique<Table>(Table{i}));
+    }
+    rcu.quiescentState();
+  }
+  rcu.flush();
+  rcu.threadOffline();
+}
+
+int main() {
+  testRcu<taomp::RcuQsbr>();
+  testRcu<taomp::RcuMb>();
+  testRcuPtr<taomp::RcuQsbr>();
+  testRcuPtr<taomp::RcuMb>();
+}
@@ -0,0 +1,196 @@
+#define TAOMP_SCHEDULE_TEST
+#include "taomp/atomic.hpp"
+#include "taomp/hazard_pointer.hpp"
+#include "taomp/linearizability.hpp"
+#include "taomp/lock.hpp"
+#include "taomp/ms_queue.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+/**Runs small MSQueue, HazardPointer and lock scenarios under the controlled
+ * scheduler, for a range of seeds with both a random walk and PCT. A failing
+ * run reports its seed, and `schedule <seed>` replays just that seed.
+ */
+
+using taomp::schedule::PCT;
+using taomp::schedule::RandomWalk;
+using taomp::schedule::Scheduler;
+using taomp::schedule::Strategy;
+
+const unsigned thread_num = 3;
+const unsigned seed_num = 500;
+const uint64_t pct_steps = 300;
+
+uint64_t current_seed;
+const char *current_scenario = "";
+
+void reportSeed(int) {
+  std::cerr << current_scenario << " failed with seed " << current_seed
+            << std::endl;
+}
+
+template <typename Fn>
+void runScheduled(Strategy &strategy, Fn fn) {
+  std::vector<std::function<void()>> fns;
+  for (unsigned i = 0; i < thread_num; ++i) {
+    fns.push_back([&fn, i] { fn(i); });
+  }
+  Scheduler scheduler(strategy);
+  scheduler.run(fns);
+}
+
+void testMSQueue(Strategy &strategy) {
+  current_scenario = "ms_queue";
+  const int op_num = 4;
+  taomp::MSQueue<int, true> queue(thread_num);
+  std::vector<std::vector<taomp::Operation>> ops(thread_num);
+  runScheduled(strategy, [&](unsigned tid) {
+    for (int i = 0; i < op_num; ++i) {
+      taomp::Operation op{tid, taomp::QueueModel::Enqueue, 0, {}, 0, 0};
+      // thread 0 only dequeues, so the queue is drained while it is filled
+      if (tid && i % 2 == 0) {
+        op.arg = (i << 8) + tid;
+        queue.enqueue(op.arg);
+      } else {
+        op.kind = taomp::QueueModel::Dequeue;
+        if (auto v = queue.dequeue()) {
+          op.result = v.value();
+        }
+      }
+      op.before = queue.getLinearizationPointBefore(tid);
+      op.after = queue.getLinearizationPointAfter(tid);
+      ops[tid].push_back(op);
+    }
+  });
+  std::vector<taomp::Operation> history;
+  std::vector<int64_t> enqueued, dequeued;
+  for (auto &v : ops) {
+    for (auto &op : v) {
+      history.push_back(op);
+      if (op.kind == taomp::QueueModel::Enqueue) {
+        enqueued.push_back(op.arg);
+      } else if (op.result) {
+        dequeued.push_back(op.result.value());
+      }
+    }
+  }
+  taomp::init_thread(0);
+  while (auto v = queue.dequeue()) {
+    dequeued.push_back(v.value());
+  }
+  assert(taomp::checkLinearizable<taomp::QueueModel>(history));
+  std::sort(enqueued.begin(), enqueued.end());
+  std::sort(dequeued.begin(), dequeued.end());
+  assert(enqueued == dequeued);
+}
+
+// freed objects are poisoned and kept, so a use after free is always seen
+class PoisonAllocator {
+public:
+  using value_type = int;
+  std::vector<std::unique_ptr<int>> graveyard;
+  int *allocate(std::size_t) { return new int(0); }
+  void deallocate(int *p, std::size_t) {
+    *p = -1;
+    graveyard.emplace_back(p);
+  }
+};
+
+void testHazardPointer(Strategy &strategy) {
+  current_scenario = "hazard_pointer";
+  const int op_num = 6;
+  taomp::HazardPointer<PoisonAllocator> hp(thread_num, thread_num);
+  taomp::Atomic<int *> shared(hp.allocate(1));
+  runScheduled(strategy, [&](unsigned tid) {
+    auto &my_hp = hp.get<int>(tid);
+    for (int i = 0; i < op_num; ++i) {
+      if (tid == 0) {
+        // writer: replace and retire, which scans every few retires
+        hp.retire(shared.exchange(hp.allocate(1)));
+        continue;
+      }
+      int *p = shared.load();
+      my_hp.store(p);
+      if (shared.load() != p) {
+        continue;
+      }
+      assert(*p != -1);
+      my_hp.store(nullptr);
+    }
+  });
+  PoisonAllocator &alloc = hp;
+  alloc.deallocate(shared.load(), 1);
+}
+
+template <typename Lock> void testLock(Strategy &strategy, const char *name) {
+  current_scenario = name;
+  const int op_num = 3;
+  Lock lock;
+  bool inside = false;
+  int counter = 0;
+  runScheduled(strategy, [&](unsigned) {
+    for (int i = 0; i < op_num; ++i) {
+      lock.lock();
+      assert(!inside);
+      inside = true;
+      // let the other threads run into the lock
+      taomp::schedule::schedulePoint();
+      ++counter;
+      inside = false;
+      lock.unlock();
+    }
+  });
+  assert(counter == int(thread_num) * op_num);
+}
+
+void testMCSLock(Strategy &strategy) {
+  current_scenario = "mcs_lock";
+  const int op_num = 3;
+  taomp::MCSLock lock;
+  std::vector<taomp::MCSLock::QNode> nodes(thread_num);
+  bool inside = false;
+  int counter = 0;
+  runScheduled(strategy, [&](unsigned tid) {
+    for (int i = 0; i < op_num; ++i) {
+      lock.lock(&nodes[tid]);
+      assert(!inside);
+      inside = true;
+      taomp::schedule::schedulePoint();
+      ++counter;
+      inside = false;
+      lock.unlock(&nodes[tid]);
+    }
+  });
+  assert(counter == int(thread_num) * op_num);
+}
+
+void runSeed(uint64_t seed) {
+  current_seed = seed;
+  RandomWalk random_walk(seed);
+  PCT pct(seed, pct_steps);
+  for (Strategy *strategy : {static_cast<Strategy *>(&random_walk),
+                             static_cast<Strategy *>(&pct)}) {
+    testMSQueue(*strategy);
+    testHazardPointer(*strategy);
+    testLock<taomp::TTASLock>(*strategy, "ttas_lock");
+    testMCSLock(*strategy);
+  }
+}
+
+int main(int argc, char **argv) {
+  std::signal(SIGABRT, reportSeed);
+  if (argc > 1) {
+    runSeed(std::strtoull(argv[1], nullptr, 10));
+    return 0;
+  }
+  for (uint64_t seed = 0; seed < seed_num; ++seed) {
+    runSeed(seed);
+  }
+  std::cerr << "explored " << seed_num << " seeds" << std::endl;
+}
@@ -0,0 +1,80 @@
+#include "taomp/seq_lock.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+const unsigned reader_num = 6;
+const int N = 100000;
+
+// 120 bytes, every field holds the same value in a consistent snapshot
+struct Snapshot {
+  uint64_t fields[15];
+};
+
+static Snapshot make(uint64_t v) {
+  Snapshot s;
+  for (auto &f : s.fields) {
+    f = v;
+  }
+  return s;
+}
+
+static void checkConsistent(const Snapshot &s) {
+  for (auto f : s.fields) {
+    assert(f == s.fields[0]);
+  }
+}
+
+template <bool MultiWriter> void testTornReads(unsigned writer_num) {
+  taomp::SeqLock<Snapshot, MultiWriter> lock(make(0));
+  std::atomic<bool> done{false};
+  std::vector<std::thread> threads;
+  for (unsigned r = 0; r < reader_num; ++r) {
+    threads.emplace_back([&] {
+      uint64_t last = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        Snapshot s = lock.load();
+        checkConsistent(s);
+        // a single writer's values only grow
+        assert(MultiWriter || s.fields[0] >= last);
+        last = s.fields[0];
+        std::this_thread::yield();
+      }
+    });
+  }
+  std::vector<std::thread> writers;
+  for (unsigned w = 0; w < writer_num; ++w) {
+    writers.emplace_back([&] {
+      for (int i = 1; i <= N; ++i) {
+        if (MultiWriter) {
+          lock.update([](Snapshot &s) {
+            for (auto &f : s.fields) {
+              ++f;
+            }
+          });
+        } else {
+          lock.store(make(i));
+        }
+      }
+    });
+  }
+  for (auto &t : writers) {
+    t.join();
+  }
+  done.store(true);
+  for (auto &t : threads) {
+    t.join();
+  }
+  Snapshot s = lock.load();
+  checkConsistent(s);
+  assert(s.fields[0] == uint64_t(writer_num) * N);
+  assert(lock.version() == 2 * uint64_t(writer_num) * N);
+}
+
+int main() {
+  testTornReads<false>(1);
+  testTornReads<true>(2);
+}
@@ -0,0 +1,270 @@
+#include "taomp/bounded_queue.hpp"
+#include "taomp/linearizability.hpp"
+#include "taomp/shm.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+const int N = 20000;
+const int thread_num = 4;
+
+// steady_clock is CLOCK_MONOTONIC, so stamps of both processes compare
+taomp::TimeStamp now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**Runs the attempt \p op until it succeeds and records the successful call
+ * to \p slot; failed attempts (a full queue, or an empty one, which a bounded
+ * queue may report while an earlier enqueue is still in progress) are not
+ * operations of the FIFO model.
+ */
+template <typename Op>
+std::optional<uint64_t> record(taomp::Operation &slot, unsigned tid,
+                               unsigned kind, int64_t arg, Op op) {
+  while (true) {
+    taomp::TimeStamp before = now();
+    std::optional<uint64_t> result = op();
+    taomp::TimeStamp after = now();
+    if (result) {
+      slot = taomp::Operation{tid, kind, arg, {}, before, after};
+      if (kind == taomp::QueueModel::Dequeue) {
+        slot.result = int64_t(*result);
+      }
+      return result;
+    }
+    std::this_thread::yield();
+  }
+}
+
+struct Node {
+  alignas(8) int value;
+  taomp::OffsetPtr<Node> next;
+};
+
+void testOffsetPtr() {
+  std::vector<Node> nodes(3);
+  for (int i = 0; i < 3; ++i) {
+    nodes[i].value = i;
+    nodes[i].next = i + 1 < 3 ? &nodes[i + 1] : nullptr;
+  }
+  assert(nodes[0].next->value == 1);
+  assert(!nodes[2].next);
+  // a copy is rebased and still points to the same node
+  taomp::OffsetPtr<Node> copy = nodes[0].next;
+  assert(copy.get() == &nodes[1]);
+  // memcpy of the whole block keeps the links inside the block
+  std::vector<Node> moved(3);
+  memcpy(static_cast<void *>(moved.data()), nodes.data(), 3 * sizeof(Node));
+  assert(moved[0].next.get() == &moved[1]);
+
+  taomp::OffsetIntPair<Node, 3> pair(&nodes[2], 5, nodes.data());
+  assert(pair.getPointer(nodes.data()) == &nodes[2]);
+  assert(pair.getInt() == 5);
+  pair.setInt(2);
+  assert(pair.getPointer(nodes.data()) == &nodes[2]);
+  assert(pair.getInt() == 2);
+  assert(pair.getPointer(moved.data()) == &moved[2]);
+  pair.setPointerAndInt(nullptr, 7, nodes.data());
+  assert(!pair.getPointer(nodes.data()) && pair.getInt() == 7);
+}
+
+void testBoundedQueue() {
+  taomp::BoundedQueue<int, 64> queue;
+  for (int i = 0; i < 64; ++i) {
+    assert(queue.enqueue(i));
+  }
+  assert(!queue.enqueue(64));
+  for (int i = 0; i < 64; ++i) {
+    assert(*queue.dequeue() == i);
+  }
+  assert(!queue.dequeue());
+
+  // every producer enqueues 0..N-1 tagged with its id, values of one
+  // producer come out in order and the whole history is linearizable
+  static taomp::BoundedQueue<uint64_t, 256> shared;
+  std::vector<std::thread> threads;
+  std::vector<std::vector<int>> last(thread_num,
+                                     std::vector<int>(thread_num, -1));
+  std::vector<taomp::Operation> history(2 * N * thread_num);
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::Operation *ops = &history[2 * N * t];
+      for (int i = 0; i < N; ++i) {
+        uint64_t tagged = uint64_t(t) << 32 | i;
+        record(ops[2 * i], t, taomp::QueueModel::Enqueue, tagged, [&] {
+          return shared.enqueue(tagged) ? std::optional<uint64_t>(tagged)
+                                       : std::nullopt;
+        });
+        std::optional<uint64_t> v =
+            record(ops[2 * i + 1], t, taomp::QueueModel::Dequeue, 0,
+                   [&] { return shared.dequeue(); });
+        int from = *v >> 32;
+        int value = *v & 0xffffffff;
+        assert(value > last[t][from]);
+        last[t][from] = value;
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(!shared.dequeue());
+  assert(taomp::checkLinearizable<taomp::QueueModel>(history));
+}
+
+struct Shared {
+  taomp::ShmMCSLock mcs;
+  taomp::ShmMCSLock::QNode nodes[2];
+  taomp::ShmTTASLock ttas;
+  uint64_t mcs_counter = 0;
+  uint64_t ttas_counter = 0;
+  taomp::ShmChannel<64, 16> channel;
+};
+
+// the child maps the memfd again, at another address than the parent
+void testProcesses() {
+  taomp::ShmArena arena = taomp::ShmArena::anonymous(std::size_t(1) << 20);
+  Shared *shared = arena.construct<Shared>();
+  arena.setRoot(0, shared);
+  pid_t pid = fork();
+  assert(pid >= 0);
+  unsigned self = pid == 0;
+  if (pid == 0) {
+    taomp::ShmArena mine(arena.getFd());
+    assert(mine.getBase() != arena.getBase());
+    shared = mine.getRoot<Shared>(0);
+    assert(shared);
+    for (int i = 0; i < N; ++i) {
+      shared->mcs.lock(&shared->nodes[self]);
+      ++shared->mcs_counter;
+      shared->mcs.unlock(&shared->nodes[self]);
+      shared->ttas.lock();
+      ++shared->ttas_counter;
+      shared->ttas.unlock();
+    }
+    for (int i = 0; i < N; ++i) {
+      char *msg;
+      while (!(msg = shared->channel.acquire())) {
+        std::this_thread::yield();
+      }
+      memcpy(msg, &i, sizeof(i));
+      shared->channel.post(msg);
+    }
+    _exit(0);
+  }
+  for (int i = 0; i < N; ++i) {
+    shared->mcs.lock(&shared->nodes[self]);
+    ++shared->mcs_counter;
+    shared->mcs.unlock(&shared->nodes[self]);
+    shared->ttas.lock();
+    ++shared->ttas_counter;
+    shared->ttas.unlock();
+  }
+  for (int i = 0; i < N; ++i) {
+    char *msg;
+    while (!(msg = shared->channel.receive())) {
+      std::this_thread::yield();
+    }
+    int value;
+    memcpy(&value, msg, sizeof(value));
+    assert(value == i);
+    shared->channel.release(msg);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  assert(shared->mcs_counter == 2 * N);
+  assert(shared->ttas_counter == 2 * N);
+}
+
+struct QueueShared {
+  taomp::ShmMSQueue<uint64_t> queue;
+  taomp::Atomic<uint64_t> sums[2];
+  // the history of each process, the parent checks both
+  taomp::Operation ops[2][2 * N];
+  QueueShared(taomp::ShmArena &arena) : queue(arena, 4), sums{0, 0} {}
+};
+
+// both processes enqueue 0..N-1 tagged with their id and dequeue after every
+// enqueue, with 4 nodes, which are recycled all the time; the values of one
+// process come out in order and the history of both is linearizable
+void testMSQueueProcesses() {
+  taomp::ShmArena arena = taomp::ShmArena::anonymous(std::size_t(1) << 23);
+  QueueShared *shared = arena.construct<QueueShared>(arena);
+  arena.setRoot(0, shared);
+  for (int i = 0; i < 4; ++i) {
+    assert(shared->queue.enqueue(i));
+  }
+  assert(!shared->queue.enqueue(4));
+  for (int i = 0; i < 4; ++i) {
+    assert(*shared->queue.dequeue() == uint64_t(i));
+  }
+  assert(!shared->queue.dequeue());
+  auto run = [](QueueShared *shared, unsigned self) {
+    int last[2] = {-1, -1};
+    uint64_t sum = 0;
+    taomp::Operation *ops = shared->ops[self];
+    for (int i = 0; i < N; ++i) {
+      uint64_t tagged = uint64_t(self) << 32 | i;
+      record(ops[2 * i], self, taomp::QueueModel::Enqueue, tagged, [&] {
+        return shared->queue.enqueue(tagged) ? std::optional<uint64_t>(tagged)
+                                            : std::nullopt;
+      });
+      std::optional<uint64_t> v =
+          record(ops[2 * i + 1], self, taomp::QueueModel::Dequeue, 0,
+                 [&] { return shared->queue.dequeue(); });
+      int from = *v >> 32;
+      int value = *v & 0xffffffff;
+      assert(value > last[from]);
+      last[from] = value;
+      sum += value;
+      if (i % 64 == 0) {
+        std::this_thread::yield();
+      }
+    }
+    shared->sums[self].store(sum);
+  };
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    taomp::ShmArena mine(arena.getFd());
+    run(mine.getRoot<QueueShared>(0), 1);
+    _exit(0);
+  }
+  run(shared, 0);
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  assert(!shared->queue.dequeue());
+  assert(shared->sums[0] + shared->sums[1] == uint64_t(N) * (N - 1));
+  std::vector<taomp::Operation> history(&shared->ops[0][0],
+                                        &shared->ops[2][0]);
+  assert(taomp::checkLinearizable<taomp::QueueModel>(history));
+}
+
+void testNamed() {
+  std::string name = "/taomp_test_" + std::to_string(getpid());
+  taomp::ShmArena creator = taomp::ShmArena::named(name, 1 << 16, true);
+  int *value = creator.construct<int>(42);
+  creator.setRoot(1, value);
+  taomp::ShmArena opener = taomp::ShmArena::named(name, 0, false);
+  assert(*opener.getRoot<int>(1) == 42);
+  assert(!opener.getRoot<int>(2));
+}
+
+int main() {
+  testOffsetPtr();
+  testBoundedQueue();
+  testProcesses();
+  testMSQueueProcesses();
+  testNamed();
+}
@@ -0,0 +1,72 @@
+#include "queue_test.hpp"
+#include "taomp/ms_queue.hpp"
+#include "taomp/slab_allocator.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+const int N1 = 10000;
+
+struct Block {
+  uint64_t tag;
+  char pad[40];
+};
+
+// every thread allocates blocks and hands them to the next thread, which
+// checks and frees them: all frees but the last round are remote
+void testRemoteFree() {
+  taomp::SlabHeap heap;
+  taomp::SlabAllocator<Block> alloc(heap);
+  std::vector<std::atomic<Block *>> slots(thread_num * N1);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      for (int i = 0; i < N1; ++i) {
+        Block *b = alloc.allocate(1);
+        assert(reinterpret_cast<uintptr_t>(b) % 16 == 0);
+        b->tag = uint64_t(t) << 32 | i;
+        slots[t * N1 + i].store(b, std::memory_order_release);
+        unsigned from = (t + 1) % thread_num;
+        Block *r;
+        while (!(r = slots[from * N1 + i].load(std::memory_order_acquire))) {
+          std::this_thread::yield();
+        }
+        assert(r->tag == (uint64_t(from) << 32 | i));
+        alloc.deallocate(r, 1);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+// the pool reuses freed blocks, locally and after a remote free
+void testReuse() {
+  taomp::SlabHeap heap;
+  taomp::SlabPool &pool = heap.pool(24);
+  assert(pool.blockSize() == 32);
+  void *a = pool.allocate(0);
+  pool.deallocate(a, 0);
+  assert(pool.allocate(0) == a);
+  pool.deallocate(a, 1);
+  assert(pool.allocate(0) == a);
+  assert(&heap.pool(512) != &heap.pool(513));
+  assert(heap.pool(4096).blockSize() == 4096);
+}
+
+taomp::MSQueue<int, true,
+               taomp::HazardPointer<
+                   taomp::SlabAllocator<taomp::MSQueueNode<int>>>>
+    queue(thread_num);
+
+int main() {
+  testReuse();
+  testRemoteFree();
+  taomp::reset();
+  runQueueTest(queue);
+}
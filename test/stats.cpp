@@ -0,0 +1,172 @@
+#include "taomp/stats.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+const unsigned thread_num = 8;
+const int N = 10000;
+
+struct CountingBackoff {
+  static inline std::atomic<uint64_t> calls{0};
+  void backoff() const { calls.fetch_add(1, std::memory_order_relaxed); }
+};
+
+void testCount() {
+  taomp::Stats<true> stats(thread_num);
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      taomp::StatsBackoff<CountingBackoff, true> backoff(stats);
+      for (int i = 0; i < N; ++i) {
+        stats.count(taomp::StatKind::CasRetry);
+        stats.count(taomp::StatKind::HelpStep, t);
+        backoff.backoff();
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  taomp::StatsSnapshot total = stats.snapshot();
+  assert(total[taomp::StatKind::CasRetry] == uint64_t(thread_num) * N);
+  assert(total[taomp::StatKind::HelpStep] ==
+         uint64_t(N) * thread_num * (thread_num - 1) / 2);
+  assert(total[taomp::StatKind::BackoffIteration] == uint64_t(thread_num) * N);
+  assert(CountingBackoff::calls == uint64_t(thread_num) * N);
+  assert(total[taomp::StatKind::Scan] == 0);
+  for (unsigned t = 0; t < thread_num; ++t) {
+    assert(stats.snapshot(t)[taomp::StatKind::HelpStep] == uint64_t(t) * N);
+  }
+
+  taomp::Stats<false> disabled(thread_num);
+  disabled.count(taomp::StatKind::CasRetry, 5);
+  assert(disabled.snapshot()[taomp::StatKind::CasRetry] == 0);
+}
+
+// a mutex which tells when a thread blocks in lock()
+struct ObservedMutex {
+  static inline std::atomic<unsigned> waiting{0};
+  std::mutex mutex;
+  bool try_lock() { return mutex.try_lock(); }
+  void lock() {
+    waiting.fetch_add(1);
+    mutex.lock();
+  }
+  void unlock() { mutex.unlock(); }
+};
+
+/**Mutual exclusion is kept, and an acquisition which waits for another
+ * thread's unlock() is counted as contended.
+ */
+void testLock() {
+  taomp::StatsLock<ObservedMutex> lock(thread_num);
+  uint64_t counter = 0;
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      taomp::init_thread(t);
+      for (int i = 0; i < N; ++i) {
+        std::lock_guard<taomp::StatsLock<ObservedMutex>> guard(lock);
+        ++counter;
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  assert(counter == uint64_t(thread_num) * N);
+  uint64_t contended = lock.snapshot()[taomp::StatKind::ContendedAcquire];
+  assert(contended <= counter);
+
+  // the waiter has failed try_lock() once it is seen in ObservedMutex::lock()
+  taomp::init_thread(0);
+  lock.lock();
+  unsigned waiting = ObservedMutex::waiting.load();
+  std::thread waiter([&] {
+    taomp::init_thread(1);
+    lock.lock();
+    lock.unlock();
+  });
+  while (ObservedMutex::waiting.load() == waiting) {
+    std::this_thread::yield();
+  }
+  lock.unlock();
+  waiter.join();
+  taomp::StatsSnapshot s = lock.snapshot(1);
+  assert(lock.snapshot()[taomp::StatKind::ContendedAcquire] == contended + 1);
+  assert(s[taomp::StatKind::SpinCycles] > 0);
+  assert(s[taomp::StatKind::HandoffCycles] > 0);
+}
+
+// the names of the counters in StatKind order
+const char *const names[] = {
+    "cas_retries",
+    "help_steps",
+    "backoff_iterations",
+    "spin_cycles",
+    "handoff_cycles",
+    "contended_acquires",
+    "hp_scans",
+    "reclaimed_nodes",
+    "elision_commits",
+    "elision_conflict_aborts",
+    "elision_capacity_aborts",
+    "elision_lock_busy_aborts",
+    "elision_other_aborts",
+    "elision_fallbacks",
+    "reclaim_handoffs",
+    "reclaim_backpressure",
+};
+static_assert(sizeof(names) / sizeof(names[0]) == taomp::StatKindNum);
+
+std::string expected(const std::string &name, uint64_t cas_retries,
+                     uint64_t backpressure) {
+  std::string ret;
+  for (unsigned i = 0; i < taomp::StatKindNum; ++i) {
+    uint64_t v = i == 0 ? cas_retries
+                 : i == taomp::StatKindNum - 1 ? backpressure
+                                               : 0;
+    std::string metric = std::string("taomp_") + names[i] + "_total";
+    ret += "# TYPE " + metric + " counter\n";
+    ret += metric + "{name=\"" + name + "\"} " + std::to_string(v) + "\n";
+  }
+  return ret;
+}
+
+void testPrometheus() {
+  std::ostringstream os;
+  taomp::Stats<false>(thread_num).snapshot().dumpPrometheus(os, "off");
+  assert(os.str() == expected("off", 0, 0));
+
+  taomp::Stats<true> stats(2);
+  stats.count(taomp::StatKind::CasRetry, 3, 0);
+  stats.count(taomp::StatKind::ReclaimBackpressure, 7, 1);
+  os.str("");
+  stats.snapshot().dumpPrometheus(os, "queue");
+  assert(os.str() == expected("queue", 3, 7));
+
+  std::string path = "/tmp/taomp_stats_" + std::to_string(getpid()) + ".prom";
+  assert(stats.snapshot().dumpPrometheus(path, "queue"));
+  std::ifstream in(path);
+  std::stringstream content;
+  content << in.rdbuf();
+  assert(content.str() == expected("queue", 3, 7));
+  std::remove(path.c_str());
+  assert(!stats.snapshot().dumpPrometheus("/nonexistent/taomp.prom", "q"));
+}
+
+int main() {
+  testCount();
+  testLock();
+  testPrometheus();
+}
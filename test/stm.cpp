@@ -0,0 +1,133 @@
+#include "taomp/stm.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+const unsigned thread_num = 8;
+const int N = 10000;
+const unsigned account_num = 16;
+const long initial = 1000;
+
+void testSingleThread() {
+  taomp::TVar<long> x(1), y(2);
+  long sum = taomp::atomically([&] {
+    x.store(x.load() + 10);
+    // reads its own write
+    assert(x.load() == 11);
+    // a nested call joins the outer transaction
+    taomp::atomically([&] { y.store(x.load() * 2); });
+    return x.load() + y.load();
+  });
+  assert(sum == 33 && x.load() == 11 && y.load() == 22);
+
+  // an exception of f discards the transaction
+  bool thrown = false;
+  try {
+    taomp::atomically([&] {
+      x.store(0);
+      throw std::runtime_error("boom");
+    });
+  } catch (const std::runtime_error &) {
+    thrown = true;
+  }
+  assert(thrown && x.load() == 11);
+
+  taomp::TVar<long *> p(nullptr);
+  p.store(&sum);
+  assert(p.load() == &sum);
+}
+
+/**Transfers between random accounts, while auditors sum all accounts in one
+ * transaction: every snapshot, even of an attempt which aborts later, must
+ * see the total unchanged.
+ */
+void testBank() {
+  std::vector<taomp::TVar<long>> accounts(account_num);
+  for (auto &a : accounts) {
+    a.store(initial);
+  }
+  std::atomic<unsigned> running{thread_num};
+  std::vector<std::thread> threads;
+  for (unsigned t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&, t] {
+      uint64_t x = t + 1;
+      for (int i = 0; i < N; ++i) {
+        x = x * 6364136223846793005ull + 1442695040888963407ull;
+        unsigned from = (x >> 33) % account_num;
+        unsigned to = (x >> 45) % account_num;
+        long amount = (x >> 20) % 100;
+        taomp::atomically([&] {
+          accounts[from].store(accounts[from].load() - amount);
+          accounts[to].store(accounts[to].load() + amount);
+        });
+        if (i % 64 == 0) {
+          std::this_thread::yield();
+        }
+      }
+      running.fetch_sub(1);
+    });
+  }
+  for (unsigned t = 0; t < 2; ++t) {
+    threads.emplace_back([&] {
+      while (running.load()) {
+        taomp::atomically([&] {
+          long total = 0;
+          for (auto &a : accounts) {
+            total += a.load();
+          }
+          assert(total == long(account_num) * initial);
+        });
+        std::this_thread::yield();
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  long total = 0;
+  for (auto &a : accounts) {
+    total += a.load();
+  }
+  assert(total == long(account_num) * initial);
+}
+
+/**Pairs of variables kept equal: a transaction never sees them differ,
+ * although the writer commits while the reader is between its two loads.
+ */
+void testOpacity() {
+  taomp::TVar<uint64_t> x(0), y(0);
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int i = 0; i < N / 10; ++i) {
+      taomp::atomically([&] {
+        uint64_t v = x.load() + 1;
+        x.store(v);
+        y.store(v);
+      });
+      std::this_thread::yield();
+    }
+    done.store(true);
+  });
+  // a reader may starve while the writer runs, so the reader stops when the
+  // writer is done rather than after a number of commits
+  while (!done.load()) {
+    taomp::atomically([&] {
+      uint64_t a = x.load();
+      std::this_thread::yield();
+      assert(y.load() == a);
+    });
+  }
+  writer.join();
+  assert(x.load() == uint64_t(N / 10) && y.load() == uint64_t(N / 10));
+  assert(taomp::txStats().aborts > 0);
+}
+
+int main() {
+  testSingleThread();
+  testBank();
+  testOpacity();
+}
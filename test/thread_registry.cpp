@@ -0,0 +1,61 @@
+#include "taomp/thread_registry.hpp"
+
+#include <atomic>
+#include <cassert>
+#include <iostream>
+#include <sched.h>
+#include <thread>
+#include <vector>
+
+const unsigned thread_num = 8;
+const int rounds = 200;
+
+taomp::ThreadRegistry registry;
+taomp::DynamicThreadLocal<std::atomic<unsigned>> owners(0u);
+std::atomic<unsigned> errors{0};
+
+void runTest(int round) {
+  taomp::ThreadRegistration registration(registry);
+  unsigned tid = taomp::get_thread_id();
+  assert(tid == registration.id());
+  // nobody else may hold the same id while we are registered
+  unsigned expected = 0;
+  if (!owners[tid].compare_exchange_strong(expected, round + 1)) {
+    errors.fetch_add(1);
+  }
+  std::this_thread::yield();
+  owners[tid].store(0);
+}
+
+// a pinned registration runs on the cpu its id is placed on
+void testPinned() {
+  std::thread([] {
+    taomp::ThreadRegistration registration(registry, true);
+    unsigned cpu = taomp::ThreadPlacement::global().cpuOf(registration.id());
+    assert(sched_getcpu() == int(cpu));
+  }).join();
+}
+
+int main() {
+  for (int r = 0; r < rounds; ++r) {
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < thread_num; ++i) {
+      threads.emplace_back(runTest, r);
+    }
+    for (auto &t : threads) {
+      t.join();
+    }
+  }
+  std::cerr << "capacity: " << registry.capacity() << std::endl;
+  assert(!errors.load());
+  assert(registry.liveThreads() == 0);
+  // ids are recycled, so they stay below the peak number of live threads
+  assert(registry.capacity() <= thread_num);
+  unsigned slots = 0;
+  owners.forEach([&](std::atomic<unsigned> &v) {
+    assert(!v.load());
+    ++slots;
+  });
+  assert(slots >= registry.capacity());
+  testPinned();
+}
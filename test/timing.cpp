@@ -0,0 +1,39 @@
+#include "taomp/lock.hpp"
+#include "taomp/timing.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+int main() {
+  taomp::reportTiming(std::cerr);
+  const taomp::TickCalibration &c = taomp::tickCalibration();
+  assert(c.ticks_per_ns > 0);
+  // now_ns() is on the steady_clock time line and advances with it
+  int64_t steady0 = taomp::internal::steadyNs();
+  int64_t ns0 = taomp::now_ns();
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  int64_t ns1 = taomp::now_ns();
+  int64_t steady1 = taomp::internal::steadyNs();
+  assert(ns1 > ns0);
+  assert(std::llabs(ns0 - steady0) < 1000000);
+  double drift = double((ns1 - ns0) - (steady1 - steady0)) / (steady1 - steady0);
+  std::cerr << "drift over 50ms: " << drift << std::endl;
+  assert(drift > -0.01 && drift < 0.01);
+  // conversions round trip
+  assert(std::llabs(int64_t(taomp::ticksToNs(taomp::nsToTicks(1000000))) -
+                    1000000) < 1000);
+  taomp::TimeStamp begin = taomp::readCPUCycleCountBegin();
+  taomp::TimeStamp end = taomp::readCPUCycleCountEnd();
+  assert(end >= begin);
+  // ExpBackoff waits at least its current duration, then doubles it
+  taomp::ExpBackoff backoff(std::chrono::microseconds(100),
+                            std::chrono::milliseconds(1));
+  steady0 = taomp::internal::steadyNs();
+  backoff.backoff();
+  backoff.backoff();
+  steady1 = taomp::internal::steadyNs();
+  assert(steady1 - steady0 >= 300000 * 0.99);
+}
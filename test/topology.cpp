@@ -0,0 +1,106 @@
+#include "taomp/topology.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+static void writeFile(const std::string &path, const std::string &content) {
+  std::ofstream os(path);
+  os << content << '\n';
+}
+
+static void makeDir(const std::string &path) { mkdir(path.c_str(), 0755); }
+
+/**A fake sysfs tree: 2 nodes, 2 cores per node, 2 SMT threads per core,
+ * cpus numbered like Linux does on x86, i.e. the siblings of cpu c are
+ * c and c + 4. Every node has its own L3, every core its own L2, and the
+ * lines are 128 bytes.
+ */
+static std::string makeTree() {
+  char tmpl[] = "/tmp/taomp_topologyXXXXXX";
+  std::string root = mkdtemp(tmpl);
+  writeFile(root + "/online", "0-7");
+  for (unsigned cpu = 0; cpu < 8; ++cpu) {
+    unsigned core = cpu % 4;
+    unsigned node = core / 2;
+    std::string dir = root + "/cpu" + std::to_string(cpu);
+    makeDir(dir);
+    makeDir(dir + "/topology");
+    makeDir(dir + "/node" + std::to_string(node));
+    writeFile(dir + "/topology/physical_package_id", std::to_string(node));
+    writeFile(dir + "/topology/core_id", std::to_string(core % 2));
+    makeDir(dir + "/cache");
+    const char *levels[] = {"1", "2", "3"};
+    std::string shared[] = {
+        std::to_string(core) + "," + std::to_string(core + 4),
+        std::to_string(core) + "," + std::to_string(core + 4),
+        std::to_string(2 * node) + "-" + std::to_string(2 * node + 1) + "," +
+            std::to_string(2 * node + 4) + "-" + std::to_string(2 * node + 5)};
+    for (unsigned i = 0; i < 3; ++i) {
+      std::string cache = dir + "/cache/index" + std::to_string(i);
+      makeDir(cache);
+      writeFile(cache + "/level", levels[i]);
+      writeFile(cache + "/shared_cpu_list", shared[i]);
+      writeFile(cache + "/coherency_line_size", "128");
+    }
+  }
+  return root;
+}
+
+void testParse() {
+  assert((taomp::internal::parseCpuList("0-2,5,7-8") ==
+          std::vector<unsigned>{0, 1, 2, 5, 7, 8}));
+  std::string root = makeTree();
+  taomp::Topology topology = taomp::Topology::parse(root);
+  assert(topology.cpuNum() == 8);
+  assert(topology.coreNum() == 4);
+  assert(topology.packageNum() == 2);
+  assert(topology.nodeNum() == 2);
+  assert(topology.l2Num() == 4);
+  assert(topology.l3Num() == 2);
+  assert(topology.cacheLineSize() == 128);
+  for (const taomp::CpuInfo &info : topology.getCpus()) {
+    assert(info.smt == info.cpu / 4);
+    assert(info.l3 == info.node);
+  }
+
+  // one thread per core, alternating the nodes, then the siblings
+  taomp::ThreadPlacement scatter(topology, taomp::Placement::Scatter);
+  std::vector<unsigned> cpus;
+  for (unsigned tid = 0; tid < 8; ++tid) {
+    cpus.push_back(scatter.cpuOf(tid));
+  }
+  assert((cpus == std::vector<unsigned>{0, 2, 1, 3, 4, 6, 5, 7}));
+  assert(scatter.nodeOf(1) == 1 && scatter.cpuOf(8) == 0);
+
+  // siblings first, then the next core of the node
+  taomp::ThreadPlacement compact(topology, taomp::Placement::Compact);
+  cpus.clear();
+  for (unsigned tid = 0; tid < 8; ++tid) {
+    cpus.push_back(compact.cpuOf(tid));
+  }
+  assert((cpus == std::vector<unsigned>{0, 4, 1, 5, 2, 6, 3, 7}));
+  assert(compact.coreOf(1) == compact.coreOf(0));
+
+  // the cpus outside the affinity mask are left out
+  taomp::Topology part = taomp::Topology::parse(root, {0, 1, 4});
+  assert(part.cpuNum() == 3 && part.coreNum() == 2 && part.nodeNum() == 1);
+  std::system(("rm -rf " + root).c_str());
+}
+
+void testLive() {
+  const taomp::Topology &topology = taomp::Topology::get();
+  assert(topology.cpuNum() >= 1 && topology.coreNum() >= 1);
+  std::size_t line = topology.cacheLineSize();
+  assert(line && !(line & (line - 1)));
+  taomp::ThreadPlacement placement;
+  assert(placement.pin(0));
+}
+
+int main() {
+  testParse();
+  testLive();
+}
@@ -0,0 +1,71 @@
+#define TAOMP_TRACE
+#include "taomp/lock.hpp"
+#include "taomp/ms_queue.hpp"
+#include "taomp/trace.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+const unsigned thread_num = 4;
+const int N = 1000;
+
+taomp::MSQueue<int> queue(thread_num);
+taomp::TTASLock lock;
+
+void runTest() {
+  taomp::init_thread();
+  for (int i = 0; i < N; ++i) {
+    queue.enqueue(i);
+    queue.dequeue();
+    lock.lock();
+    lock.unlock();
+  }
+}
+
+int main() {
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < thread_num; ++i) {
+    threads.emplace_back(runTest);
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  std::string path = "/tmp/taomp_trace_test.bin";
+  assert(taomp::dumpTrace(path));
+  std::vector<taomp::TraceEvent> events;
+  double ticks_per_ns;
+  assert(taomp::loadTrace(path, events, ticks_per_ns));
+  std::remove(path.c_str());
+  // 6 events per iteration and thread, the rings keep the last ones
+  std::vector<unsigned> per_thread(thread_num);
+  std::vector<int> depth(thread_num);
+  for (auto &e : events) {
+    assert(e.tid < thread_num);
+    ++per_thread[e.tid];
+    if (e.kind == taomp::TraceKind::CasFail) {
+      continue;
+    }
+    // per thread the events are properly nested: a dequeue may scan, and the
+    // ring may start inside both
+    bool begin = e.kind == taomp::TraceKind::LockAcquire ||
+                 e.kind == taomp::TraceKind::EnqueueBegin ||
+                 e.kind == taomp::TraceKind::DequeueBegin ||
+                 e.kind == taomp::TraceKind::ScanBegin;
+    depth[e.tid] += begin ? 1 : -1;
+    assert(depth[e.tid] >= -2 && depth[e.tid] <= 2);
+  }
+  for (unsigned n : per_thread) {
+    assert(n == taomp::TraceCapacity);
+  }
+  std::ostringstream os;
+  taomp::writeChromeTrace(os, events, ticks_per_ns);
+  std::string json = os.str();
+  assert(json.find("\"name\":\"enqueue\",\"ph\":\"B\"") != std::string::npos);
+  assert(json.find("\"name\":\"lock\",\"ph\":\"E\"") != std::string::npos);
+  taomp::resetTrace();
+  assert(taomp::collectTrace().empty());
+}
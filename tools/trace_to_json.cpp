@@ -0,0 +1,35 @@
+#include "taomp/trace.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+/**Converts a dumpTrace() file to Chrome trace / Perfetto JSON:
+ *   trace_to_json trace.bin [trace.json]
+ * Writes to stdout without an output path. Open the result in
+ * chrome://tracing or ui.perfetto.dev.
+ */
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " trace.bin [trace.json]\n";
+    return 1;
+  }
+  std::vector<taomp::TraceEvent> events;
+  double ticks_per_ns;
+  if (!taomp::loadTrace(argv[1], events, ticks_per_ns)) {
+    std::cerr << "cannot read trace " << argv[1] << '\n';
+    return 1;
+  }
+  if (argc < 3) {
+    taomp::writeChromeTrace(std::cout, events, ticks_per_ns);
+    return 0;
+  }
+  std::ofstream os(argv[2]);
+  taomp::writeChromeTrace(os, events, ticks_per_ns);
+  if (!os) {
+    std::cerr << "cannot write " << argv[2] << '\n';
+    return 1;
+  }
+  std::cerr << events.size() << " events\n";
+}